@@ -78,12 +78,28 @@ extern "C" {
 
   /*
   .. short int, used for indices of node arrays indices [0, max) are either in
-  .. use/free . Index UINT16_MAX is reserved and used in place of NULL.This is
-  .. only for small 'max' (say max <= 256). For each 'index' in in_use, you may
-  .. store attributes in (*attributes)[index]
+  .. use/free . Index HMESH_INDEX_NULL is reserved and used in place of NULL.
+  .. This is only for small 'max' (say max <= 256). For each 'index' in
+  .. in_use, you may store attributes in (*attributes)[index]
+  .. Width of Index is set at compile time by HMESH_INDEX_BITS (16 by
+  .. default). Use -DHMESH_INDEX_BITS=32 for large meshes (Node, HmeshArray
+  .. and HmeshCells use Index, so they follow). It's 2^16 x 4096 nodes per
+  .. HmeshCells with 16 bits, and 2^32 x 4096 with 32 bits.
   */
 
+  #ifndef HMESH_INDEX_BITS
+  #define HMESH_INDEX_BITS 16
+  #endif
+
+  #if HMESH_INDEX_BITS == 16
   typedef uint16_t Index;
+  #define HMESH_INDEX_NULL UINT16_MAX
+  #elif HMESH_INDEX_BITS == 32
+  typedef uint32_t Index;
+  #define HMESH_INDEX_NULL UINT32_MAX
+  #else
+  #error "HMESH_INDEX_BITS should be 16 or 32"
+  #endif
 
   typedef struct
   {
@@ -125,7 +141,7 @@ extern "C" {
     {
       info[i].free_list = i;
       info[i].loc_free  = i;
-      info[i].loc       = UINT16_MAX;
+      info[i].loc       = HMESH_INDEX_NULL;
       if (att)
         (*att)[i] = NULL;
     }
@@ -140,26 +156,31 @@ extern "C" {
     };
   }
 
-  static inline Index index_stack_expand (IndexStack * stack)
+  /*
+  .. Resize the arrays of 'stack' to 'max' (> stack->max) indices.
+  */
+  static inline Index index_stack_resize (IndexStack * stack, Index max)
   {
-    if (stack->max == stack->limit)
-      /* Reached limit. Return error*/
-      return HMESH_ERROR;
-    /* Expand the array */
-    Index max = stack->max + stack->increment;
     max = (max > stack->limit) ? stack->limit : max;
-    stack->info = realloc (stack->info, max * sizeof (IndexInfo));
+    IndexInfo * info = realloc (stack->info, max * sizeof (IndexInfo));
+    if (!info)
+      return HMESH_ERROR;
+    stack->info = info;
 
     void *** att = stack->attribute;
     if (att)
-      *att = realloc (*att, max * sizeof (void *));
+    {
+      void ** a = realloc (*att, max * sizeof (void *));
+      if (!a)
+        return HMESH_ERROR;
+      *att = a;
+    }
 
-    IndexInfo * info = stack->info;
     for (Index i = stack->max; i<max; ++i)
     {
       info[stack->nfree].free_list = i;
       info[i].loc_free             = stack->nfree++;
-      info[i].loc                  = UINT16_MAX;
+      info[i].loc                  = HMESH_INDEX_NULL;
       if (att)
         (*att)[i] = NULL;
     }
@@ -168,6 +189,37 @@ extern "C" {
     return HMESH_NO_ERROR;
   }
 
+  /*
+  .. Expand the stack geometrically (x2), so that adding 'n' indices is
+  .. O(log n) reallocs. 'increment' is the minimum expansion.
+  */
+  static inline Index index_stack_expand (IndexStack * stack)
+  {
+    if (stack->max == stack->limit)
+      /* Reached limit. Return error*/
+      return HMESH_ERROR;
+    Index grow = stack->max > stack->increment ? stack->max : stack->increment,
+      max = (stack->limit - stack->max > grow) ? stack->max + grow :
+        stack->limit;
+    return index_stack_resize (stack, max);
+  }
+
+  /*
+  .. Reserve 'n' indices, so that indices [0, n) can be used without any
+  .. further realloc.
+  */
+  static inline int index_stack_reserve (IndexStack * stack, Index n)
+  {
+    if (n > stack->limit)
+    {
+      hmesh_error ("index_stack_reserve () : %u exceeds limit", n);
+      return HMESH_ERROR;
+    }
+    if (n <= stack->max)
+      return HMESH_NO_ERROR;
+    return index_stack_resize (stack, n);
+  }
+
   static inline
   Index index_stack_free_head (IndexStack * stack, int is_pop)
   {
@@ -176,14 +228,14 @@ extern "C" {
       {
         hmesh_error ("index_stack_free_head () : Out of index");
         /* Reached limit. Return invalid index*/
-        return UINT16_MAX;
+        return HMESH_INDEX_NULL;
       }
     IndexInfo * info = stack->info;
     Index index = info[stack->nfree-1].free_list;
     if (is_pop)
     {
       --(stack->nfree);
-      info[index].loc_free  = UINT16_MAX;
+      info[index].loc_free  = HMESH_INDEX_NULL;
       info[stack->n].in_use = index;
       info[index].loc       = stack->n++;
     }
@@ -194,11 +246,11 @@ extern "C" {
   index_stack_deallocate (IndexStack * stack, Index index)
   {
     /* index location in in_use array */
-    Index indexLoc = (index >= stack->max) ? UINT16_MAX :
+    Index indexLoc = (index >= stack->max) ? HMESH_INDEX_NULL :
                           stack->info[index].loc;
     void *** att = stack->attribute;
     void * index_att = att ? (*att)[index] : NULL;
-    if (indexLoc == UINT16_MAX)
+    if (indexLoc == HMESH_INDEX_NULL)
     {
       hmesh_error ("index_stack_deallocate () : not in use");
       return HMESH_ERROR;
@@ -213,7 +265,7 @@ extern "C" {
     info[index].loc_free         = stack->nfree++;
     info[indexLoc].in_use        = info[--(stack->n)].in_use;
     info[info[indexLoc].in_use].loc = indexLoc;
-    info[index].loc              = UINT16_MAX;
+    info[index].loc              = HMESH_INDEX_NULL;
 
     return HMESH_NO_ERROR;
   }
@@ -232,7 +284,7 @@ extern "C" {
     Index indexLoc   = info[index].loc_free;
     void *** att = stack->attribute;
     void * index_att = att ? (*att)[index] : NULL;
-    if ( indexLoc == UINT16_MAX || index_att )
+    if ( indexLoc == HMESH_INDEX_NULL || index_att )
     {
       hmesh_error ("index_stack_allocate () : "
                  "index %d already in use", index);
@@ -243,7 +295,7 @@ extern "C" {
     info[index].loc          = stack->n++;
     info[indexLoc].free_list = info[--(stack->nfree)].free_list;
     info[info[indexLoc].free_list].loc_free = indexLoc;
-    info[index].loc_free     = UINT16_MAX;
+    info[index].loc_free     = HMESH_INDEX_NULL;
 
     return HMESH_NO_ERROR;
   }
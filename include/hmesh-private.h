@@ -0,0 +1,127 @@
+/*
+.. Helpers shared by the translation units of the library (src/hmesh.c,
+.. src/hmesh-tris.c). Not part of the API : include <hmesh.h> instead.
+*/
+
+#ifndef _HMESH_PRIVATE_
+#define _HMESH_PRIVATE_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  #include <hmesh.h>
+
+  /*
+  .. MurmurHash3 (32 bit hash, seed 0) of 'key' of 'len' characters, as in
+  .. syntax/ast/hash.c. Credit : Austin Appleby, (MIT License)
+  .. https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp
+  */
+  static inline
+  uint32_t hmesh_hash (const char * key, uint32_t len)
+  {
+    uint32_t h = 0, k;
+
+    /* blocks of 4 characters */
+    for (size_t i = len >> 2; i; --i)
+    {
+      memcpy (&k, key, sizeof (uint32_t));
+      key += sizeof (uint32_t);
+      k *= 0xcc9e2d51;
+      k = (k << 15) | (k >> 17);
+      k *= 0x1b873593;
+      h ^= k;
+      h = ((h << 13) | (h >> 19)) * 5 + 0xe6546b64;
+    }
+
+    /* tail characters (little-endian) */
+    k = 0;
+    switch (len & 3)
+    {
+      case 3:
+        k ^= key[2] << 16;
+        __attribute__ ((fallthrough));
+      case 2:
+        k ^= key[1] << 8;
+        __attribute__ ((fallthrough));
+      case 1:
+        k ^= key[0];
+        k *= 0xcc9e2d51;
+        k = (k << 15) | (k >> 17);
+        k *= 0x1b873593;
+        h ^= k;
+    }
+
+    /* finalize */
+    h ^= len;
+    h ^= (h >> 16);
+    h *= 0x85ebca6b;
+    h ^= (h >> 13);
+    h *= 0xc2b2ae35;
+    h ^= (h >> 16);
+
+    return h;
+  }
+
+  /*
+  .. Sort key of a node (hmesh_keys_sort ())
+  */
+  typedef struct
+  {
+    uint64_t key;
+    Node node;
+  } HmeshKey;
+
+  /*
+  .. Key of the open addressing tables of the half edges (with an unset
+  .. 'twin') of hmesh_hedges_new () and hmesh_tris_faces_new (), by their
+  .. vertices (sub.0, sub.1)
+  */
+  typedef struct
+  {
+    Node v[2];
+  } HmeshHedgeKey;
+
+  static inline
+  int hmesh_node_same (Node a, Node b)
+  {
+    return a.index == b.index && a.iblock == b.iblock;
+  }
+
+  /*
+  .. "hmesh_node_in_use ()" : 1 if 'node' is a node in use of 'cells'
+  */
+  static inline
+  int hmesh_node_in_use (HmeshCells * cells, Node node)
+  {
+    IndexStack * blocks = cells->blocks;
+    return node.iblock < blocks->max && node.index < HMESH_BLOCK_SIZE &&
+      blocks->info[node.iblock].loc != HMESH_INDEX_NULL &&
+      ((Index *) HMESH_ATTR (cells, 1, node.iblock))[node.index] <
+        cells->info [node.iblock];
+  }
+
+  /*
+  .. Attributes of the library (src/hmesh.c), added at the first free index
+  .. (hmesh_attr_add ()) or at 'iattr' (hmesh_attr_insert ())
+  */
+  extern Index hmesh_attr_insert  ( HmeshCells *, Index iattr, char * name,
+                                    size_t size );
+  extern Index hmesh_attr_add     ( HmeshCells *, char * name, size_t size );
+  extern int   hmesh_attr_destroy ( HmeshCells *, Index iattr );
+
+  /*
+  .. Space filling curve order (src/hmesh.c) : bounding box of the vertices,
+  .. and the order of 'cells' by the key of their position (or 'sub.0')
+  */
+  extern void  hmesh_bounds       ( HmeshCells *, int D, Real lo[3],
+                                    Real hi[3] );
+  extern int   hmesh_cells_curve  ( HmeshCells *, Index ikey, HmeshCells * sub,
+                                    Index isub, int D, Real lo[3], Real hi[3],
+                                    HmeshCurve, HmeshRemap * );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -33,11 +33,12 @@ extern "C" {
 
   /*
   .. Some limits imposed in hmesh
-  .. (a) Maximum 2^16 Blocks. Usually RAM will run much before that.
+  .. (a) Maximum 2^16 Blocks (2^32 with HMESH_INDEX_BITS = 32). Usually RAM
+  .. will run much before that.
   .. (b) Maximum of 64 variables/attributes per manifold
   .. (c) Maximum of 32 characters including '\0' for variable name. 
   */
-  #define HMESH_MAX_NBLOCKS UINT16_MAX
+  #define HMESH_MAX_NBLOCKS HMESH_INDEX_NULL
   #define HMESH_MAX_NVARS   64
   #define HMESH_MAX_VARNAME 31
 
@@ -48,9 +49,18 @@ extern "C" {
   .. HMESH_ATTR    : get 'iblk'-th block of 'iattr'-th attribute
   .. HMESH_REAL    : get 'iblk'-th block of a scalar
   .. HMESH_SCALAR  : Get scalar value of a node
+  .. HMESH_SCALAR_W: Get scalar value of a node, to be written
+  .. HMESH_F32, HMESH_SCALAR_F32 : same as HMESH_REAL, HMESH_SCALAR for a
+  .. scalar of 32 bits (hmesh_scalar_new_precision ()). HMESH_F64, .. for 64
+  .. HMESH_SCALAR_F32_W, HMESH_SCALAR_F64_W : same as HMESH_SCALAR_W
   .. HMESH_SUBNODE : get subnodes like vertex of an edge/edge of a triangle/etc
   .. HMESH_IVERTEX : get i-th vertex
   .. HMESH_IEDGE   : get i-th edge
+  .. NOTE : the accessors read the block as it is, even if it's shared with
+  .. a snapshot (hmesh_cells_snapshot ()), so reading never copies a block.
+  .. The values of a node are written through HMESH_SCALAR_W (..), which
+  .. copy a block shared before (HMESH_WRITE), and the blocks and the sub
+  .. nodes through HMESH_WRITE.
   */
 
   #define HMESH_ATTR(_c_, _iattr_, _iblk_)                                    \
@@ -59,13 +69,65 @@ extern "C" {
     ( (Real *)(HMESH_ATTR(_c_, _s_, _iblk_)) )
   #define HMESH_SCALAR(_c_, _s_, _hnode_)                                     \
     ( HMESH_REAL(_c_, _s_, _hnode_.iblock)[_hnode_.index] )
+  #define HMESH_SCALAR_W(_c_, _s_, _hnode_)                                   \
+    ( ((Real *) HMESH_WRITE(_c_, _s_, _hnode_.iblock))[_hnode_.index] )
+  #define HMESH_F32(_c_, _s_, _iblk_)                                         \
+    ( (float *)(HMESH_ATTR(_c_, _s_, _iblk_)) )
+  #define HMESH_SCALAR_F32(_c_, _s_, _hnode_)                                 \
+    ( HMESH_F32(_c_, _s_, _hnode_.iblock)[_hnode_.index] )
+  #define HMESH_SCALAR_F32_W(_c_, _s_, _hnode_)                               \
+    ( ((float *) HMESH_WRITE(_c_, _s_, _hnode_.iblock))[_hnode_.index] )
+  #define HMESH_F64(_c_, _s_, _iblk_)                                         \
+    ( (double *)(HMESH_ATTR(_c_, _s_, _iblk_)) )
+  #define HMESH_SCALAR_F64(_c_, _s_, _hnode_)                                 \
+    ( HMESH_F64(_c_, _s_, _hnode_.iblock)[_hnode_.index] )
+  #define HMESH_SCALAR_F64_W(_c_, _s_, _hnode_)                               \
+    ( ((double *) HMESH_WRITE(_c_, _s_, _hnode_.iblock))[_hnode_.index] )
   #define HMESH_SUBNODE(_c_,_node_, _isub_)                                   \
-    ( ((Node) HMESH_ATTR(_c_, 2 + _isub_, _node_.iblock))[_node_.index] )
+    ( ((Node *) HMESH_ATTR(_c_, 2 + _isub_, _node_.iblock))[_node_.index] )
   #define HMESH_IVERTEX(_edges_,_edge_,_iv_)                                  \
     HMESH_SUBNODE(_edges_, _edge_, _iv_)
   #define HMESH_IEDGE(_triangles_,_triangle_,_ie_)                            \
     HMESH_SUBNODE(_triangles_, _triangle_,_ie_)
   
+  /*
+  .. Block-wise access of cells. Inner loops run over the contiguous arrays
+  .. of a block ('Real *' from HMESH_REAL), so that they can be vectorized.
+  .. HMESH_BLOCK_SIZE    : number of nodes (slots) per block
+  .. HMESH_FOREACH_BLOCK : loop over the blocks in use, '_iblk_' is the block
+  .. HMESH_BLOCK_COUNT   : number of nodes in use in the block '_iblk_'
+  .. HMESH_BLOCK_MAP     : indices of nodes in use, i.e. map[0, count)
+  .. HMESH_FOREACH_INDEX : loop over the index of each node in use of a block
+  .. NOTE : Data of a node is never moved (a Node is a stable handle, held by
+  .. other cells), so the nodes in use of a block are not [0, count), unless
+  .. the block is full. Blocks are made full by hmesh_cells_compact (), which
+  .. remaps the handles. A pointwise kernel (Ex: axpy) may loop over all the
+  .. HMESH_BLOCK_SIZE slots (unused slots are computed too, but never read),
+  .. which vectorizes, at the cost of the unused slots. Use
+  .. HMESH_FOREACH_INDEX otherwise (Ex: reductions). tests/axpy.c compares
+  .. them against packed arrays.
+  .. Ex: HMESH_FOREACH_BLOCK (cells, iblk) {
+  ..      Real * x = HMESH_REAL (cells, 2, iblk), * u = HMESH_REAL (.., iblk);
+  ..      for (int i = 0; i < HMESH_BLOCK_SIZE; ++i)
+  ..        x[i] += dt * u[i];
+  ..    }
+  */
+  #define HMESH_BLOCK_SIZE HMESH_PAGE_SIZE
+  #define HMESH_FOREACH_BLOCK(_c_, _iblk_)                                    \
+    for (Index _i_##_iblk_ = 0, _iblk_ = 0;                                   \
+         _i_##_iblk_ < (_c_)->blocks->n &&                                    \
+         ((_iblk_ = (_c_)->blocks->info[_i_##_iblk_].in_use), 1);             \
+         ++_i_##_iblk_)
+  #define HMESH_BLOCK_COUNT(_c_, _iblk_)                                      \
+    ( (_c_)->info[_iblk_] )
+  #define HMESH_BLOCK_MAP(_c_, _iblk_)                                        \
+    ( (Index *) HMESH_ATTR(_c_, 0, _iblk_) )
+  #define HMESH_FOREACH_INDEX(_c_, _iblk_, _index_)                           \
+    for (Index _j_##_index_ = 0, _index_ = 0;                                 \
+         _j_##_index_ < HMESH_BLOCK_COUNT(_c_, _iblk_) &&                     \
+         ((_index_ = HMESH_BLOCK_MAP(_c_, _iblk_)[_j_##_index_]), 1);         \
+         ++_j_##_index_)
+
   /*
   .. HmeshArray : a list of memory blocks. It can be used to store nodes, or
   .. attributes of nodes like scalars etc.
@@ -75,11 +137,14 @@ extern "C" {
   .. is the size of iblock array, and also address array
   .. To keep track of indices for which address[index] are in_use and
   .. free_list. you need to free the memblock before freeing the index
+  .. 'tile' : 0, or the number of nodes per tile of an AoSoA array, where
+  .. the components (of 'csize' bytes) of a tile are stored one after other
   */
   typedef struct
   {
     char name [HMESH_MAX_VARNAME + 1];
-    Index * blockID, max, obj_size;
+    BlockID * blockID;
+    Index max, obj_size, tile, csize;
     IndexStack stack;
   } HmeshArray;
 
@@ -88,26 +153,453 @@ extern "C" {
     Index index, iblock;
   } Node;
 
+  /*
+  .. "HmeshNames" : hash table of the names of the attributes of a HmeshCells
+  .. (MurmurHash3 with chaining, as in syntax/ast/hash.c). The attributes
+  .. are the nodes of the table, so that 'hash[iattr]' is the hash of the
+  .. name of 'iattr' and 'next[iattr]' is the next in the chain. 'head' is
+  .. the first 'iattr' of each slot. There are at most HMESH_MAX_NVARS
+  .. names, so the table (of HMESH_NAMES_SIZE slots) is never resized.
+  */
+  #define HMESH_NAMES_SIZE (2 * HMESH_MAX_NVARS)
+  typedef struct
+  {
+    uint32_t hash [HMESH_MAX_NVARS];
+    Index head [HMESH_NAMES_SIZE], next [HMESH_MAX_NVARS];
+  } HmeshNames;
+
   /*
   .. "HmeshCells" : list of k-cells/k-simplices of a mesh ( k in {0,1,2,3}
   .. respectively for vertices/edges/triangle/tetrahedrons ). The list is
   .. stored as an array of indices, or rather as a linked list of indices.
   .. There may be stacks of arrays (also called as Structure of Arrays or SoA)
   .. with each array corresponding to an attribute of the cells.
-  .. 'info' : number of indices in use
+  .. 'info' : number of indices in use, for each block
   .. 'max'  : blocks in [0,max) are (maybe) in use 
   .. 'maxs' : scalars in [0,maxs) are (maybe) in use
   .. 'tail' : tail block where you insert new nodes.
+  .. 'avail': blocks (other than 'tail') with free slots
   .. 'k'    : represent dimension of k-simplex. 0 <= k <= D
+  .. 'names': index of the attributes by name
+  .. 'shared': blocks may be shared with a snapshot (hmesh_cells_snapshot ())
+  .. 'owners': number of cells (the cells and its snapshots) sharing blocks.
+  .. Once it's back to 1, 'shared' is cleared by the next write.
+  .. 'tris' : faces of HmeshTris, whose twins are half edges (3 f + c) and
+  .. not faces. They are remapped as such by hmesh_cells_compact (), ..
   */
   typedef struct 
   {
-    IndexStack scalars, * blocks;
+    IndexStack scalars, * blocks, avail;
     void **  attr, *** mem;
     Index * info, max, maxs, tail;
-    int k, min;
+    int k, min, shared, * owners, tris;
+    HmeshNames names;
   } HmeshCells;
 
+  /*
+  .. Copy-on-write of the blocks shared with a snapshot. Once a snapshot of
+  .. the cells is taken (hmesh_cells_snapshot ()), blocks are written through
+  .. HMESH_WRITE : the block '_iblk_' of the attribute '_iattr_', which is
+  .. copied before, if it's still shared. Get it once per block, and not per
+  .. node. Cells that were never shared (or whose snapshots are all
+  .. destroyed) are written in place.
+  .. Ex: Real * x = (Real *) HMESH_WRITE (cells, 2, iblk);
+  */
+  #define HMESH_WRITE(_c_, _iattr_, _iblk_)                                   \
+    ( __builtin_expect ((_c_)->shared, 0) ?                                   \
+      hmesh_cells_write (_c_, _iattr_, _iblk_) :                              \
+      HMESH_ATTR(_c_, _iattr_, _iblk_) )
+
+  /*
+  .. Topology walks of half edges (k-cells, k > 0). Each hop of a walk
+  .. is a load from a different block, which depends on the previous hop,
+  .. so the hops of a single star cannot be prefetched ahead. The misses of
+  .. several stars are overlapped instead (HMESH_FOREACH_STARS), or the
+  .. next items of a worklist are prefetched (HMESH_PREFETCH_NODE).
+  .. HMESH_NODE_NULL : an unset node (Ex: 'twin' of a boundary half edge)
+  .. HMESH_NEXT, HMESH_TWIN : 'next', 'twin' of the half edge '_e_'
+  .. HMESH_PREFETCH      : prefetch the object of '_size_' bytes of the node
+  .. '_hnode_' in the attribute '_iattr_'
+  .. HMESH_PREFETCH_NODE : prefetch a Node attribute (sub cells, next, ..)
+  .. HMESH_PREFETCH_REAL : prefetch a Real attribute (scalars)
+  .. HMESH_FOREACH_STAR  : loop over the half edges '_e_' going out of the
+  .. origin (sub.0) of the half edge '_start_', i.e. _e_ = next (twin (_e_)).
+  .. It stops at a boundary (an unset twin).
+  .. Ex: HMESH_FOREACH_STAR (edges, start, e)
+  ..       sum += HMESH_SCALAR (vertices, 2, HMESH_IVERTEX (edges, e, 1));
+  .. HMESH_FOREACH_STARS : stars of a worklist of '_n_' half edges '_work_'.
+  .. HMESH_STAR_BATCH stars are walked at once, one hop of each star in
+  .. turn, so that the cache misses of the stars overlap. For each half
+  .. edge '_s_.e' of the star of '_work_[_s_.w]', the body is run. The order
+  .. of the stars is not kept, so that accumulate per star (Ex: in an array
+  .. indexed by '_s_.w').
+  .. Ex: HMESH_FOREACH_STARS (edges, work, n, s)
+  ..       sum[s.w] += HMESH_SCALAR (v, 2, HMESH_IVERTEX (edges, s.e, 1));
+  */
+  #define HMESH_NODE_NULL                                                     \
+    ( (Node) { .index = HMESH_INDEX_NULL, .iblock = HMESH_INDEX_NULL } )
+  #define HMESH_NEXT(_c_, _e_)                                                \
+    HMESH_SUBNODE(_c_, _e_, (_c_)->k + 1)
+  #define HMESH_TWIN(_c_, _e_)                                                \
+    HMESH_SUBNODE(_c_, _e_, (_c_)->k + 2)
+  #define HMESH_PREFETCH(_c_, _iattr_, _hnode_, _size_)                       \
+    __builtin_prefetch ( (char *) HMESH_ATTR(_c_, _iattr_, (_hnode_).iblock)  \
+                         + (size_t) (_hnode_).index * (_size_) )
+  #define HMESH_PREFETCH_NODE(_c_, _iattr_, _hnode_)                          \
+    HMESH_PREFETCH(_c_, _iattr_, _hnode_, sizeof (Node))
+  #define HMESH_PREFETCH_REAL(_c_, _iattr_, _hnode_)                          \
+    HMESH_PREFETCH(_c_, _iattr_, _hnode_, sizeof (Real))
+  #define HMESH_FOREACH_STARS(_c_, _work_, _n_, _s_)                          \
+    for (HmeshStars _s_ = hmesh_stars (_work_, _n_);                          \
+         hmesh_stars_next (_c_, &_s_); )
+  #define HMESH_FOREACH_STAR(_c_, _start_, _e_)                               \
+    for (Node _e_ = hmesh_star_first (_c_, _start_);                          \
+         _e_.index != HMESH_INDEX_NULL;                                       \
+         _e_ = hmesh_star_next (_c_, _e_, _start_))
+
+  /*
+  .. First half edge of a star
+  */
+  static inline
+  Node hmesh_star_first (HmeshCells * c, Node start)
+  {
+    (void) c;
+    return start;
+  }
+
+  /*
+  .. Next half edge of a star, after 'e', or HMESH_NODE_NULL once it's back
+  .. to 'start' (or at a boundary)
+  */
+  static inline
+  Node hmesh_star_next (HmeshCells * c, Node e, Node start)
+  {
+    Node t = HMESH_TWIN (c, e);
+    if (t.index == HMESH_INDEX_NULL)
+      return HMESH_NODE_NULL;
+    Node n = HMESH_NEXT (c, t);
+    if (n.index == start.index && n.iblock == start.iblock)
+      return HMESH_NODE_NULL;
+    return n;
+  }
+
+  /*
+  .. Half edges of a triangulated surface, on the attributes of the 1-cells
+  .. (in place of the pointers of 'Hedge', src/backup/hmesh.h). A half edge
+  .. is a Node (32 bits with the default HMESH_INDEX_BITS) : 'sub.0' is its
+  .. pivot (origin), 'sub.1' its end, 'next' the next half edge of its face
+  .. and 'twin' the reverse half edge of the adjacent face.
+  .. HMESH_PREV         : previous half edge of a triangle (no 'prev' stored)
+  .. HMESH_FOREACH_NODE : loop over all the nodes '_n_' in use of cells (Ex:
+  .. all the half edges, as foreach_hedge). NOTE : 'break' ends only the
+  .. block, as in HMESH_FOREACH_INDEX
+  .. HMESH_FOREACH_FACE : loop over the half edges '_e_' of the face of
+  .. '_start_', from '_start_' (as hface_start)
+  .. HMESH_FOREACH_STAR (above) is the loop over the half edges with the
+  .. same pivot (as hedge_valence_start)
+  .. Ex: HMESH_FOREACH_NODE (edges, e)
+  ..       HMESH_FOREACH_FACE (edges, e, f)
+  ..         ..
+  .. NOTE : a reorder is required for fast walks. 'sub', 'next' and 'twin'
+  .. are separate arrays (SoA), so a hop touches a line per attribute, where
+  .. a 'Hedge' touches one. In the order the half edges are created (Ex: from
+  .. shuffled faces), the walks are slower than the pointers of 'Hedge'
+  .. (tests/hedge.c : faces ~3x, stars ~1x batched, ~2x not). After
+  .. hmesh_reorder (), they are faster (stars ~5x, faces ~1x). So call
+  .. hmesh_reorder () once the half edges are created (or remeshed).
+  */
+  #define HMESH_PREV(_c_, _e_)                                                \
+    HMESH_NEXT(_c_, HMESH_NEXT(_c_, _e_))
+  #define HMESH_FOREACH_NODE(_c_, _n_)                                        \
+    HMESH_FOREACH_BLOCK (_c_, _b_##_n_)                                       \
+      HMESH_FOREACH_INDEX (_c_, _b_##_n_, _i_##_n_)                           \
+        for (Node _n_ = { .index = _i_##_n_, .iblock = _b_##_n_ },            \
+             * _o_##_n_ = &_n_; _o_##_n_; _o_##_n_ = NULL)
+  #define HMESH_FOREACH_FACE(_c_, _start_, _e_)                               \
+    for (Node _e_ = (_start_); _e_.index != HMESH_INDEX_NULL;                 \
+         _e_ = hmesh_face_next (_c_, _e_, _start_))
+
+  /*
+  .. Next half edge of the face, after 'e', or HMESH_NODE_NULL once it's
+  .. back to 'start'
+  */
+  static inline
+  Node hmesh_face_next (HmeshCells * c, Node e, Node start)
+  {
+    Node n = HMESH_NEXT (c, e);
+    return (n.index == start.index && n.iblock == start.iblock) ?
+      HMESH_NODE_NULL : n;
+  }
+
+  /*
+  .. "HmeshHedgeError" : errors found by hmesh_hedges_valid ()
+  */
+  typedef enum
+  {
+    HMESH_HEDGE_VALID = 0,
+    HMESH_HEDGE_UNSET = 1,
+    HMESH_HEDGE_TWIN  = 2,
+    HMESH_HEDGE_FACE  = 4,
+    HMESH_HEDGE_STAR  = 8
+  } HmeshHedgeError;
+
+  /*
+  .. Implicit half edges of a triangulated surface (HmeshTris). The 3 half
+  .. edges of the face 'f' are the slots 3f, 3f+1 and 3f+2 i.e. the half
+  .. edge Node {3 f.index + c, f.iblock} is the corner 'c' of the face 'f',
+  .. from its vertex 'c' to its vertex 'c+1' (mod 3). So 'next', 'prev' and
+  .. the face of a half edge are arithmetic, and only the pivot (vertex
+  .. 'sub.c' of the face) and 'twin' ('twin.c') are stored per half edge, as
+  .. attributes of the faces.
+  .. HMESH_TRI_PIVOT : pivot (origin) of the half edge '_e_' of the faces '_f_'
+  .. HMESH_TRI_TWIN  : twin of '_e_', or HMESH_NODE_NULL at a boundary
+  .. HMESH_FOREACH_TRI_STAR : loop over the half edges '_e_' going out of the
+  .. pivot of '_start_' (as HMESH_FOREACH_STAR). It stops at a boundary.
+  .. HMESH_FOREACH_TRI_HEDGE : loop over all the half edges '_e_' in use
+  .. Ex: HMESH_FOREACH_TRI_HEDGE (t->f, e)
+  ..       if (HMESH_TRI_TWIN (t->f, e).index == HMESH_INDEX_NULL)
+  ..         ++nboundary;
+  .. NOTE : 3 HMESH_BLOCK_SIZE slots of half edges should fit in an Index.
+  */
+  #define HMESH_TRI_IVERTEX 2
+  #define HMESH_TRI_ITWIN   5
+  #if 3 * HMESH_BLOCK_SIZE >= HMESH_INDEX_NULL
+  #error "3 HMESH_BLOCK_SIZE half edges do not fit in an Index"
+  #endif
+  #define HMESH_TRI_PIVOT(_f_, _e_)                                           \
+    ( ((Node *) HMESH_ATTR(_f_, HMESH_TRI_IVERTEX + (_e_).index % 3,          \
+        (_e_).iblock))[(_e_).index / 3] )
+  #define HMESH_TRI_TWIN(_f_, _e_)                                            \
+    ( ((Node *) HMESH_ATTR(_f_, HMESH_TRI_ITWIN + (_e_).index % 3,            \
+        (_e_).iblock))[(_e_).index / 3] )
+  #define HMESH_FOREACH_TRI_STAR(_f_, _start_, _e_)                           \
+    for (Node _e_ = (_start_); _e_.index != HMESH_INDEX_NULL;                 \
+         _e_ = hmesh_tri_star_next (_f_, _e_, _start_))
+  #define HMESH_FOREACH_TRI_HEDGE(_f_, _e_)                                   \
+    HMESH_FOREACH_NODE (_f_, _t_##_e_)                                        \
+      for (Node _e_ = hmesh_tri_hedge (_t_##_e_, 0);                          \
+           _e_.index < 3 * _t_##_e_.index + 3; ++_e_.index)
+
+  /* half edge of the corner 'c' of the face 'f' */
+  static inline
+  Node hmesh_tri_hedge (Node f, int c)
+  {
+    return (Node) { .index = (Index) (3 * f.index + c), .iblock = f.iblock };
+  }
+
+  /* face of the half edge 'e' */
+  static inline
+  Node hmesh_tri_face (Node e)
+  {
+    return (Node) { .index = (Index) (e.index / 3), .iblock = e.iblock };
+  }
+
+  static inline
+  Node hmesh_tri_next (Node e)
+  {
+    e.index = (Index) ((e.index % 3 == 2) ? e.index - 2 : e.index + 1);
+    return e;
+  }
+
+  static inline
+  Node hmesh_tri_prev (Node e)
+  {
+    e.index = (Index) ((e.index % 3 == 0) ? e.index + 2 : e.index - 1);
+    return e;
+  }
+
+  /*
+  .. Next half edge of a star (of the faces 'f'), after 'e', or
+  .. HMESH_NODE_NULL once it's back to 'start' (or at a boundary)
+  */
+  static inline
+  Node hmesh_tri_star_next (HmeshCells * f, Node e, Node start)
+  {
+    Node t = HMESH_TRI_TWIN (f, e);
+    if (t.index == HMESH_INDEX_NULL)
+      return HMESH_NODE_NULL;
+    Node n = hmesh_tri_next (t);
+    return (n.index == start.index && n.iblock == start.iblock) ?
+      HMESH_NODE_NULL : n;
+  }
+
+  /*
+  .. "HmeshStars" : state of HMESH_FOREACH_STARS (). Stars of the worklist
+  .. [w0, w0 + g) are walked, 'left' of them are not yet done. 'edge[k]' is
+  .. the current half edge of the star 'k' (HMESH_NODE_NULL once it's done),
+  .. 'k' is the star of the body, 'e' its half edge and 'w' (= w0 + k) its
+  .. position in the worklist.
+  */
+  #define HMESH_STAR_BATCH 16
+  typedef struct
+  {
+    Node * work, start [HMESH_STAR_BATCH], edge [HMESH_STAR_BATCH], e;
+    size_t n, w0, w;
+    int g, k, left;
+  } HmeshStars;
+
+  static inline
+  HmeshStars hmesh_stars (Node * work, size_t n)
+  {
+    HmeshStars s;
+    s.work = work;
+    s.n = n;
+    s.w0 = s.w = 0;
+    s.g = s.left = 0;
+    s.k = -1;
+    return s;
+  }
+
+  static inline
+  int hmesh_stars_next (HmeshCells * c, HmeshStars * s)
+  {
+    /* one hop of the star of the previous body */
+    if (s->k >= 0)
+    {
+      Node e = s->edge [s->k], t = HMESH_TWIN (c, e),
+        n = (t.index == HMESH_INDEX_NULL) ? t : HMESH_NEXT (c, t);
+      if ( n.index == HMESH_INDEX_NULL || (n.index == s->start[s->k].index &&
+           n.iblock == s->start[s->k].iblock) )
+      {
+        s->edge [s->k] = HMESH_NODE_NULL;
+        --s->left;
+      }
+      else
+      {
+        s->edge [s->k] = n;
+        HMESH_PREFETCH_NODE (c, c->k + 4, n);
+      }
+    }
+
+    /* next batch of stars */
+    while (!s->left)
+    {
+      s->w0 += s->g;
+      if (s->w0 >= s->n)
+        return 0;
+      s->g = (s->n - s->w0 < HMESH_STAR_BATCH) ? (int) (s->n - s->w0) :
+        HMESH_STAR_BATCH;
+      for (int k = 0; k < s->g; ++k)
+      {
+        s->start[k] = s->edge[k] = s->work [s->w0 + k];
+        HMESH_PREFETCH_NODE (c, c->k + 4, s->edge[k]);
+      }
+      s->left = s->g;
+      s->k = -1;
+    }
+
+    /* next star (round robin) which is not done */
+    do
+      s->k = (s->k + 1 == s->g) ? 0 : s->k + 1;
+    while (s->edge [s->k].index == HMESH_INDEX_NULL);
+    s->w = s->w0 + s->k;
+    s->e = s->edge [s->k];
+    return 1;
+  }
+
+  /*
+  .. "HmeshRemap" : new nodes of the nodes moved by a compaction.
+  .. 'node[iblock][index]' : new node of the node {index, iblock}, or
+  .. HMESH_NODE_NULL for a free slot. It's NULL, if no node of 'iblock' is
+  .. moved.
+  .. 'max' : size of 'node'
+  .. 'bsize' : number of nodes per block
+  .. NOTE : nodes out of range (Ex: unset references) are not remapped
+  */
+  typedef struct
+  {
+    Node ** node;
+    Index max, bsize;
+  } HmeshRemap;
+
+  static inline
+  Node hmesh_remap_node (HmeshRemap * remap, Node node)
+  {
+    return (node.iblock < remap->max && node.index < remap->bsize &&
+      remap->node [node.iblock]) ?
+      remap->node [node.iblock][node.index] : node;
+  }
+
+  /*
+  .. Typed attributes of Real per node : scalar, vec2, vec3 or a symmetric
+  .. tensor {xx, xy, xz, yy, yz, zz}, with a layout
+  .. HMESH_LAYOUT_SOA   : an array per component (like the position x.x, ..)
+  .. HMESH_LAYOUT_AOS   : an array of 'stride' Reals per node
+  .. HMESH_LAYOUT_AOSOA : an array of tiles of HMESH_TILE nodes, where a tile
+  .. stores the HMESH_TILE values of each component, one after other.
+  .. 'stride' is the number of components, padded to a power of 2 (vec3 to
+  .. 4, tensor to 8), as the tree pool serves objects of 2^N bytes. So AoS
+  .. and AoSoA need a tree pool of depth >= 4 (vec2), 5 (vec3) for double.
+  .. A tensor of double (64 bytes) is available only in SoA.
+  .. "HmeshAttr" : 'iattr' of each component (SoA), or of the attribute
+  .. ('iattr[0]' for AoS, AoSoA). Unused 'iattr' are HMESH_INDEX_NULL.
+  .. Accessors of the component 'i' of a node (no branches on the layout)
+  .. HMESH_SOA_COMP, HMESH_AOS_COMP, HMESH_AOSOA_COMP
+  .. NOTE : as HMESH_SCALAR, they read the block as it is. Once a snapshot
+  .. is taken, write the block got once through HMESH_WRITE instead.
+  */
+  #define HMESH_TILE      8
+  #define HMESH_MAX_NCOMP 6
+
+  typedef enum
+  {
+    HMESH_TYPE_SCALAR    = 1,
+    HMESH_TYPE_VEC2      = 2,
+    HMESH_TYPE_VEC3      = 3,
+    HMESH_TYPE_SYMTENSOR = 6
+  } HmeshType;
+
+  typedef enum
+  {
+    HMESH_LAYOUT_SOA = 0,
+    HMESH_LAYOUT_AOS,
+    HMESH_LAYOUT_AOSOA
+  } HmeshLayout;
+
+  typedef struct
+  {
+    Index iattr [HMESH_MAX_NCOMP];
+    int ncomp, stride, layout;
+  } HmeshAttr;
+
+  #define HMESH_SOA_COMP(_c_, _a_, _i_, _hnode_)                              \
+    HMESH_SCALAR(_c_, (_a_).iattr[_i_], _hnode_)
+  #define HMESH_AOS_COMP(_c_, _a_, _i_, _hnode_)                              \
+    ( HMESH_REAL(_c_, (_a_).iattr[0], (_hnode_).iblock)                       \
+        [(_hnode_).index * (_a_).stride + (_i_)] )
+  #define HMESH_AOSOA_COMP(_c_, _a_, _i_, _hnode_)                            \
+    ( HMESH_REAL(_c_, (_a_).iattr[0], (_hnode_).iblock)                       \
+        [((_hnode_).index & ~(HMESH_TILE - 1)) * (_a_).stride +               \
+         (_i_) * HMESH_TILE + ((_hnode_).index & (HMESH_TILE - 1))] )
+
+  /*
+  .. "HmeshKernel" : kernel of hmesh_cells_foreach (), called for each block
+  .. 'iblock' in use of the cells. 'data' is passed as it is. 'r' is the
+  .. value of the block to be reduced (NULL if there is no reduction).
+  .. "HmeshReduce" : reduction of the values of the blocks
+  */
+  typedef void (* HmeshKernel) ( HmeshCells *, Index iblock, void * data,
+                                 Real * r );
+  typedef enum
+  {
+    HMESH_REDUCE_NONE = 0,
+    HMESH_REDUCE_SUM,
+    HMESH_REDUCE_MIN,
+    HMESH_REDUCE_MAX
+  } HmeshReduce;
+
+  /*
+  .. "HmeshCurve" : space filling curve of hmesh_reorder ()
+  .. HMESH_CURVE_MORTON  : Z-order (bit interleaving of the coordinates)
+  .. HMESH_CURVE_HILBERT : Hilbert curve, i.e. no jumps between the nodes
+  .. consecutive along the curve, at a slightly higher cost of the keys
+  */
+  typedef enum
+  {
+    HMESH_CURVE_MORTON = 0,
+    HMESH_CURVE_HILBERT
+  } HmeshCurve;
+
   /*
   .. Hmesh: Mesh or a discretized manifold 
   .. 
@@ -134,13 +626,46 @@ extern "C" {
     HmeshCells * p, * e, * t, * v; 
   } Hmesh;
 
+  /*
+  .. "HmeshTris" : triangulated surface in R^D with implicit half edges
+  .. (see HMESH_TRI_PIVOT). 'p' are the vertices (as 'p' of Hmesh), and
+  .. 'f' are the faces, with the attributes 'sub.0', 'sub.1', 'sub.2'
+  .. (vertices, counter clockwise) and 'twin.0', 'twin.1', 'twin.2' (twin
+  .. of the half edge of each corner). There is no 'next' stored, and there
+  .. are no edge cells, so that a half edge takes 8 bytes (with the default
+  .. HMESH_INDEX_BITS) and a face takes 4 bytes more for map & imap.
+  */
+  typedef struct
+  {
+    int D;
+    HmeshCells * p, * f;
+  } HmeshTris;
+
+  /*
+  .. "HmeshRemesh" : target edge lengths of a remeshed surface (as _regrid
+  .. of src/backup/hmesh-remesh.h). An edge longer than 'amax' is split, and
+  .. an edge shorter than 'amin' is collapsed. The longest edge of a
+  .. triangle with a quality (4 sqrt(3) area / sum of the squares of the
+  .. edges, 1 for an equilateral triangle) below 'quality' is split too,
+  .. unless the other edges are shorter than amin/2.
+  */
+  typedef struct
+  {
+    Real amin, amax, quality;
+  } HmeshRemesh;
+
   /*
   .. APIs
   .. (*) hmesh_cells () : Create cells of dim 'd' in Eulerain space R^D
   .. (*) hmesh_cells_destroy () : destroy HmeshCells
   .. (*) hmesh_scalar_new () :  add a scalar attribute (Real i.e float/double)
-  .. to HmeshCells
+  .. to HmeshCells (names starting with '_' are reserved for the library)
+  .. (*) hmesh_scalar_new_precision () : add a scalar of 32 (float) or 64
+  .. (double) bits, irrespective of the precision of Real
   .. (*) hmesh_scalar_remove () :  remove a scalar attribute
+  .. (*) hmesh_scalar_get () : index of the attribute 'name' (to be used with
+  .. HMESH_SCALAR () etc), or HMESH_INDEX_NULL. Lookup is O(1), so get it
+  .. once, and keep it out of the loops
   .. (*) hmesh () : to create a mesh of manidold dim 'd' in Eulerian space R^D
   .. Warning! it creates a mesh with no points, edges, ..
   .. (*) hmesh_destroy () : destroy a mesh
@@ -149,18 +674,119 @@ extern "C" {
   .. Every time you manipulate with HmeshArray, you send 
   .. the pointer of 2D array of block address. 
   .. (*) add a node to the set of cells
+  .. (*) add 'n' nodes to the set of cells. Returns no: of nodes added
   .. (*) remove a node from the set of cells
+  .. (*) hmesh_array_reserve () : reserve metadata of HmeshArray for blocks
+  .. (*) hmesh_cells_reserve () : reserve metadata of all attributes of
+  .. HmeshCells for 'nnodes' nodes
+  .. (*) hmesh_cells_compact () : move nodes of sparse blocks to dense blocks
+  .. (*) hmesh_cells_remap () : update a Node attribute after a compaction
+  .. (*) hmesh_remap_free () : free the remap table of a compaction
+  .. (*) hmesh_compact () : compact all cells of a mesh
+  .. (*) hmesh_cells_reorder () : move the nodes into new dense blocks in the
+  .. given order (a permutation of all the nodes in use)
+  .. (*) hmesh_reorder () : renumber all cells of a mesh along a space filling
+  .. curve, so that the nodes near in space are near in memory
+  .. (*) hmesh_attr_new () : add a typed attribute (scalar, vec2, vec3, sym.
+  .. tensor) with a layout (SoA, AoS, AoSoA)
+  .. (*) hmesh_attr_remove () : remove a typed attribute
+  .. (*) hmesh_nodes_sort () : sort a list of nodes by (iblock, index), so
+  .. that a gather from the nodes of the list is in the order of memory
+  .. (*) hmesh_cells_snapshot () : copy-on-write snapshot of HmeshCells, that
+  .. shares the blocks with the cells until either of them writes a block
+  .. (*) hmesh_cells_write () : address of a block to be written, copied
+  .. before if it's shared (use HMESH_WRITE ())
+  .. (*) hmesh_cells_unshare () : hmesh_cells_write () all attributes of a
+  .. block
+  .. (*) hmesh_snapshot () : snapshot of all cells of a mesh (rollback point)
+  .. (*) hmesh_hedges_new () : add the half edges of triangles (given by
+  .. their vertices), with 'next' and 'twin' set. Walks are slow, until
+  .. hmesh_reorder () is called
+  .. (*) hmesh_hedges_valid () : verify the half edges of a surface
+  .. (*) hmesh_tris () : create a triangulated surface with implicit half
+  .. edges (HmeshTris), with no vertices or faces
+  .. (*) hmesh_tris_destroy () : destroy HmeshTris
+  .. (*) hmesh_tris_faces_new () : add triangles (given by their vertices),
+  .. with the twins set
+  .. (*) hmesh_tris_valid () : verify the half edges of HmeshTris
+  .. (*) hmesh_tris_compact () : compact the vertices and the faces of
+  .. HmeshTris, with the vertices and the twins of the faces updated
+  .. (*) hmesh_tris_reorder () : renumber the vertices and the faces of
+  .. HmeshTris along a space filling curve, as hmesh_reorder ()
+  .. (*) hmesh_tris_split () : split an edge (and the faces on either side)
+  .. at a new vertex, as hedge_split () & hface_split ()
+  .. (*) hmesh_tris_collapse () : collapse an edge (and the faces on either
+  .. side) to its pivot, as hedge_collapse () & hface_collapse ()
+  .. (*) hmesh_tris_refine () : split all the edges to be split (HmeshRemesh)
+  .. in parallel passes, as hmesh_split () of src/backup/hmesh-remesh.h
+  .. (*) hmesh_tris_coarsen () : collapse all the edges shorter than amin
+  .. in parallel passes of independent edges, as hmesh_collapse ()
+  .. (*) hmesh_tris_remesh () : split/collapse the edges of (or all) the
+  .. faces given, worst first, with a heap, as hmesh_remesh ()
+  .. (*) hmesh_cells_foreach () : run a kernel over the blocks in use of
+  .. HmeshCells in parallel, with an optional reduction
+  .. (*) hmesh_threads () : set number of threads of hmesh_cells_foreach ()
+  .. (<= 0 : number of processors, which is the default)
+  .. (*) hmesh_threads_get () : number of threads of hmesh_cells_foreach ()
+  .. (*) hmesh_threads_destroy () : join the threads of hmesh_cells_foreach ()
   */
   extern HmeshCells * hmesh_cells         ( int k, int K, int D );
   extern int          hmesh_cells_destroy ( HmeshCells * );
   extern HmeshArray * hmesh_scalar_new    ( HmeshCells *, char * );
+  extern HmeshArray * hmesh_scalar_new_precision ( HmeshCells *, char *,
+                                                   int precision );
   extern int          hmesh_scalar_remove ( HmeshCells *, char * );
+  extern Index        hmesh_scalar_get    ( HmeshCells *, char * );
   extern Hmesh *      hmesh               ( int K, int D);
   extern int          hmesh_destroy       ( Hmesh *);
   extern HmeshArray * hmesh_array ( char * name, size_t size, void *** );
   extern int          hmesh_array_destroy ( HmeshArray *, void *** );
   extern Node         hmesh_node_new      ( HmeshCells *);
+  extern size_t       hmesh_nodes_new     ( HmeshCells *, size_t, Node * );
   extern int          hmesh_node_remove   ( HmeshCells *, Node);
+  extern int          hmesh_array_reserve ( HmeshArray *, Index, void *** );
+  extern int          hmesh_cells_reserve ( HmeshCells *, size_t nnodes );
+  extern int          hmesh_cells_compact ( HmeshCells *, HmeshRemap * );
+  extern int          hmesh_cells_remap   ( HmeshCells *, Index,
+                                            HmeshRemap * );
+  extern void         hmesh_remap_free    ( HmeshRemap * );
+  extern int          hmesh_compact       ( Hmesh * );
+  extern int          hmesh_cells_reorder ( HmeshCells *, Node *, size_t,
+                                            HmeshRemap * );
+  extern int          hmesh_reorder       ( Hmesh *, HmeshCurve );
+  extern int          hmesh_attr_new      ( HmeshCells *, char *, HmeshType,
+                                            HmeshLayout, HmeshAttr * );
+  extern int          hmesh_attr_remove   ( HmeshCells *, HmeshAttr * );
+  extern int          hmesh_nodes_sort    ( Node *, size_t );
+  extern HmeshCells * hmesh_cells_snapshot ( HmeshCells * );
+  extern void *       hmesh_cells_write   ( HmeshCells *, Index iattr,
+                                            Index iblock );
+  extern int          hmesh_cells_unshare ( HmeshCells *, Index iblock );
+  extern Hmesh *      hmesh_snapshot      ( Hmesh * );
+  extern int          hmesh_hedges_new    ( Hmesh *, Node (*)[3], size_t,
+                                            Node * );
+  extern int          hmesh_hedges_valid  ( Hmesh * );
+  extern HmeshTris *  hmesh_tris          ( int D );
+  extern int          hmesh_tris_destroy  ( HmeshTris * );
+  extern int          hmesh_tris_faces_new ( HmeshTris *, Node (*)[3], size_t,
+                                             Node * );
+  extern int          hmesh_tris_valid    ( HmeshTris * );
+  extern int          hmesh_tris_compact  ( HmeshTris * );
+  extern int          hmesh_tris_reorder  ( HmeshTris *, HmeshCurve );
+  extern Node         hmesh_tris_split    ( HmeshTris *, Node );
+  extern int          hmesh_tris_collapse ( HmeshTris *, Node );
+  extern int          hmesh_tris_refine   ( HmeshTris *, HmeshRemesh *,
+                                            size_t * nsplit );
+  extern int          hmesh_tris_coarsen  ( HmeshTris *, HmeshRemesh *,
+                                            size_t * ncollapse );
+  extern int          hmesh_tris_remesh   ( HmeshTris *, HmeshRemesh *,
+                                            Node * face, size_t nface,
+                                            size_t * nops );
+  extern int          hmesh_cells_foreach ( HmeshCells *, HmeshKernel,
+                                            void *, HmeshReduce, Real * );
+  extern int          hmesh_threads       ( int nthreads );
+  extern int          hmesh_threads_get   ( );
+  extern void         hmesh_threads_destroy ( );
 
   /* Make these 2 function local */
   extern void *       hmesh_array_add ( HmeshArray *, Index, void *** );
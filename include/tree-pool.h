@@ -1,7 +1,9 @@
 /*
-.. TODO : Thread safety
-.. (a) mutex lock would be ideal, as atomic insertion/deletion
-.. might be too complex for a double linked list of free pool nodes.
+.. Thread safety : By default the tree pool is not thread safe. Calling
+.. hmesh_tpool_concurrent (1) switches to a concurrent mode, where the
+.. (double linked) free lists of the buddy tree are guarded by a mutex lock
+.. and each thread keeps a small cache of free blocks per depth. The shared
+.. tree is only touched to refill or drain a cache in batches.
 */
 
 #ifndef _HMESH_TREE_POOL_
@@ -15,7 +17,8 @@ extern "C" {
   .. Large chunk memory of order of ~8MB is allocated using mmap().
   .. It is used as a memory pool for arrays of [BLOCK_SIZE * OBJ_SIZE],
   .. where BLOCK_SIZE is fixed, and OBJ_SIZE in {2^N} := {1,2,4,8} 
-  .. (in worst case scenarios you can expand this to {1,2,4,8,16,32}).
+  .. (in worst case scenarios you can expand this to {1,2,4,8,16,32}, by
+  .. setting HMESH_TREE_POOL_DEPTH to 5).
   .. When you use SoA (Structure of Arrays of basic datatypes),you can 
   .. make sure that object_size are in {1,2,4,8 bytes} for a 64 bit 
   .. processor. So a tree allocator can be used to allocate memory 
@@ -31,13 +34,45 @@ extern "C" {
   #define HMESH_PAGE_SIZE (1<<12)
   
   /*
-  .. We restrict the max depth to 3. So all the common datatypes can be
-  .. represented
+  .. Max depth of the tree. Default depth of 3 serves objects of
+  .. {1,2,4,8} bytes. Depth can be set upto 5 at compile time
+  .. (-DHMESH_TREE_POOL_DEPTH=5), so that objects of 16 or 32 bytes (vec2,
+  .. vec3 of Real, tensors, ..) can be stored in a single block.
+  .. NOTE : the library and the code using it should be compiled with the
+  .. same depth. hmesh_tpool_depth () returns the depth of the library.
+  .. A tree of 8MB has 2^12 nodes, irrespective of the depth, and the depth
+  .. is stored in 3 bits, so the BlockID layout doesn't change with depth.
   */
   #ifndef HMESH_TREE_POOL_DEPTH
   #define HMESH_TREE_POOL_DEPTH 3
   #endif
+  #if HMESH_TREE_POOL_DEPTH < 1 || HMESH_TREE_POOL_DEPTH > 5
+  #error "HMESH_TREE_POOL_DEPTH should be in [1, 5]"
+  #endif
+
+  /*
+  .. Number of free blocks (per depth) cached by each thread in concurrent
+  .. mode. A thread refills (or drains) half of its cache at once.
+  */
+  #ifndef HMESH_TPOOL_CACHE_SIZE
+  #define HMESH_TPOOL_CACHE_SIZE 32
+  #endif
   
+  /*
+  .. "BlockID" : handle of a block in the tree pool. The last
+  .. HMESH_TPOOL_NODE_BITS bits store the node index (inode) in a tree, the
+  .. next 3 bits store the depth of the block, and the rest (17 bits) are used
+  .. to store the tree number (itree). A tree of 8MB has 4096 nodes,
+  .. irrespective of the depth. HMESH_TPOOL_NULL is reserved and used in place
+  .. of NULL.
+  */
+  typedef uint32_t BlockID;
+
+  #define HMESH_TPOOL_NULL       UINT32_MAX
+  #define HMESH_TPOOL_NODE_BITS  12
+  #define HMESH_TPOOL_NODE_MASK  ((1 << HMESH_TPOOL_NODE_BITS) - 1)
+  #define HMESH_TPOOL_TREE_SHIFT (HMESH_TPOOL_NODE_BITS + 3)
+
   /* 
   .. Linked list of free blocks.
   .. 'prev' & 'next' : to form a linked list of empty blocks.
@@ -46,22 +81,72 @@ extern "C" {
   typedef struct FreeTBlock
   {
     struct FreeTBlock * prev, * next;
-    Index blockID; 
+    BlockID blockID;
   } FreeTBlock;
   
+  /*
+  .. Backing of the tree pool memory. By default a tree is backed by 4KB
+  .. pages. It's opt-in (hmesh_tpool_backing ()) to ask for,
+  .. HMESH_TPOOL_HUGETLB : explicit huge pages, mmap (MAP_HUGETLB)
+  .. HMESH_TPOOL_THP     : transparent huge pages, madvise (MADV_HUGEPAGE)
+  .. HMESH_TPOOL_NUMA    : memory bound to a NUMA node, mbind ()
+  .. If not available, tree falls back to 4KB pages (and/or unbound memory)
+  */
+  enum HMESH_TPOOL_BACKING
+  {
+    HMESH_TPOOL_PAGES   = 0,
+    HMESH_TPOOL_HUGETLB = 1,
+    HMESH_TPOOL_THP     = 2,
+    HMESH_TPOOL_NUMA    = 4
+  };
+
   /* 
   .. 'root' : address of each root node
   .. 'flags' : info on each nodes correspodning to memory blocks,
   .. Encodes depth, is a free/used node etc
+  .. 'share' : number of extra owners of each block in use (0 : a single
+  .. owner). See hmesh_tpool_share ()
   .. 'size' : size of root. For munmap()
+  .. 'backing' : backing obtained (HMESH_TPOOL_BACKING)
+  .. 'node' : NUMA node, the tree is bound to. (-1 if not bound)
+  .. 'nused' : number of blocks in use. Tree can be trimmed, if it's 0.
+  .. 'next' : root chunks in [next, size/root size) are not yet committed
+  .. (untouched memory, not in free lists, and with no valid flags)
+  .. NOTE : a trimmed tree has 'root' = NULL
   */
   typedef struct
   {
     void * root;
-    uint8_t * flags;  
-    size_t size;
+    uint8_t * flags, * share;
+    size_t size, nused, next;
+    int backing, node;
   } HmeshTpool;
   
+  /*
+  .. Statistics of the tree pool (hmesh_tpool_stats ()).
+  .. 'nfree[depth]' : number of free blocks of depth 'depth' (in free lists)
+  .. 'nused[depth]' : number of blocks of depth 'depth' in use
+  .. 'ntrees' : number of trees (arenas) mapped
+  .. 'mapped' & 'peak' : bytes mapped, and the maximum bytes ever mapped
+  .. 'used' & 'free' : bytes in use, and bytes free. 'free' includes the
+  .. root chunks that are not yet committed.
+  .. 'fragmentation' : fraction of 'free' bytes that are not in free root
+  .. chunks (i.e. can only serve blocks smaller than the largest). It's 0, if
+  .. there is no free memory or if all of it is in root chunks.
+  .. 'nalloc', 'ndealloc', 'nsplit', 'ncoalesce' : cumulative number of
+  .. blocks allocated, deallocated, divided and coalesced.
+  .. NOTE : in the concurrent mode, blocks cached by threads are counted as in
+  .. use (and are not counted in 'nalloc'/'ndealloc' until they return to the
+  .. tree). Call hmesh_tpool_flush () in each thread before, if needed.
+  */
+  typedef struct
+  {
+    size_t nfree [HMESH_TREE_POOL_DEPTH + 1], nused [HMESH_TREE_POOL_DEPTH + 1];
+    size_t ntrees, mapped, peak, used, free;
+    double fragmentation;
+    size_t nalloc, ndealloc, nsplit, ncoalesce;
+  } HmeshTpoolStats;
+
   /* 
   .. Allocate a block of 
   .. [HMESH_TREE_POOL_SIZE] X [2^d],
@@ -72,16 +157,38 @@ extern "C" {
   .. Get the memory address from starting index
   .. Deallocate
   .. Free all. @ the end of pgm
+  .. Switch on/off the concurrent mode. Returns the previous mode.
+  .. Return the blocks cached by the calling thread to the tree pool.
+  .. NOTE : a thread cache is flushed automatically when the thread exits.
+  .. Request a backing for trees created hereafter. Returns previous mode.
+  .. Bind an existing tree to a NUMA node.
+  .. Return empty trees to OS. Returns the bytes unmapped.
+  .. Set the bytes of empty trees kept mapped, before automatic trimming.
+  .. Max depth of the tree, the library is compiled with.
+  .. Get the statistics of the tree pool.
+  .. Add an owner to a block in use (Ex: a copy-on-write snapshot). A block
+  .. is returned to the pool only when all its owners deallocate it.
+  .. Number of extra owners of a block (0 : the caller is the only owner).
   ..
   */
-  extern Index  hmesh_tpool_allocate         ( int depth ); 
-  extern Index  hmesh_tpool_allocate_general ( size_t obj_size ); 
-  extern Index  hmesh_tpool_allocate_page    ( );
-  extern void * hmesh_tpool_address          ( Index blockID );
-  extern int    hmesh_tpool_deallocate       ( Index blockID );
-  extern void   hmesh_tpool_destroy          ( );
-  extern HmeshTpool * hmesh_tpool_tree       ( int itree );
-  extern size_t hmesh_tpool_block_size       ( );
+  extern BlockID hmesh_tpool_allocate         ( int depth );
+  extern BlockID hmesh_tpool_allocate_general ( size_t obj_size );
+  extern BlockID hmesh_tpool_allocate_page    ( );
+  extern void *  hmesh_tpool_address          ( BlockID blockID );
+  extern int     hmesh_tpool_deallocate       ( BlockID blockID );
+  extern void    hmesh_tpool_destroy          ( );
+  extern HmeshTpool * hmesh_tpool_tree        ( int itree );
+  extern size_t  hmesh_tpool_block_size       ( );
+  extern int     hmesh_tpool_concurrent       ( int enable );
+  extern void    hmesh_tpool_flush            ( );
+  extern int     hmesh_tpool_backing          ( int mode, int node );
+  extern int     hmesh_tpool_bind             ( int itree, int node );
+  extern size_t  hmesh_tpool_trim             ( );
+  extern size_t  hmesh_tpool_trim_limit       ( size_t bytes );
+  extern int     hmesh_tpool_depth            ( );
+  extern int     hmesh_tpool_stats            ( HmeshTpoolStats * stats );
+  extern int     hmesh_tpool_share            ( BlockID blockID );
+  extern int     hmesh_tpool_shared           ( BlockID blockID );
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,241 @@
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+.. Thread pool of hmesh_cells_foreach (). The workers are created at the
+.. first parallel call and wait for a job. A job is a kernel over the blocks
+.. in use of 'cells'. Blocks are handed out one by one (dynamic scheduling)
+.. using 'next', so that threads which are done early take more blocks.
+.. 'gen' : counter of jobs, a worker runs a job when 'gen' changes
+.. 'active' : number of workers still running the current job
+.. 'busy' : a job is running. A nested call runs serially.
+*/
+typedef struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t start, done;
+  pthread_t * thread;
+  int nthreads, nworkers, running, active, busy;
+  unsigned long gen;
+  size_t next, n;
+  HmeshCells * cells;
+  HmeshKernel kernel;
+  void * data;
+  Real * partial;
+} HmeshThreads;
+
+static HmeshThreads HMESH_THREADS = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .start = PTHREAD_COND_INITIALIZER,
+  .done = PTHREAD_COND_INITIALIZER
+};
+
+static
+void hmesh_threads_run (HmeshThreads * p)
+{
+  size_t i;
+  while ( (i = __atomic_fetch_add (&p->next, 1, __ATOMIC_RELAXED)) < p->n )
+    p->kernel (p->cells, p->cells->blocks->info[i].in_use, p->data,
+      p->partial ? &p->partial[i] : NULL);
+}
+
+static
+void * hmesh_threads_worker (void * arg)
+{
+  /* 'gen' at the creation, so that a job dispatched before is not missed */
+  unsigned long gen = (unsigned long) (uintptr_t) arg;
+  HmeshThreads * p = &HMESH_THREADS;
+  pthread_mutex_lock (&p->lock);
+  for (;;)
+  {
+    while (p->running && p->gen == gen)
+      pthread_cond_wait (&p->start, &p->lock);
+    if (!p->running)
+      break;
+    gen = p->gen;
+    pthread_mutex_unlock (&p->lock);
+    hmesh_threads_run (p);
+    pthread_mutex_lock (&p->lock);
+    if (!--p->active)
+      pthread_cond_signal (&p->done);
+  }
+  pthread_mutex_unlock (&p->lock);
+  return NULL;
+}
+
+/*
+.. Create 'nthreads - 1' workers (the calling thread is also one of them).
+.. Return the number of threads available.
+*/
+static
+int hmesh_threads_start (HmeshThreads * p, int nthreads)
+{
+  p->thread = malloc (nthreads * sizeof (pthread_t));
+  if (!p->thread)
+    return 1;
+  p->running = 1;
+  p->nworkers = 0;
+  while (p->nworkers < nthreads - 1 &&
+    !pthread_create (&p->thread[p->nworkers], NULL, hmesh_threads_worker,
+      (void *) (uintptr_t) p->gen))
+    ++p->nworkers;
+  return p->nworkers + 1;
+}
+
+/*
+.. "hmesh_threads_destroy ()" : join the workers of hmesh_cells_foreach ().
+.. They are created again at the next parallel call.
+*/
+void hmesh_threads_destroy ()
+{
+  HmeshThreads * p = &HMESH_THREADS;
+  pthread_mutex_lock (&p->lock);
+  p->running = 0;
+  pthread_cond_broadcast (&p->start);
+  pthread_mutex_unlock (&p->lock);
+  for (int i = 0; i < p->nworkers; ++i)
+    pthread_join (p->thread[i], NULL);
+  free (p->thread);
+  p->thread = NULL;
+  p->nworkers = 0;
+}
+
+/*
+.. "hmesh_threads ()" : set the number of threads used by
+.. hmesh_cells_foreach (). 'nthreads <= 0' uses the number of processors.
+.. Returns the number of threads set.
+*/
+int hmesh_threads (int nthreads)
+{
+  if (nthreads <= 0)
+  {
+    long nproc = sysconf (_SC_NPROCESSORS_ONLN);
+    nthreads = nproc > 0 ? (int) nproc : 1;
+  }
+  HmeshThreads * p = &HMESH_THREADS;
+  if (__atomic_exchange_n (&p->busy, 1, __ATOMIC_ACQUIRE))
+  {
+    hmesh_error ("hmesh_threads () : cannot be called inside a kernel");
+    return p->nthreads;
+  }
+  if (p->running && nthreads != p->nworkers + 1)
+    hmesh_threads_destroy ();
+  p->nthreads = nthreads;
+  __atomic_store_n (&p->busy, 0, __ATOMIC_RELEASE);
+  return nthreads;
+}
+
+/*
+.. "hmesh_threads_get ()" : number of threads used by hmesh_cells_foreach ()
+.. (set by hmesh_threads (), or the number of processors)
+*/
+int hmesh_threads_get ()
+{
+  int nthreads = __atomic_load_n (&HMESH_THREADS.nthreads, __ATOMIC_RELAXED);
+  if (nthreads <= 0)
+  {
+    long nproc = sysconf (_SC_NPROCESSORS_ONLN);
+    nthreads = nproc > 0 ? (int) nproc : 1;
+  }
+  return nthreads;
+}
+
+/*
+.. "hmesh_cells_foreach ()" : Call 'kernel (cells, iblock, data, r)' for each
+.. block 'iblock' in use of 'cells', in parallel.
+.. 'op' : reduction of the values '*r' set by the kernel. Each block has its
+.. own '*r', initialized to 0 (SUM), +inf (MIN) or -inf (MAX). They are
+.. reduced in the order of the blocks, so that the '*result' doesn't depend
+.. on the number of threads. 'r' is NULL, if 'op' is HMESH_REDUCE_NONE.
+.. NOTE : The kernel shouldn't insert/remove nodes of 'cells'. Different
+.. blocks can run concurrently, so that a kernel should only write to the
+.. block 'iblock'.
+*/
+int hmesh_cells_foreach (HmeshCells * cells, HmeshKernel kernel, void * data,
+  HmeshReduce op, Real * result)
+{
+  if (!cells || !kernel || (op != HMESH_REDUCE_NONE && !result))
+  {
+    hmesh_error ("hmesh_cells_foreach () : invalid arguments");
+    return HMESH_ERROR;
+  }
+
+  size_t n = cells->blocks->n;
+  Real identity = (op == HMESH_REDUCE_MIN) ? (Real) HUGE_VAL :
+    (op == HMESH_REDUCE_MAX) ? (Real) -HUGE_VAL : (Real) 0.;
+  Real * partial = NULL;
+  if (op != HMESH_REDUCE_NONE)
+  {
+    partial = malloc ((n ? n : 1) * sizeof (Real));
+    if (!partial)
+    {
+      hmesh_error ("hmesh_cells_foreach () : malloc failed");
+      return HMESH_ERROR;
+    }
+    for (size_t i = 0; i < n; ++i)
+      partial[i] = identity;
+  }
+
+  HmeshThreads * p = &HMESH_THREADS;
+  int nested = __atomic_exchange_n (&p->busy, 1, __ATOMIC_ACQUIRE),
+    serial = 1;
+  if (!nested)
+  {
+    if (!p->nthreads)
+    {
+      long nproc = sysconf (_SC_NPROCESSORS_ONLN);
+      p->nthreads = nproc > 0 ? (int) nproc : 1;
+    }
+    if (!p->running && p->nthreads > 1 && n > 1)
+      hmesh_threads_start (p, p->nthreads);
+    serial = !p->nworkers || n < 2;
+  }
+
+  if (serial)
+  {
+    for (size_t i = 0; i < n; ++i)
+      kernel (cells, cells->blocks->info[i].in_use, data,
+        partial ? &partial[i] : NULL);
+  }
+  else
+  {
+    pthread_mutex_lock (&p->lock);
+    p->cells = cells;
+    p->kernel = kernel;
+    p->data = data;
+    p->partial = partial;
+    p->n = n;
+    p->next = 0;
+    p->active = p->nworkers;
+    ++p->gen;
+    pthread_cond_broadcast (&p->start);
+    pthread_mutex_unlock (&p->lock);
+
+    hmesh_threads_run (p);
+
+    pthread_mutex_lock (&p->lock);
+    while (p->active)
+      pthread_cond_wait (&p->done, &p->lock);
+    pthread_mutex_unlock (&p->lock);
+  }
+
+  if (!nested)
+    __atomic_store_n (&p->busy, 0, __ATOMIC_RELEASE);
+
+  if (partial)
+  {
+    Real r = identity;
+    for (size_t i = 0; i < n; ++i)
+      r = (op == HMESH_REDUCE_SUM) ? r + partial[i] :
+          (op == HMESH_REDUCE_MIN) ? (partial[i] < r ? partial[i] : r) :
+                                     (partial[i] > r ? partial[i] : r);
+    *result = r;
+    free (partial);
+  }
+
+  return HMESH_NO_ERROR;
+}
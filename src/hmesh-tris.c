@@ -0,0 +1,1967 @@
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+#include <hmesh-private.h>
+#include <math.h>
+
+/*
+.. Triangulated surface with implicit half edges (HmeshTris). The pivot and
+.. twin of a half edge are written through HMESH_WRITE, as the faces may be
+.. shared with a snapshot.
+*/
+static inline
+void hmesh_tri_pivot_set (HmeshCells * f, Node e, Node v)
+{
+  ((Node *) HMESH_WRITE (f, HMESH_TRI_IVERTEX + e.index % 3, e.iblock))
+    [e.index / 3] = v;
+}
+
+static inline
+void hmesh_tri_twin_set (HmeshCells * f, Node e, Node t)
+{
+  if (e.index != HMESH_INDEX_NULL)
+    ((Node *) HMESH_WRITE (f, HMESH_TRI_ITWIN + e.index % 3, e.iblock))
+      [e.index / 3] = t;
+}
+
+/*
+.. "hmesh_tri_in_use ()" : 1 if the half edge 'e' is of a face in use
+*/
+static inline
+int hmesh_tri_in_use (HmeshCells * f, Node e)
+{
+  return e.index != HMESH_INDEX_NULL &&
+    hmesh_node_in_use (f, hmesh_tri_face (e));
+}
+
+static inline
+size_t hmesh_tri_slot (HmeshCells * f, Node e, int reverse, size_t mask)
+{
+  Node a = HMESH_TRI_PIVOT (f, e), b = HMESH_TRI_PIVOT (f, hmesh_tri_next (e));
+  HmeshHedgeKey key = { .v = { reverse ? b : a, reverse ? a : b } };
+  return hmesh_hash ((const char *) &key, sizeof (key)) & mask;
+}
+
+/*
+.. "hmesh_tris ()" : Create a triangulated surface in R^D with implicit half
+.. edges. The faces are 0-cells (with no position) whose attributes are
+.. added at HMESH_TRI_IVERTEX (sub.c) and HMESH_TRI_ITWIN (twin.c), and then
+.. they are marked as 2-cells.
+*/
+HmeshTris * hmesh_tris (int D)
+{
+  if ( (D < 2) || (D > 3) )
+  {
+    hmesh_error ("hmesh_tris () : D%d not in [2,3]", D);
+    return NULL;
+  }
+
+  HmeshTris * t = malloc (sizeof (HmeshTris));
+  t->D = D;
+  t->p = hmesh_cells (0, 2, D);
+  t->f = hmesh_cells (0, 0, 0);
+  if (!t->p || !t->f)
+  {
+    hmesh_error ("hmesh_tris () : hmesh_cells () failed");
+    hmesh_tris_destroy (t);
+    return NULL;
+  }
+
+  char sub [] = "sub.0", twin [] = "twin.0";
+  for (int c = 0; c < 3; ++c, sub[4]++, twin[5]++)
+    if ( index_stack_allocate (&t->f->scalars, HMESH_TRI_IVERTEX + c) ||
+         hmesh_attr_insert (t->f, HMESH_TRI_IVERTEX + c, sub,
+           sizeof (Node)) == HMESH_INDEX_NULL ||
+         index_stack_allocate (&t->f->scalars, HMESH_TRI_ITWIN + c) ||
+         hmesh_attr_insert (t->f, HMESH_TRI_ITWIN + c, twin,
+           sizeof (Node)) == HMESH_INDEX_NULL )
+    {
+      hmesh_error ("hmesh_tris () : cannot add '%s', '%s'", sub, twin);
+      hmesh_tris_destroy (t);
+      return NULL;
+    }
+  t->f->k = 2;
+  t->f->min = HMESH_TRI_ITWIN + 3;
+  t->f->tris = 1;
+
+  return t;
+}
+
+int hmesh_tris_destroy (HmeshTris * t)
+{
+  if (!t)
+    return HMESH_ERROR;
+  int status = HMESH_NO_ERROR;
+  if (t->p)
+    status |= hmesh_cells_destroy (t->p);
+  if (t->f)
+    status |= hmesh_cells_destroy (t->f);
+  free (t);
+  return status;
+}
+
+/* update the vertices (sub.c) of the faces of 't' to the moved vertices */
+static
+int hmesh_tris_remap_vertices (HmeshTris * t, HmeshRemap * remap)
+{
+  int status = HMESH_NO_ERROR;
+  if (remap->node)
+    for (int c = 0; c < 3; ++c)
+      status |= hmesh_cells_remap (t->f, HMESH_TRI_IVERTEX + c, remap);
+  hmesh_remap_free (remap);
+  return status;
+}
+
+/*
+.. "hmesh_tris_compact ()" : Compact the vertices and the faces of 't'
+.. (hmesh_cells_compact ()). The vertices of the faces are updated to the
+.. moved vertices, and the twins (half edges 3 f + c) to the moved faces.
+*/
+int hmesh_tris_compact (HmeshTris * t)
+{
+  if (!t)
+  {
+    hmesh_error ("hmesh_tris_compact () : aborted");
+    return HMESH_ERROR;
+  }
+  HmeshRemap remap;
+  int status = hmesh_cells_compact (t->p, &remap);
+  if (!status)
+    status = hmesh_tris_remap_vertices (t, &remap);
+  if (!status)
+    status = hmesh_cells_compact (t->f, NULL);
+  if (status)
+    hmesh_error ("hmesh_tris_compact () : failed");
+  return status;
+}
+
+/*
+.. "hmesh_tris_reorder ()" : Renumber the vertices and the faces of 't'
+.. along a space filling curve, as hmesh_reorder (). Vertices are sorted by
+.. the key of their position and faces by the key of their vertex 'sub.0'.
+.. The vertices and the twins of the faces are updated.
+*/
+int hmesh_tris_reorder (HmeshTris * t, HmeshCurve curve)
+{
+  if (!t || (curve != HMESH_CURVE_MORTON && curve != HMESH_CURVE_HILBERT))
+  {
+    hmesh_error ("hmesh_tris_reorder () : aborted");
+    return HMESH_ERROR;
+  }
+
+  Real lo[3], hi[3];
+  hmesh_bounds (t->p, t->D, lo, hi);
+  Index kp = hmesh_attr_add (t->p, "_key", sizeof (uint64_t)),
+    kf = hmesh_attr_add (t->f, "_key", sizeof (uint64_t));
+  HmeshRemap remap;
+  int status = (kp == HMESH_INDEX_NULL || kf == HMESH_INDEX_NULL) ?
+    HMESH_ERROR : hmesh_cells_curve (t->p, kp, NULL, HMESH_INDEX_NULL, t->D,
+      lo, hi, curve, &remap);
+  if (!status)
+    status = hmesh_tris_remap_vertices (t, &remap);
+  if (!status)
+    status = hmesh_cells_curve (t->f, kf, t->p, kp, t->D, lo, hi, curve,
+      NULL);
+
+  if (kp != HMESH_INDEX_NULL)
+    hmesh_attr_destroy (t->p, kp);
+  if (kf != HMESH_INDEX_NULL)
+    hmesh_attr_destroy (t->f, kf);
+  if (status)
+    hmesh_error ("hmesh_tris_reorder () : failed");
+  return status;
+}
+
+/*
+.. "hmesh_tris_faces_new ()" : Add the 'nface' triangles 'face' (3 vertices
+.. each, counter clockwise) to 't', as hmesh_hedges_new (). The twins are
+.. matched with all the half edges with an unset twin, so that faces can be
+.. added to an existing surface. A half edge with no match is a boundary.
+.. The new faces are stored in 'out', if not NULL.
+.. NOTE : A half edge repeated is an error, and the faces are not removed
+.. in that case.
+*/
+int hmesh_tris_faces_new (HmeshTris * t, Node (* face)[3], size_t nface,
+  Node * out)
+{
+  HmeshCells * v = t ? t->p : NULL, * f = t ? t->f : NULL;
+  if ( !f || (!face && nface) )
+  {
+    hmesh_error ("hmesh_tris_faces_new () : aborted");
+    return HMESH_ERROR;
+  }
+  for (size_t i = 0; i < nface; ++i)
+    for (int c = 0; c < 3; ++c)
+      if ( !hmesh_node_in_use (v, face[i][c]) ||
+           hmesh_node_same (face[i][c], face[i][(c + 1) % 3]) )
+      {
+        hmesh_error ("hmesh_tris_faces_new () : vertex %d of face %zu not "
+          "in use, or repeated", c, i);
+        return HMESH_ERROR;
+      }
+
+  Node * fn = out ? out : malloc ((nface ? nface : 1) * sizeof (Node));
+  if ( !fn || hmesh_nodes_new (f, nface, fn) != nface )
+  {
+    if (fn != out)
+      free (fn);
+    hmesh_error ("hmesh_tris_faces_new () : cannot add %zu faces", nface);
+    return HMESH_ERROR;
+  }
+
+  for (size_t i = 0; i < nface; ++i)
+  {
+    hmesh_cells_unshare (f, fn[i].iblock);
+    for (int c = 0; c < 3; ++c)
+    {
+      ((Node *) HMESH_ATTR (f, HMESH_TRI_IVERTEX + c, fn[i].iblock))
+        [fn[i].index] = face[i][c];
+      ((Node *) HMESH_ATTR (f, HMESH_TRI_ITWIN + c, fn[i].iblock))
+        [fn[i].index] = HMESH_NODE_NULL;
+    }
+  }
+  if (fn != out)
+    free (fn);
+
+  /* half edges with an unset twin, by (pivot, pivot of next) */
+  size_t nopen = 0;
+  HMESH_FOREACH_TRI_HEDGE (f, x)
+    nopen += (HMESH_TRI_TWIN (f, x).index == HMESH_INDEX_NULL);
+  size_t size = 1;
+  while (size < 2 * nopen)
+    size <<= 1;
+  Node * table = malloc (size * sizeof (Node));
+  int status = table ? HMESH_NO_ERROR : HMESH_ERROR;
+  for (size_t i = 0; table && i < size; ++i)
+    table[i] = HMESH_NODE_NULL;
+
+  HMESH_FOREACH_TRI_HEDGE (f, x)
+  {
+    if (!table || HMESH_TRI_TWIN (f, x).index != HMESH_INDEX_NULL)
+      continue;
+    Node a = HMESH_TRI_PIVOT (f, x),
+      b = HMESH_TRI_PIVOT (f, hmesh_tri_next (x));
+    size_t i = hmesh_tri_slot (f, x, 0, size - 1);
+    for (; table[i].index != HMESH_INDEX_NULL; i = (i + 1) & (size - 1))
+      if ( hmesh_node_same (HMESH_TRI_PIVOT (f, table[i]), a) &&
+           hmesh_node_same (HMESH_TRI_PIVOT (f, hmesh_tri_next (table[i])),
+             b) )
+      {
+        hmesh_error ("hmesh_tris_faces_new () : half edge [%d:%d] "
+          "repeated", x.iblock, x.index);
+        status = HMESH_ERROR;
+        break;
+      }
+    table[i] = x;
+  }
+
+  /* twin of (a, b) is (b, a) */
+  for (size_t j = 0; !status && j < size; ++j)
+  {
+    Node x = table[j];
+    if ( x.index == HMESH_INDEX_NULL ||
+         HMESH_TRI_TWIN (f, x).index != HMESH_INDEX_NULL )
+      continue;
+    Node a = HMESH_TRI_PIVOT (f, x),
+      b = HMESH_TRI_PIVOT (f, hmesh_tri_next (x));
+    for (size_t i = hmesh_tri_slot (f, x, 1, size - 1);
+         table[i].index != HMESH_INDEX_NULL; i = (i + 1) & (size - 1))
+      if ( hmesh_node_same (HMESH_TRI_PIVOT (f, table[i]), b) &&
+           hmesh_node_same (HMESH_TRI_PIVOT (f, hmesh_tri_next (table[i])),
+             a) )
+      {
+        hmesh_tri_twin_set (f, x, table[i]);
+        hmesh_tri_twin_set (f, table[i], x);
+        break;
+      }
+  }
+
+  free (table);
+  if (status)
+    hmesh_error ("hmesh_tris_faces_new () : failed");
+  return status;
+}
+
+/*
+.. "hmesh_tris_valid ()" : Verify the half edges of 't'. Returns 0 if valid,
+.. or the errors found (HmeshHedgeError), as hmesh_hedges_valid ()
+.. HMESH_HEDGE_UNSET : a vertex, or a twin (if set) is not a node in use
+.. HMESH_HEDGE_TWIN  : 'twin' of 'twin' is not the half edge, or the twins
+.. don't have the same vertices (reversed)
+.. HMESH_HEDGE_FACE  : a vertex is repeated in a face
+.. HMESH_HEDGE_STAR  : a half edge of the star of a vertex has a different
+.. pivot. Verified only if there are no other errors.
+*/
+int hmesh_tris_valid (HmeshTris * t)
+{
+  HmeshCells * v = t ? t->p : NULL, * f = t ? t->f : NULL;
+  if (!f)
+  {
+    hmesh_error ("hmesh_tris_valid () : aborted");
+    return HMESH_HEDGE_UNSET;
+  }
+
+  int error = HMESH_HEDGE_VALID;
+  HMESH_FOREACH_TRI_HEDGE (f, x)
+  {
+    Node a = HMESH_TRI_PIVOT (f, x),
+      b = HMESH_TRI_PIVOT (f, hmesh_tri_next (x)),
+      tw = HMESH_TRI_TWIN (f, x);
+    if (!hmesh_node_in_use (v, a))
+    {
+      error |= HMESH_HEDGE_UNSET;
+      continue;
+    }
+    if (hmesh_node_same (a, b))
+      error |= HMESH_HEDGE_FACE;
+    if (tw.index == HMESH_INDEX_NULL)
+      continue;
+    if (!hmesh_tri_in_use (f, tw))
+      error |= HMESH_HEDGE_UNSET;
+    else if ( !hmesh_node_same (HMESH_TRI_TWIN (f, tw), x) ||
+              !hmesh_node_same (HMESH_TRI_PIVOT (f, tw), b) ||
+              !hmesh_node_same (HMESH_TRI_PIVOT (f, hmesh_tri_next (tw)), a) )
+      error |= HMESH_HEDGE_TWIN;
+  }
+  if (error)
+    return error;
+
+  HMESH_FOREACH_TRI_HEDGE (f, x)
+  {
+    Node a = HMESH_TRI_PIVOT (f, x);
+    HMESH_FOREACH_TRI_STAR (f, x, s)
+      if (!hmesh_node_same (HMESH_TRI_PIVOT (f, s), a))
+      {
+        error |= HMESH_HEDGE_STAR;
+        break;
+      }
+  }
+  return error;
+}
+
+/*
+.. Split of the edge of 'e' at the new vertex 'm', with the new faces 'g'
+.. (1 at a boundary, 2 otherwise) of hmesh_tris_split (). It only writes
+.. the faces of 'e' and of its twin, 'g', and the twins of the half edges
+.. 'next' of them (in the faces adjacent), so that splits with none of
+.. these faces in common can be done in parallel.
+*/
+static
+Node hmesh_tri_split_at (HmeshTris * t, Node e, Node m, Node * g)
+{
+  HmeshCells * p = t->p, * f = t->f;
+  Node h[2] = { e, HMESH_TRI_TWIN (f, e) };
+  int nh = (h[1].index == HMESH_INDEX_NULL) ? 1 : 2;
+
+  Node a = HMESH_TRI_PIVOT (f, e), b = HMESH_TRI_PIVOT (f, hmesh_tri_next (e));
+  for (int d = 0; d < t->D; ++d)
+    HMESH_SCALAR_W (p, 2 + d, m) =
+      0.5 * (HMESH_SCALAR (p, 2 + d, a) + HMESH_SCALAR (p, 2 + d, b));
+
+  /* (a, b, c) => (a, m, c) & g = (m, b, c) */
+  for (int k = 0; k < nh; ++k)
+  {
+    Node n = hmesh_tri_next (h[k]), tn = HMESH_TRI_TWIN (f, n),
+      g0 = hmesh_tri_hedge (g[k], 0), g1 = hmesh_tri_hedge (g[k], 1),
+      g2 = hmesh_tri_hedge (g[k], 2);
+    hmesh_tri_pivot_set (f, g0, m);
+    hmesh_tri_pivot_set (f, g1, HMESH_TRI_PIVOT (f, n));
+    hmesh_tri_pivot_set (f, g2, HMESH_TRI_PIVOT (f, hmesh_tri_next (n)));
+    hmesh_tri_pivot_set (f, n, m);
+    hmesh_tri_twin_set (f, g1, tn);
+    hmesh_tri_twin_set (f, tn, g1);
+    hmesh_tri_twin_set (f, n, g2);
+    hmesh_tri_twin_set (f, g2, n);
+  }
+
+  /* (a, m) - (m, a) and (m, b) - (b, m) */
+  Node g0 = hmesh_tri_hedge (g[0], 0);
+  if (nh == 2)
+  {
+    Node _g0 = hmesh_tri_hedge (g[1], 0);
+    hmesh_tri_twin_set (f, h[0], _g0);
+    hmesh_tri_twin_set (f, _g0, h[0]);
+    hmesh_tri_twin_set (f, h[1], g0);
+    hmesh_tri_twin_set (f, g0, h[1]);
+  }
+  else
+    hmesh_tri_twin_set (f, g0, HMESH_NODE_NULL);
+
+  return g0;
+}
+
+/*
+.. "hmesh_tris_split ()" : Split the edge of the half edge 'e' at a new
+.. vertex at its mid point (other attributes of the vertex are to be set
+.. by the caller). Each face (a, b, c) on either side of the edge (a, b)
+.. is split into (a, m, c) and (m, b, c), as hedge_split () and
+.. hface_split () of src/backup/hmesh-remesh.h, i.e. a face with more
+.. edges to split is split by splitting them one after other. The faces of
+.. the half edges are kept, so that 'e' goes to 'm' after the split.
+.. Returns the half edge from 'm' to 'b', or HMESH_NODE_NULL on error.
+*/
+Node hmesh_tris_split (HmeshTris * t, Node e)
+{
+  HmeshCells * p = t ? t->p : NULL, * f = t ? t->f : NULL;
+  if ( !f || !hmesh_tri_in_use (f, e) )
+  {
+    hmesh_error ("hmesh_tris_split () : invalid half edge");
+    return HMESH_NODE_NULL;
+  }
+
+  Node g[2];
+  size_t nh = (HMESH_TRI_TWIN (f, e).index == HMESH_INDEX_NULL) ? 1 : 2;
+  Node m = hmesh_node_new (p);
+  if (m.index == HMESH_INDEX_NULL)
+  {
+    hmesh_error ("hmesh_tris_split () : cannot add a vertex");
+    return HMESH_NODE_NULL;
+  }
+  if (hmesh_nodes_new (f, nh, g) != nh)
+  {
+    hmesh_error ("hmesh_tris_split () : cannot add faces");
+    hmesh_node_remove (p, m);
+    return HMESH_NODE_NULL;
+  }
+
+  return hmesh_tri_split_at (t, e, m, g);
+}
+
+/*
+.. Half edges going out of the pivot of 'e' (at most 'max'), stored in
+.. 'star' if not NULL. Returns their number, or -1 if the star is open (a
+.. boundary vertex) or larger than 'max'.
+*/
+#define HMESH_TRIS_MAX_VALENCE 64
+static
+int hmesh_tri_star (HmeshCells * f, Node e, Node * star, int max)
+{
+  int n = 0;
+  Node s = e;
+  do
+  {
+    if (n == max)
+      return -1;
+    if (star)
+      star [n] = s;
+    ++n;
+    Node t = HMESH_TRI_TWIN (f, s);
+    if (t.index == HMESH_INDEX_NULL)
+      return -1;
+    s = hmesh_tri_next (t);
+  } while (!hmesh_node_same (s, e));
+  return n;
+}
+
+/*
+.. Star of 'b' in 'sb' (at most HMESH_TRIS_MAX_VALENCE), if the edge (a, b)
+.. of 'e' can be collapsed to 'a' (hmesh_tris_collapse ()), or -1. Only
+.. the faces of the stars of 'a' and 'b', and the face after them around
+.. 'x' and around 'y' (for their valence) are read.
+*/
+static
+int hmesh_tri_collapse_check (HmeshCells * f, Node e, Node * sb)
+{
+  Node te = HMESH_TRI_TWIN (f, e);
+  if (te.index == HMESH_INDEX_NULL)
+    return -1;
+
+  Node sa [HMESH_TRIS_MAX_VALENCE];
+  int na = hmesh_tri_star (f, e, sa, HMESH_TRIS_MAX_VALENCE),
+    nb = hmesh_tri_star (f, te, sb, HMESH_TRIS_MAX_VALENCE);
+  if ( na < 0 || nb < 0 ||
+       hmesh_tri_star (f, hmesh_tri_prev (e), NULL, 3) >= 0 ||
+       hmesh_tri_star (f, hmesh_tri_prev (te), NULL, 3) >= 0 )
+    return -1;
+  int ncommon = 0;
+  for (int i = 0; i < na; ++i)
+  {
+    Node u = HMESH_TRI_PIVOT (f, hmesh_tri_next (sa[i]));
+    for (int j = 0; j < nb; ++j)
+      ncommon += hmesh_node_same (u,
+        HMESH_TRI_PIVOT (f, hmesh_tri_next (sb[j])));
+  }
+  return ncommon == 2 ? nb : -1;
+}
+
+/*
+.. Collapse the edge of 'e' (star 'sb' of 'b', hmesh_tri_collapse_check ())
+.. with no node removed : the faces of 'e', its twin, and 'b' are not
+.. referred to anymore, and are removed by the caller.
+*/
+static
+void hmesh_tri_collapse_at (HmeshTris * t, Node e, Node * sb, int nb)
+{
+  HmeshCells * p = t->p, * f = t->f;
+  Node te = HMESH_TRI_TWIN (f, e),
+    a = HMESH_TRI_PIVOT (f, e), b = HMESH_TRI_PIVOT (f, te);
+  for (int d = 0; d < t->D; ++d)
+    HMESH_SCALAR_W (p, 2 + d, a) =
+      0.5 * (HMESH_SCALAR (p, 2 + d, a) + HMESH_SCALAR (p, 2 + d, b));
+  for (int j = 0; j < nb; ++j)
+    hmesh_tri_pivot_set (f, sb[j], a);
+
+  Node h[2] = { e, te };
+  for (int k = 0; k < 2; ++k)
+  {
+    Node tn = HMESH_TRI_TWIN (f, hmesh_tri_next (h[k])),
+      tp = HMESH_TRI_TWIN (f, hmesh_tri_prev (h[k]));
+    hmesh_tri_twin_set (f, tn, tp);
+    hmesh_tri_twin_set (f, tp, tn);
+  }
+}
+
+/*
+.. Collapse the edge of 'e', checked by hmesh_tri_collapse_check () ('sb'
+.. and 'nb' the star of 'b'), and remove its faces and 'b'. A failure
+.. leaves 't' half collapsed, and is an error.
+*/
+static
+int hmesh_tris_collapse_checked (HmeshTris * t, Node e, Node * sb, int nb)
+{
+  HmeshCells * p = t->p, * f = t->f;
+  Node te = HMESH_TRI_TWIN (f, e), b = HMESH_TRI_PIVOT (f, te);
+  hmesh_tri_collapse_at (t, e, sb, nb);
+
+  int status = hmesh_node_remove (f, hmesh_tri_face (e)) |
+    hmesh_node_remove (f, hmesh_tri_face (te)) | hmesh_node_remove (p, b);
+  if (status)
+    hmesh_error ("hmesh_tris_collapse () : cannot remove the faces");
+  return status;
+}
+
+/*
+.. "hmesh_tris_collapse ()" : Collapse the edge (a, b) of the half edge 'e'
+.. to its pivot 'a', which is moved to the mid point. The faces on either
+.. side (a, b, x) and (b, a, y) are removed, the twins of their other half
+.. edges are joined, the half edges of 'b' are moved to 'a', and 'b' is
+.. removed, as hedge_collapse () & hface_collapse () of
+.. src/backup/hmesh-remesh.h. Returns HMESH_NO_ERROR if collapsed.
+.. The collapse is abandoned (HMESH_ERROR, with no error message and with
+.. 't' unchanged), if the surface would not be a manifold anymore : 'a'
+.. and 'b' should have only 'x' and 'y' as common neighbours (link
+.. condition), 'x' and 'y' should have a valence > 3, and the stars of
+.. 'a' and 'b' should be closed (i.e. boundary edges are not collapsed).
+*/
+int hmesh_tris_collapse (HmeshTris * t, Node e)
+{
+  HmeshCells * f = t ? t->f : NULL;
+  if ( !f || !hmesh_tri_in_use (f, e) )
+  {
+    hmesh_error ("hmesh_tris_collapse () : invalid half edge");
+    return HMESH_ERROR;
+  }
+
+  Node sb [HMESH_TRIS_MAX_VALENCE];
+  int nb = hmesh_tri_collapse_check (f, e, sb);
+  if (nb < 0)
+    return HMESH_ERROR;
+  return hmesh_tris_collapse_checked (t, e, sb, nb);
+}
+
+/*
+.. Geometry of HmeshTris : position of the vertex 'v' (0 for the components
+.. >= D), square of the length of the edge of 'e', and square of the
+.. quality of the triangle 'x' as htriangle_quality () of
+.. src/backup/hmesh-surface.h (with the area, so that it's 1 for an
+.. equilateral triangle). Squares are compared, so that libm is not needed.
+*/
+static inline
+void hmesh_tri_position (HmeshTris * t, Node v, double * x)
+{
+  for (int d = 0; d < 3; ++d)
+    x[d] = (d < t->D) ? (double) HMESH_SCALAR (t->p, 2 + d, v) : 0.;
+}
+
+static inline
+double hmesh_tri_length2 (HmeshTris * t, Node e)
+{
+  double x[3], y[3], l = 0.;
+  hmesh_tri_position (t, HMESH_TRI_PIVOT (t->f, e), x);
+  hmesh_tri_position (t, HMESH_TRI_PIVOT (t->f, hmesh_tri_next (e)), y);
+  for (int d = 0; d < 3; ++d)
+    l += (y[d] - x[d]) * (y[d] - x[d]);
+  return l;
+}
+
+static
+double hmesh_tri_quality2 (double (* x)[3])
+{
+  double u[3], v[3], l2 = 0.;
+  for (int d = 0; d < 3; ++d)
+  {
+    u[d] = x[1][d] - x[0][d];
+    v[d] = x[2][d] - x[0][d];
+    l2 += u[d] * u[d] + v[d] * v[d] + (v[d] - u[d]) * (v[d] - u[d]);
+  }
+  double n[3] = { u[1]*v[2] - u[2]*v[1], u[2]*v[0] - u[0]*v[2],
+    u[0]*v[1] - u[1]*v[0] };
+  /* 4 sqrt(3) area / l2, with area = |n| / 2 */
+  return l2 > 0. ? 12. * (n[0]*n[0] + n[1]*n[1] + n[2]*n[2]) / (l2 * l2) :
+    0.;
+}
+
+/*
+.. hedge_split_criteria () of src/backup/hmesh-remesh.h : split the edge
+.. of 'e' if it's longer than 'amax', or if it's the longest edge of a
+.. triangle of a poor quality (HmeshRemesh)
+*/
+static
+int hmesh_tri_split_criteria (HmeshTris * t, Node e, HmeshRemesh * r)
+{
+  double x[3][3], l[3];
+  Node y = e;
+  for (int c = 0; c < 3; ++c, y = hmesh_tri_next (y))
+    hmesh_tri_position (t, HMESH_TRI_PIVOT (t->f, y), x[c]);
+  for (int c = 0; c < 3; ++c)
+  {
+    double * p = x[c], * q = x[(c + 1) % 3];
+    l[c] = (q[0] - p[0]) * (q[0] - p[0]) + (q[1] - p[1]) * (q[1] - p[1]) +
+      (q[2] - p[2]) * (q[2] - p[2]);
+  }
+  double amax = r->amax, amin = 0.5 * r->amin;
+  if (l[0] > amax * amax)
+    return 1;
+  if (l[0] < l[1] || l[0] < l[2])
+    return 0;
+  return hmesh_tri_quality2 (x) < r->quality * r->quality &&
+    l[1] > amin * amin && l[2] > amin * amin;
+}
+
+/*
+.. Positions 'x' of the vertices of 'face', and squared lengths 'l' of its
+.. edges (of the corner 'c' in 'l[c]')
+*/
+static
+void hmesh_tri_lengths2 (HmeshTris * t, Node face, double (* x)[3],
+  double * l)
+{
+  for (int c = 0; c < 3; ++c)
+    hmesh_tri_position (t, HMESH_TRI_PIVOT (t->f, hmesh_tri_hedge (face, c)),
+      x[c]);
+  for (int c = 0; c < 3; ++c)
+  {
+    double * p = x[c], * q = x[(c + 1) % 3];
+    l[c] = (q[0] - p[0]) * (q[0] - p[0]) + (q[1] - p[1]) * (q[1] - p[1]) +
+      (q[2] - p[2]) * (q[2] - p[2]);
+  }
+}
+
+/*
+.. Edges of 'face' to split, as hmesh_tri_split_criteria () of its half
+.. edges (the bit 'c' for the corner 'c'), with the vertices read once
+*/
+static
+int hmesh_tri_split_marks (HmeshTris * t, Node face, HmeshRemesh * r)
+{
+  double x[3][3], l[3], amax = r->amax * r->amax,
+    amin = 0.25 * r->amin * r->amin;
+  hmesh_tri_lengths2 (t, face, x, l);
+  int m = 0, poor = r->quality > 0. &&
+    hmesh_tri_quality2 (x) < r->quality * r->quality;
+  for (int c = 0; c < 3; ++c)
+  {
+    double l1 = l[(c + 1) % 3], l2 = l[(c + 2) % 3];
+    if ( l[c] > amax ||
+         (poor && l[c] >= l1 && l[c] >= l2 && l1 > amin && l2 > amin) )
+      m |= 1 << c;
+  }
+  return m;
+}
+
+/*
+.. Half edges read or written by the split of 'e' (hmesh_tri_split_at ()) :
+.. on either side, the half edge, its 'next' and the twin of its 'next'
+.. (only its twin is written). The half edge before is read only, and
+.. only a split of its 'next' writes it.
+*/
+static
+int hmesh_tri_split_claims (HmeshTris * t, Node e, Node * claim)
+{
+  HmeshCells * f = t->f;
+  Node h[2] = { e, HMESH_TRI_TWIN (f, e) };
+  int n = 0;
+  for (int k = 0; k < 2 && h[k].index != HMESH_INDEX_NULL; ++k)
+  {
+    Node next = hmesh_tri_next (h[k]), tn = HMESH_TRI_TWIN (f, next);
+    claim [n++] = h[k];
+    claim [n++] = next;
+    if (tn.index != HMESH_INDEX_NULL)
+      claim [n++] = tn;
+  }
+  return n;
+}
+
+/*
+.. "HmeshTrisPass" : state of a parallel pass over the edges of HmeshTris.
+.. 'marks' : the bit 'c' of the 'marks' of a face is set if the half edge
+.. of the corner 'c' is marked (they read the face and its vertices only),
+.. and an edge is marked if either of its half edges is.
+.. 'claims' : half edges read or written by the operation on the edge of a
+.. half edge (at most HMESH_TRIS_MAX_CLAIMS, with repetitions), or -1 if
+.. the edge cannot be claimed.
+.. Attributes of the faces (temporary) :
+.. 'imark' : the bit 'c' is set if the half edge of the corner 'c' is
+.. marked. The marks of a face are computed again by the kernel which
+.. writes it (hmesh_tris_mark_face ()), so that a pass marks the faces it
+.. changed only, while the threads hold them.
+.. 'iclaim[c]' : for the half edge of the corner 'c' of the face, the
+.. largest key of the edges claiming it in the pass 'epoch'
+.. (hmesh_tris_claim ()). A scalar of 8 bytes per corner, as the vertices
+.. and the twins of the faces, so that any depth of the tree pool serves it.
+.. Edges with a larger key are selected first : the longest (if 'longest')
+.. or the shortest.
+.. 'local' : the edges selected of a block are done one after other (the
+.. kernel checks them again), so that an edge holds the half edges held by
+.. any edge of its block.
+.. 'serial' : a single thread (hmesh_threads_get ()). The passes are then
+.. done serially, as are the passes with fewer than HMESH_TRIS_SERIAL edges
+.. marked, since the claims cost more than they save.
+.. 'edge' : half edges marked of the block 'iblock' from 'start[iblock]',
+.. of which the first 'first[iblock + 1] - first[iblock]' are selected,
+.. and from 'nmarked + start[iblock]', room to sort them.
+.. 'vertex', 'face' : nodes of the edge 'j' selected of the block 'iblock'
+.. are 'vertex[first[iblock] + j]' and the faces (on either side of it)
+.. from 'face[fstart[iblock] + ..]'. 'n', 'nface' : their numbers, for the
+.. 'nblocks' blocks of the faces selected. 'nmarked' : half edges marked.
+*/
+#define HMESH_TRIS_MAX_CLAIMS (4 * HMESH_TRIS_MAX_VALENCE)
+#define HMESH_TRIS_MAX_PASS   32
+#define HMESH_TRIS_SERIAL     HMESH_BLOCK_SIZE
+typedef struct
+{
+  HmeshTris * t;
+  HmeshRemesh * r;
+  int (* marks) (HmeshTris *, Node, HmeshRemesh *);
+  int (* claims) (HmeshTris *, Node, Node *);
+  int longest, local, serial;
+  uint64_t epoch;
+  Index imark, iclaim[3], nblocks;
+  HmeshKey * edge;
+  Node * vertex, * face;
+  size_t * start, * first, * fstart, n, nface, nmarked;
+} HmeshTrisPass;
+
+static inline
+int hmesh_node_less (Node a, Node b)
+{
+  return a.iblock < b.iblock || (a.iblock == b.iblock && a.index < b.index);
+}
+
+static inline
+uint8_t * hmesh_tri_mark (HmeshTrisPass * s, Node face)
+{
+  return (uint8_t *) HMESH_ATTR (s->t->f, s->imark, face.iblock) +
+    face.index;
+}
+
+static inline
+uint64_t * hmesh_tri_claim (HmeshTrisPass * s, Node e)
+{
+  return (uint64_t *) HMESH_ATTR (s->t->f, s->iclaim[e.index % 3],
+    e.iblock) + e.index / 3;
+}
+
+/*
+.. Key of the edge of 'e', from the high bits : the pass (12 bits, so that
+.. the half edges claimed in a pass before are free), the length (as a
+.. float, rounded to 3 bits of mantissa), a hash of the half edge (8 bits)
+.. and the half edge (32 bits). Edges of about the same length come in a
+.. random order, so that the edges selected in a pass are not the
+.. neighbours of each other only. The keys of two edges are never the same
+.. (below 2^32 half edges), and never 0.
+*/
+static inline
+uint64_t hmesh_tris_key (HmeshTrisPass * s, Node e)
+{
+  float l = (float) hmesh_tri_length2 (s->t, e);
+  uint32_t bits, id = (uint32_t) ((size_t) e.iblock * 3 * HMESH_BLOCK_SIZE +
+    e.index + 1), h = id;
+  memcpy (&bits, &l, sizeof (bits));
+  bits = (s->longest ? bits : ~bits) >> 20;
+  /* the finalizer of MurmurHash3 */
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return s->epoch << 52 | (uint64_t) bits << 40 | (uint64_t) (h >> 24) << 32 |
+    id;
+}
+
+/*
+.. Whether the half edge 'e' is held with 'key' : by the edge of 'key', or
+.. if 's->local', by an edge of the same block in the same pass
+*/
+static inline
+int hmesh_tris_held (HmeshTrisPass * s, Node e, uint64_t key)
+{
+  uint64_t held = __atomic_load_n (hmesh_tri_claim (s, e), __ATOMIC_RELAXED);
+  if (!s->local)
+    return held == key;
+  uint32_t size = 3 * HMESH_BLOCK_SIZE;
+  return held >> 52 == key >> 52 &&
+    ((uint32_t) held - 1) / size == ((uint32_t) key - 1) / size;
+}
+
+/*
+.. Marks of 'face' (the face must be held by the thread)
+*/
+static inline
+void hmesh_tris_mark_face (HmeshTrisPass * s, Node face)
+{
+  *hmesh_tri_mark (s, face) = (uint8_t) s->marks (s->t, face, s->r);
+}
+
+/*
+.. The edge of 'e' is not marked anymore. Threads may clear other bits of
+.. the same faces (an atomic and).
+*/
+static inline
+void hmesh_tris_unmark (HmeshTrisPass * s, Node e)
+{
+  Node h[2] = { e, HMESH_TRI_TWIN (s->t->f, e) };
+  for (int k = 0; k < 2 && h[k].index != HMESH_INDEX_NULL; ++k)
+    __atomic_fetch_and (hmesh_tri_mark (s, hmesh_tri_face (h[k])),
+      (uint8_t) ~(1 << h[k].index % 3), __ATOMIC_RELAXED);
+}
+
+/*
+.. Kernel (hmesh_cells_foreach ()) marking the faces of the block
+.. 'iblock', before the first pass
+*/
+static
+void hmesh_tris_mark_kernel (HmeshCells * f, Index iblock, void * data,
+  Real * r)
+{
+  (void) r;
+  HmeshTrisPass * s = (HmeshTrisPass *) data;
+  HMESH_FOREACH_INDEX (f, iblock, i)
+    hmesh_tris_mark_face (s, (Node) {.index = i, .iblock = iblock});
+}
+
+/*
+.. Kernel (hmesh_cells_foreach ()) counting the half edges marked of the
+.. block 'iblock'
+*/
+static
+void hmesh_tris_count_kernel (HmeshCells * f, Index iblock, void * data,
+  Real * r)
+{
+  (void) r;
+  HmeshTrisPass * s = (HmeshTrisPass *) data;
+  uint8_t * mark = (uint8_t *) HMESH_ATTR (f, s->imark, iblock);
+  size_t n = 0;
+  HMESH_FOREACH_INDEX (f, iblock, i)
+    n += __builtin_popcount (mark[i]);
+  s->start [iblock + 1] = n;
+}
+
+/*
+.. Kernel (hmesh_cells_foreach ()) storing the half edges marked of the
+.. block 'iblock'. An edge is taken by one half edge only (the half edge
+.. marked, or the lower of the twins if both are), which claims its half
+.. edges : the largest key is kept (an atomic max). The other half edge is
+.. stored as HMESH_NODE_NULL, and an edge which cannot be claimed with a
+.. key 0.
+*/
+static
+void hmesh_tris_claim_kernel (HmeshCells * f, Index iblock, void * data,
+  Real * r)
+{
+  (void) r;
+  HmeshTrisPass * s = (HmeshTrisPass *) data;
+  uint8_t * mark = (uint8_t *) HMESH_ATTR (f, s->imark, iblock);
+  HmeshKey * edge = s->edge + s->start [iblock];
+  Node claim [HMESH_TRIS_MAX_CLAIMS];
+  HMESH_FOREACH_INDEX (f, iblock, i)
+    for (int c = 0; c < 3; ++c)
+      if (mark[i] & (1 << c))
+      {
+        Node e = hmesh_tri_hedge ((Node) {.index = i, .iblock = iblock}, c),
+          tw = HMESH_TRI_TWIN (f, e);
+        uint64_t key = 0;
+        int nc = 0;
+        if ( tw.index != HMESH_INDEX_NULL && hmesh_node_less (tw, e) &&
+             (*hmesh_tri_mark (s, hmesh_tri_face (tw)) & (1 << tw.index % 3)) )
+          e = HMESH_NODE_NULL;
+        else if ( (nc = s->claims (s->t, e, claim)) >= 0 )
+          key = hmesh_tris_key (s, e);
+        for (int k = 0; k < nc; ++k)
+        {
+          uint64_t * slot = hmesh_tri_claim (s, claim[k]),
+            old = __atomic_load_n (slot, __ATOMIC_RELAXED);
+          while ( old < key &&
+                  !__atomic_compare_exchange_n (slot, &old, key, 1,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED) );
+        }
+        *edge++ = (HmeshKey) { .key = key, .node = e };
+      }
+}
+
+/*
+.. Kernel (hmesh_cells_foreach ()) selecting the edges of the block
+.. 'iblock' which hold all the half edges they claim (hmesh_tris_held ()).
+.. An edge which cannot be claimed is not marked anymore.
+*/
+static
+void hmesh_tris_check_kernel (HmeshCells * f, Index iblock, void * data,
+  Real * r)
+{
+  (void) r;
+  HmeshTrisPass * s = (HmeshTrisPass *) data;
+  HmeshKey * edge = s->edge + s->start [iblock];
+  Node claim [HMESH_TRIS_MAX_CLAIMS];
+  size_t n = s->start [iblock + 1] - s->start [iblock], nsel = 0, nface = 0;
+  for (size_t j = 0; j < n; ++j)
+  {
+    Node e = edge[j].node;
+    uint64_t key = edge[j].key;
+    if (e.index == HMESH_INDEX_NULL)
+      continue;
+    if (!key)
+    {
+      hmesh_tris_unmark (s, e);
+      continue;
+    }
+    int nc = s->claims (s->t, e, claim), held = 1;
+    for (int k = 0; k < nc && held; ++k)
+      held = hmesh_tris_held (s, claim[k], key);
+    if (!held)
+      continue;
+    edge [nsel++] = edge[j];
+    nface += (HMESH_TRI_TWIN (f, e).index == HMESH_INDEX_NULL) ? 1 : 2;
+  }
+  s->first [iblock + 1] = nsel;
+  s->fstart [iblock + 1] = nface;
+}
+
+static
+size_t hmesh_offsets (size_t * start, size_t n)
+{
+  start[0] = 0;
+  for (size_t b = 0; b < n; ++b)
+    start [b + 1] += start [b];
+  return start [n];
+}
+
+/*
+.. Count the half edges marked, in parallel by the blocks of the faces, and
+.. make room for them in 'edge' (from 'start[iblock]'). Sets 'nmarked'.
+*/
+static
+int hmesh_tris_count (HmeshTrisPass * s)
+{
+  HmeshCells * f = s->t->f;
+  size_t nblocks = f->blocks->max,
+    * start = realloc (s->start, 3 * (nblocks + 1) * sizeof (size_t));
+  if (!start)
+  {
+    hmesh_error ("hmesh_tris_count () : malloc failed");
+    return HMESH_ERROR;
+  }
+  memset (start, 0, 3 * (nblocks + 1) * sizeof (size_t));
+  s->start = start;
+  s->first = start + nblocks + 1;
+  s->fstart = start + 2 * (nblocks + 1);
+  s->nblocks = nblocks;
+  s->n = s->nface = 0;
+
+  if (hmesh_cells_foreach (f, hmesh_tris_count_kernel, s,
+        HMESH_REDUCE_NONE, NULL))
+    return HMESH_ERROR;
+  if ( !(s->nmarked = hmesh_offsets (start, nblocks)) )
+    return HMESH_NO_ERROR;
+  HmeshKey * edge = realloc (s->edge, 2 * s->nmarked * sizeof (HmeshKey));
+  if (!edge)
+  {
+    hmesh_error ("hmesh_tris_count () : malloc failed");
+    return HMESH_ERROR;
+  }
+  s->edge = edge;
+  return HMESH_NO_ERROR;
+}
+
+/*
+.. Select the edges counted (hmesh_tris_count ()), so that no two of them
+.. claim the same half edge, in parallel by the blocks of the faces : (a)
+.. each edge marked claims its half edges with its key, and (b) an edge is
+.. selected if it holds all of them. The edge with the largest key of a
+.. pass is always selected, and edges not selected wait for the next pass
+.. (with their marks). So, a face with more edges to split has them split
+.. in the order of their key. The half edges are claimed again in each pass
+.. (a new 'epoch'). Sets 'n'.
+*/
+static
+int hmesh_tris_claim (HmeshTrisPass * s)
+{
+  HmeshCells * f = s->t->f;
+  if (++s->epoch == 1 << 12)
+  {
+    HMESH_FOREACH_BLOCK (f, iblk)
+      for (int c = 0; c < 3; ++c)
+        memset (HMESH_ATTR (f, s->iclaim[c], iblk), 0,
+          HMESH_BLOCK_SIZE * sizeof (uint64_t));
+    s->epoch = 1;
+  }
+  if ( hmesh_cells_foreach (f, hmesh_tris_claim_kernel, s,
+         HMESH_REDUCE_NONE, NULL) ||
+       hmesh_cells_foreach (f, hmesh_tris_check_kernel, s,
+         HMESH_REDUCE_NONE, NULL) )
+    return HMESH_ERROR;
+  s->n = hmesh_offsets (s->first, s->nblocks);
+  s->nface = hmesh_offsets (s->fstart, s->nblocks);
+  return HMESH_NO_ERROR;
+}
+
+/*
+.. Count the half edges marked (hmesh_tris_count ()) and select the edges
+.. among them (hmesh_tris_claim ()). Sets 'n' and 'nmarked'.
+*/
+static
+int hmesh_tris_select (HmeshTrisPass * s)
+{
+  if (hmesh_tris_count (s))
+    return HMESH_ERROR;
+  return s->nmarked ? hmesh_tris_claim (s) : HMESH_NO_ERROR;
+}
+
+/*
+.. Sort the 'n' keys from 'start' in 'edge' (Ex: 'start[iblock]' for the
+.. block 'iblock') by the lengths of their edges (hmesh_tris_key ()), the
+.. largest key first, i.e. the shortest (or the longest if 'longest') (a
+.. counting sort). Returns the keys sorted.
+*/
+static
+HmeshKey * hmesh_tris_keys_sort (HmeshTrisPass * s, size_t start, size_t n)
+{
+  HmeshKey * edge = s->edge + start, * sorted = s->edge + s->nmarked + start;
+  uint32_t count [1 << 12] = {0}, sum = 0;
+  for (size_t j = 0; j < n; ++j)
+    ++count [(edge[j].key >> 40) & 0xfff];
+  for (int d = (1 << 12) - 1; d >= 0; --d)
+  {
+    uint32_t c = count[d];
+    count[d] = sum;
+    sum += c;
+  }
+  for (size_t j = 0; j < n; ++j)
+    sorted [count [(edge[j].key >> 40) & 0xfff]++] = edge[j];
+  return sorted;
+}
+
+/*
+.. Serial pass : the edges marked are stored in 'edge' by their key (one
+.. half edge for each, as hmesh_tris_claim_kernel ()), and sorted, the
+.. largest key first (hmesh_tris_keys_sort ()). Returns their number.
+*/
+static
+size_t hmesh_tris_marked (HmeshTrisPass * s, HmeshKey ** sorted)
+{
+  HmeshCells * f = s->t->f;
+  size_t n = 0;
+  HMESH_FOREACH_BLOCK (f, iblock)
+  {
+    uint8_t * mark = (uint8_t *) HMESH_ATTR (f, s->imark, iblock);
+    HMESH_FOREACH_INDEX (f, iblock, i)
+      for (int c = 0; c < 3; ++c)
+        if (mark[i] & (1 << c))
+        {
+          Node e = hmesh_tri_hedge ((Node) {.index = i, .iblock = iblock}, c),
+            tw = HMESH_TRI_TWIN (f, e);
+          if ( tw.index == HMESH_INDEX_NULL || !hmesh_node_less (tw, e) ||
+               !(*hmesh_tri_mark (s, hmesh_tri_face (tw)) &
+                 (1 << tw.index % 3)) )
+            s->edge [n++] = (HmeshKey) { .key = hmesh_tris_key (s, e),
+              .node = e };
+        }
+  }
+  *sorted = hmesh_tris_keys_sort (s, 0, n);
+  return n;
+}
+
+/*
+.. Split of the edge 'e' at the new vertex 'm', with the new faces 'g' (1
+.. or 2, as the half edges of the edge). The half edges of the new faces
+.. are free, and the faces written are marked again. Returns the number of
+.. new faces.
+*/
+static
+int hmesh_tris_split_edge (HmeshTrisPass * s, Node e, Node m, Node * g)
+{
+  Node h[2] = { e, HMESH_TRI_TWIN (s->t->f, e) };
+  int nh = (h[1].index == HMESH_INDEX_NULL) ? 1 : 2;
+  hmesh_tri_split_at (s->t, e, m, g);
+  for (int k = 0; k < nh; ++k)
+  {
+    for (int c = 0; c < 3; ++c)
+      *hmesh_tri_claim (s, hmesh_tri_hedge (g[k], c)) = 0;
+    hmesh_tris_mark_face (s, hmesh_tri_face (h[k]));
+    hmesh_tris_mark_face (s, g[k]);
+  }
+  return nh;
+}
+
+/*
+.. Kernel (hmesh_cells_foreach ()) splitting the edges selected of the
+.. faces of the block 'iblock', and marking the faces they write. The new
+.. nodes are allocated before the pass (the threads don't allocate nodes).
+*/
+static
+void hmesh_tris_split_kernel (HmeshCells * f, Index iblock, void * data,
+  Real * r)
+{
+  (void) r;
+  (void) f;
+  HmeshTrisPass * s = (HmeshTrisPass *) data;
+  if (iblock >= s->nblocks)
+    return;
+  HmeshKey * edge = s->edge + s->start [iblock];
+  Node * vertex = s->vertex + s->first [iblock],
+    * g = s->face + s->fstart [iblock];
+  size_t n = s->first [iblock + 1] - s->first [iblock];
+  for (size_t j = 0; j < n; ++j)
+    g += hmesh_tris_split_edge (s, edge[j].node, vertex[j], g);
+}
+
+/*
+.. Serial pass of hmesh_tris_refine () (a single thread, or few edges
+.. marked) : the edges marked are split one after other, the longest first
+.. (as hmesh_split ()), with no claims. An edge is split if it's still
+.. marked, as a split before may have changed the faces of its half edge.
+.. Returns the number of edges split, or -1.
+*/
+static
+long hmesh_tris_split_serial (HmeshTrisPass * s)
+{
+  HmeshTris * t = s->t;
+  HmeshKey * edge;
+  size_t n = hmesh_tris_marked (s, &edge);
+  long nsplit = 0;
+  for (size_t j = 0; j < n; ++j)
+  {
+    Node e = edge[j].node, tw = HMESH_TRI_TWIN (t->f, e), m, g[2];
+    size_t nh = (tw.index == HMESH_INDEX_NULL) ? 1 : 2;
+    if ( !(*hmesh_tri_mark (s, hmesh_tri_face (e)) & (1 << e.index % 3)) &&
+         ( nh == 1 ||
+           !(*hmesh_tri_mark (s, hmesh_tri_face (tw)) & (1 << tw.index % 3)) ) )
+      continue;
+    if ( (m = hmesh_node_new (t->p)).index == HMESH_INDEX_NULL ||
+         hmesh_nodes_new (t->f, nh, g) != nh )
+      return -1;
+    hmesh_tris_split_edge (s, e, m, g);
+    ++nsplit;
+  }
+  return nsplit;
+}
+
+/*
+.. Parallel pass of hmesh_tris_refine () over the edges counted : the
+.. edges are selected (hmesh_tris_claim ()), their new nodes allocated, and
+.. they are split (hmesh_tris_split_kernel ()). Returns the number of
+.. edges split, or -1.
+*/
+static
+long hmesh_tris_split_pass (HmeshTrisPass * s)
+{
+  if (hmesh_tris_claim (s))
+    return -1;
+  size_t n = s->n, nface = s->nface;
+  Node * vertex = realloc (s->vertex, (n ? n : 1) * sizeof (Node));
+  if (vertex)
+    s->vertex = vertex;
+  Node * face = vertex ? realloc (s->face, (nface ? nface : 1) *
+    sizeof (Node)) : NULL;
+  if (face)
+    s->face = face;
+  if ( !face || hmesh_nodes_new (s->t->p, n, s->vertex) != n ||
+       hmesh_nodes_new (s->t->f, nface, s->face) != nface ||
+       hmesh_cells_foreach (s->t->f, hmesh_tris_split_kernel, s,
+         HMESH_REDUCE_NONE, NULL) )
+    return -1;
+  return (long) n;
+}
+
+/*
+.. Temporary attributes 'name' (the marks) and '_claim0' .. '_claim2' of
+.. the faces, with all the faces marked and all the half edges free
+*/
+static
+int hmesh_tris_pass_new (HmeshTrisPass * s, char * name)
+{
+  HmeshCells * f = s->t->f;
+  char * cname[3] = { "_claim0", "_claim1", "_claim2" };
+  s->imark = hmesh_attr_add (f, name, sizeof (uint8_t));
+  for (int c = 0; c < 3; ++c)
+    s->iclaim[c] = s->imark == HMESH_INDEX_NULL ? HMESH_INDEX_NULL :
+      hmesh_attr_add (f, cname[c], sizeof (uint64_t));
+  if ( s->iclaim[0] == HMESH_INDEX_NULL || s->iclaim[1] == HMESH_INDEX_NULL ||
+       s->iclaim[2] == HMESH_INDEX_NULL )
+  {
+    hmesh_error ("hmesh_tris_pass_new () : cannot add '%s'", name);
+    return HMESH_ERROR;
+  }
+  HMESH_FOREACH_BLOCK (f, iblk)
+    for (int c = 0; c < 3; ++c)
+      memset (HMESH_ATTR (f, s->iclaim[c], iblk), 0,
+        HMESH_BLOCK_SIZE * sizeof (uint64_t));
+  return hmesh_cells_foreach (f, hmesh_tris_mark_kernel, s,
+    HMESH_REDUCE_NONE, NULL);
+}
+
+/*
+.. The blocks shared with a snapshot are copied at once, before a parallel
+.. pass (hmesh_cells_write () is not thread safe)
+*/
+static
+void hmesh_cells_unshare_all (HmeshCells * cells)
+{
+  if (cells->shared)
+    HMESH_FOREACH_BLOCK (cells, iblk)
+      hmesh_cells_unshare (cells, iblk);
+}
+
+static
+void hmesh_tris_pass_free (HmeshTrisPass * s)
+{
+  Index iattr[4] = { s->imark, s->iclaim[0], s->iclaim[1], s->iclaim[2] };
+  for (int k = 0; k < 4; ++k)
+    if (iattr[k] != HMESH_INDEX_NULL)
+      hmesh_attr_destroy (s->t->f, iattr[k]);
+  free (s->edge);
+  free (s->vertex);
+  free (s->face);
+  free (s->start);
+}
+
+/*
+.. "hmesh_tris_refine ()" : Split the edges of 't' to be split (HmeshRemesh
+.. 'r', as hedge_split_criteria ()) in passes, until there are none, as
+.. hmesh_split () of src/backup/hmesh-remesh.h. In each pass,
+.. (a) the edges marked are selected in parallel (hmesh_tris_select (),
+.. longest first), so that no two of them write the same half edge
+.. (hmesh_tri_split_claims ()),
+.. (b) the new vertices and faces are allocated at once, and each edge
+.. takes its own, so that the threads never allocate,
+.. (c) the edges are split in parallel, by the blocks of their faces, and
+.. the faces written are marked again (all the faces are marked before
+.. the first pass).
+.. With a single thread (hmesh_threads_get ()), or fewer than
+.. HMESH_TRIS_SERIAL edges marked, a pass splits the edges marked serially
+.. instead, as hmesh_split () (hmesh_tris_split_serial ()).
+.. The passes go on till no edge is marked, however many levels of
+.. refinement it takes : 'r->amax' must be positive, and so must be
+.. 'r->amin' with a 'r->quality' (the splits of a triangle of a poor
+.. quality end with its edges shorter than amin/2).
+.. The number of edges split is stored in 'nsplit', if not NULL.
+*/
+int hmesh_tris_refine (HmeshTris * t, HmeshRemesh * r, size_t * nsplit)
+{
+  if (nsplit)
+    *nsplit = 0;
+  if ( !t || !r || !(r->amax > 0.) ||
+       (r->quality > 0. && !(r->amin > 0.)) )
+  {
+    hmesh_error ("hmesh_tris_refine () : aborted");
+    return HMESH_ERROR;
+  }
+  HmeshCells * p = t->p, * f = t->f;
+  hmesh_cells_unshare_all (p);
+  hmesh_cells_unshare_all (f);
+
+  HmeshTrisPass s = { .t = t, .r = r,
+    .marks = hmesh_tri_split_marks, .claims = hmesh_tri_split_claims,
+    .longest = 1, .serial = hmesh_threads_get () < 2 };
+  int status = hmesh_tris_pass_new (&s, "_split");
+  for (int pass = 0; !status; ++pass)
+  {
+    if (hmesh_tris_count (&s))
+    {
+      status = HMESH_ERROR;
+      break;
+    }
+    if (!s.nmarked)
+      break;
+    long n = (s.serial || s.nmarked < HMESH_TRIS_SERIAL) ?
+      hmesh_tris_split_serial (&s) : hmesh_tris_split_pass (&s);
+    if (n < 0)
+    {
+      hmesh_error ("hmesh_tris_refine () : pass %d failed", pass);
+      status = HMESH_ERROR;
+      break;
+    }
+    if (nsplit)
+      *nsplit += n;
+  }
+
+  hmesh_tris_pass_free (&s);
+  return status;
+}
+
+/*
+.. hedge_collapse () criteria of src/backup/hmesh-remesh.h : collapse the
+.. edges of 'face' shorter than 'amin' (the bit 'c' for the corner 'c').
+.. Whether the surface stays a manifold (hmesh_tri_collapse_check ()) is
+.. left to the collapse, as it reads the faces around the edge.
+*/
+static
+int hmesh_tri_collapse_marks (HmeshTris * t, Node face, HmeshRemesh * r)
+{
+  double x[3][3], l[3];
+  hmesh_tri_lengths2 (t, face, x, l);
+  int m = 0;
+  for (int c = 0; c < 3; ++c)
+    if (l[c] < r->amin * r->amin)
+      m |= 1 << c;
+  return m;
+}
+
+/*
+.. Faces of the star of the pivot of 'e' (open or closed), appended to
+.. 'face' from 'n'. Returns the new number of faces, or -1 if the star has
+.. more than HMESH_TRIS_MAX_VALENCE faces.
+*/
+static
+int hmesh_tri_star_faces (HmeshCells * f, Node e, Node * face, int n)
+{
+  int max = n + HMESH_TRIS_MAX_VALENCE;
+  Node s = e;
+  do
+  {
+    if (n == max)
+      return -1;
+    face [n++] = hmesh_tri_face (s);
+    Node t = HMESH_TRI_TWIN (f, s);
+    if (t.index == HMESH_INDEX_NULL)
+      break;
+    s = hmesh_tri_next (t);
+  } while (!hmesh_node_same (s, e));
+  if (!hmesh_node_same (s, e))
+    for (s = HMESH_TRI_TWIN (f, hmesh_tri_prev (e));
+         s.index != HMESH_INDEX_NULL;
+         s = HMESH_TRI_TWIN (f, hmesh_tri_prev (s)))
+    {
+      if (n == max)
+        return -1;
+      face [n++] = hmesh_tri_face (s);
+    }
+  return n;
+}
+
+/*
+.. Face after the star of the pivot of 'e' around the pivot of the
+.. previous half edge ('x' for the edge (a, b)), read for its valence by
+.. hmesh_tri_collapse_check (), as its first half edge (or HMESH_NODE_NULL)
+*/
+static
+Node hmesh_tri_collapse_ring (HmeshCells * f, Node e)
+{
+  Node s = HMESH_TRI_TWIN (f, hmesh_tri_prev (e));
+  if (s.index != HMESH_INDEX_NULL)
+    s = HMESH_TRI_TWIN (f, hmesh_tri_next (s));
+  return s.index == HMESH_INDEX_NULL ? s :
+    hmesh_tri_hedge (hmesh_tri_face (s), 0);
+}
+
+/*
+.. Faces read or written by the collapse of 'e', each claimed by its first
+.. half edge : the stars of 'a' and 'b' (written), and the face after them
+.. around 'x' and around 'y' (hmesh_tri_collapse_ring ()). A boundary edge
+.. is not collapsed (-1).
+*/
+static
+int hmesh_tri_collapse_claims (HmeshTris * t, Node e, Node * claim)
+{
+  HmeshCells * f = t->f;
+  Node h[2] = { e, HMESH_TRI_TWIN (f, e) };
+  if (h[1].index == HMESH_INDEX_NULL)
+    return -1;
+  int n = 0;
+  for (int k = 0; k < 2; ++k)
+  {
+    Node * star = claim + n;
+    int ns = hmesh_tri_star (f, h[k], star, HMESH_TRIS_MAX_VALENCE);
+    if (ns < 0)
+      return -1;
+    for (int j = 0; j < ns; ++j)
+      star[j] = hmesh_tri_hedge (hmesh_tri_face (star[j]), 0);
+    n += ns;
+    Node w = hmesh_tri_collapse_ring (f, h[k]);
+    if (w.index != HMESH_INDEX_NULL)
+      claim[n++] = w;
+  }
+  return n;
+}
+
+/*
+.. Whether the faces read or written by the collapse of 'e' (as
+.. hmesh_tri_collapse_claims ()) are all of the block of 'e'. The faces of
+.. the other blocks are not read (their threads may write them).
+*/
+static
+int hmesh_tri_collapse_inside (HmeshCells * f, Node e)
+{
+  Node h[2] = { e, HMESH_TRI_TWIN (f, e) };
+  if (h[1].index == HMESH_INDEX_NULL || h[1].iblock != e.iblock)
+    return 0;
+  for (int k = 0; k < 2; ++k)
+  {
+    Node s = h[k];
+    int n = 0;
+    do
+    {
+      Node t = HMESH_TRI_TWIN (f, s);
+      if ( ++n > HMESH_TRIS_MAX_VALENCE || t.index == HMESH_INDEX_NULL ||
+           t.iblock != e.iblock )
+        return 0;
+      s = hmesh_tri_next (t);
+    } while (!hmesh_node_same (s, h[k]));
+    Node w = hmesh_tri_collapse_ring (f, h[k]);
+    if (w.index != HMESH_INDEX_NULL && w.iblock != e.iblock)
+      return 0;
+  }
+  return 1;
+}
+
+/*
+.. The faces of the star of the pivot of 'e' are marked again
+*/
+static
+void hmesh_tris_mark_star (HmeshTrisPass * s, Node e)
+{
+  Node star [HMESH_TRIS_MAX_VALENCE];
+  int n = hmesh_tri_star_faces (s->t->f, e, star, 0);
+  for (int k = 0; k < n; ++k)
+    hmesh_tris_mark_face (s, star[k]);
+}
+
+/*
+.. Collapse of the edge 'e' held by the thread, if the surface stays a
+.. manifold (else the edge is not marked anymore). The vertex 'b' and the
+.. faces of 'e' and of its twin (not marked anymore) are stored in
+.. 'vertex' and 'face', to be removed after the pass (hmesh_node_remove ()
+.. is not thread safe), or 'vertex' is HMESH_NODE_NULL. The star of 'a' is
+.. marked again : its edges changed of length, valence or common
+.. neighbours. Elsewhere, the common neighbours of an edge are not fewer
+.. (but for an edge (x, y)), and the valences not larger, so that an edge
+.. abandoned stays so.
+*/
+static
+void hmesh_tris_collapse_edge (HmeshTrisPass * s, Node e, Node * vertex,
+  Node * face)
+{
+  HmeshCells * f = s->t->f;
+  Node sb [HMESH_TRIS_MAX_VALENCE];
+  int nb = hmesh_tri_collapse_check (f, e, sb);
+  *vertex = HMESH_NODE_NULL;
+  if (nb < 0)
+  {
+    hmesh_tris_unmark (s, e);
+    return;
+  }
+  Node te = HMESH_TRI_TWIN (f, e),
+    sa = HMESH_TRI_TWIN (f, hmesh_tri_prev (e));
+  *vertex = HMESH_TRI_PIVOT (f, te);
+  face[0] = hmesh_tri_face (e);
+  face[1] = hmesh_tri_face (te);
+  hmesh_tri_collapse_at (s->t, e, sb, nb);
+  *hmesh_tri_mark (s, face[0]) = *hmesh_tri_mark (s, face[1]) = 0;
+  hmesh_tris_mark_star (s, sa);
+}
+
+/*
+.. Kernel (hmesh_cells_foreach ()) collapsing the edges marked of the
+.. faces of the block 'iblock' which read or write faces of the block only
+.. (hmesh_tri_collapse_inside ()), one after other (the shortest first),
+.. as hmesh_collapse (). The half edges marked (counted by
+.. hmesh_tris_count ()) are stored in 'edge', and the nodes to remove in
+.. 'vertex' and 'face' (2 for each) from 'start[iblock]'. An edge is
+.. skipped if it is not marked anymore (a collapse before removed its face
+.. or changed its length).
+*/
+static
+void hmesh_tris_inside_kernel (HmeshCells * f, Index iblock, void * data,
+  Real * r)
+{
+  (void) r;
+  HmeshTrisPass * s = (HmeshTrisPass *) data;
+  uint8_t * mark = (uint8_t *) HMESH_ATTR (f, s->imark, iblock);
+  HmeshKey * edge = s->edge + s->start [iblock];
+  Node * vertex = s->vertex + s->start [iblock],
+    * g = s->face + 2 * s->start [iblock];
+  size_t n = 0;
+  HMESH_FOREACH_INDEX (f, iblock, i)
+    for (int c = 0; c < 3; ++c)
+      if (mark[i] & (1 << c))
+      {
+        Node e = hmesh_tri_hedge ((Node) {.index = i, .iblock = iblock}, c);
+        edge [n++] = (HmeshKey) { .key = hmesh_tris_key (s, e), .node = e };
+      }
+  edge = hmesh_tris_keys_sort (s, s->start [iblock], n);
+  for (size_t j = 0; j < n; ++j)
+  {
+    Node e = edge[j].node;
+    vertex[j] = HMESH_NODE_NULL;
+    if ( (mark [e.index / 3] & (1 << e.index % 3)) &&
+         hmesh_tri_collapse_inside (f, e) )
+      hmesh_tris_collapse_edge (s, e, vertex + j, g + 2 * j);
+  }
+}
+
+/*
+.. Kernel (hmesh_cells_foreach ()) collapsing the edges selected of the
+.. faces of the block 'iblock' (hmesh_tris_select ()), one after other (the
+.. shortest first), as the faces around them may be held by other edges of
+.. the block ('local'). An edge is collapsed if it is still marked, and if
+.. it holds the faces it reads now : the stars of its vertices are held (a
+.. collapse before merged stars held by the block), but the faces around
+.. 'x' and 'y' may not be. The nodes to remove are stored from
+.. 'first[iblock]' in 'vertex' and from 'fstart[iblock]' in 'face'.
+*/
+static
+void hmesh_tris_collapse_kernel (HmeshCells * f, Index iblock, void * data,
+  Real * r)
+{
+  (void) r;
+  HmeshTrisPass * s = (HmeshTrisPass *) data;
+  HmeshKey * edge = s->edge + s->start [iblock];
+  Node * vertex = s->vertex + s->first [iblock],
+    * g = s->face + s->fstart [iblock];
+  size_t n = s->first [iblock + 1] - s->first [iblock];
+  edge = hmesh_tris_keys_sort (s, s->start [iblock], n);
+  for (size_t j = 0; j < n; ++j)
+  {
+    Node e = edge[j].node, h[2] = { e, HMESH_TRI_TWIN (f, e) };
+    int held = h[1].index != HMESH_INDEX_NULL &&
+      (*hmesh_tri_mark (s, hmesh_tri_face (e)) & (1 << e.index % 3));
+    for (int k = 0; k < 2 && held; ++k)
+    {
+      Node w = hmesh_tri_collapse_ring (f, h[k]);
+      held = w.index == HMESH_INDEX_NULL ||
+        hmesh_tris_held (s, w, edge[j].key);
+    }
+    vertex[j] = HMESH_NODE_NULL;
+    if (held)
+      hmesh_tris_collapse_edge (s, e, vertex + j, g + 2 * j);
+  }
+}
+
+/*
+.. Pass of 'kernel' over the faces of 't', collapsing 'n' edges at most
+.. (their nodes stored in 's->vertex', 's->face'), then removing the nodes
+.. of the edges collapsed serially. Returns their number, or -1.
+*/
+static
+long hmesh_tris_collapse_pass (HmeshTrisPass * s, HmeshKernel kernel,
+  size_t n)
+{
+  HmeshTris * t = s->t;
+  Node * vertex = realloc (s->vertex, (n ? n : 1) * sizeof (Node));
+  if (vertex)
+    s->vertex = vertex;
+  Node * face = vertex ? realloc (s->face, (n ? 2 * n : 1) * sizeof (Node)) :
+    NULL;
+  if (face)
+    s->face = face;
+  if ( !face || hmesh_cells_foreach (t->f, kernel, s, HMESH_REDUCE_NONE,
+                  NULL) )
+    return -1;
+  long ndone = 0;
+  for (size_t k = 0; k < n; ++k)
+  {
+    if (s->vertex[k].index == HMESH_INDEX_NULL)
+      continue;
+    if ( hmesh_node_remove (t->f, s->face[2*k]) ||
+         hmesh_node_remove (t->f, s->face[2*k + 1]) ||
+         hmesh_node_remove (t->p, s->vertex[k]) )
+      return -1;
+    ++ndone;
+  }
+  return ndone;
+}
+
+/*
+.. Serial pass of hmesh_tris_coarsen () (a single thread, or few edges
+.. marked) : the edges marked are collapsed one after other, the shortest
+.. first, as hmesh_collapse (), and their nodes are removed at once. An
+.. edge is collapsed if its face is still in use and marked. Returns the
+.. number of edges collapsed, or -1.
+*/
+static
+long hmesh_tris_collapse_serial (HmeshTrisPass * s)
+{
+  HmeshTris * t = s->t;
+  HmeshKey * edge;
+  size_t n = hmesh_tris_marked (s, &edge);
+  long ndone = 0;
+  for (size_t j = 0; j < n; ++j)
+  {
+    Node e = edge[j].node, vertex, face[2];
+    if ( !hmesh_tri_in_use (t->f, e) ||
+         !(*hmesh_tri_mark (s, hmesh_tri_face (e)) & (1 << e.index % 3)) )
+      continue;
+    hmesh_tris_collapse_edge (s, e, &vertex, face);
+    if (vertex.index == HMESH_INDEX_NULL)
+      continue;
+    if ( hmesh_node_remove (t->f, face[0]) ||
+         hmesh_node_remove (t->f, face[1]) || hmesh_node_remove (t->p, vertex) )
+      return -1;
+    ++ndone;
+  }
+  return ndone;
+}
+
+/*
+.. Parallel pass of hmesh_tris_coarsen () over the edges counted : the
+.. edges inside the blocks (hmesh_tris_inside_kernel ()), then the edges
+.. selected among the others (hmesh_tris_collapse_kernel ()). Returns the
+.. number of edges collapsed, or -1.
+*/
+static
+long hmesh_tris_coarsen_pass (HmeshTrisPass * s)
+{
+  long ninside = hmesh_tris_collapse_pass (s, hmesh_tris_inside_kernel,
+    s->nmarked), nselect = 0;
+  if ( ninside < 0 || hmesh_tris_select (s) ||
+       (s->nmarked && (nselect = hmesh_tris_collapse_pass (s,
+          hmesh_tris_collapse_kernel, s->n)) < 0) )
+    return -1;
+  return ninside + nselect;
+}
+
+/*
+.. "hmesh_tris_coarsen ()" : Collapse the edges of 't' shorter than
+.. 'r->amin' in passes, until there are none which can be collapsed, as
+.. hmesh_collapse () of src/backup/hmesh-remesh.h. In each pass, (a) the
+.. edges marked (shorter than 'r->amin') whose collapse reads and writes
+.. the faces of a block only are collapsed in parallel by the blocks, one
+.. after other (hmesh_tris_inside_kernel ()), and (b) the others are
+.. selected in parallel (shortest first), so that the faces they read or
+.. write are held by their block (hmesh_tris_select (),
+.. hmesh_tri_collapse_claims ()), and collapsed in parallel by the blocks
+.. (hmesh_tris_collapse_kernel ()). An edge is
+.. collapsed if the surface stays a manifold (hmesh_tri_collapse_at ()),
+.. and the faces changed are marked again. The faces and vertices removed
+.. are freed serially after each kernel. An edge not selected waits for the
+.. next pass, and an edge whose collapse is abandoned waits for a collapse
+.. around it. When no edge is marked, the faces are all marked again (a
+.. sweep of hmesh_collapse ()), till a sweep collapses no edge.
+.. With a single thread (hmesh_threads_get ()), or fewer than
+.. HMESH_TRIS_SERIAL edges marked, a pass collapses the edges marked
+.. serially instead, as hmesh_collapse () (hmesh_tris_collapse_serial ()).
+.. The number of edges collapsed is stored in 'ncollapse', if not NULL.
+*/
+int hmesh_tris_coarsen (HmeshTris * t, HmeshRemesh * r, size_t * ncollapse)
+{
+  if (ncollapse)
+    *ncollapse = 0;
+  if (!t || !r)
+  {
+    hmesh_error ("hmesh_tris_coarsen () : aborted");
+    return HMESH_ERROR;
+  }
+  HmeshCells * p = t->p, * f = t->f;
+  hmesh_cells_unshare_all (p);
+  hmesh_cells_unshare_all (f);
+
+  HmeshTrisPass s = { .t = t, .r = r,
+    .marks = hmesh_tri_collapse_marks,
+    .claims = hmesh_tri_collapse_claims, .longest = 0, .local = 1,
+    .serial = hmesh_threads_get () < 2 };
+  int status = hmesh_tris_pass_new (&s, "_collapse");
+  size_t nsweep = 0;
+  for (int pass = 0; !status; ++pass)
+  {
+    long n = hmesh_tris_count (&s) ? -1 : !s.nmarked ? 0 :
+      (s.serial || s.nmarked < HMESH_TRIS_SERIAL) ?
+      hmesh_tris_collapse_serial (&s) : hmesh_tris_coarsen_pass (&s);
+    if (n < 0)
+    {
+      hmesh_error ("hmesh_tris_coarsen () : pass %d failed", pass);
+      status = HMESH_ERROR;
+      break;
+    }
+    if (ncollapse)
+      *ncollapse += n;
+    nsweep += n;
+    if (!s.nmarked)
+    {
+      if (!nsweep)
+        break;
+      nsweep = 0;
+      status = hmesh_cells_foreach (f, hmesh_tris_mark_kernel, &s,
+        HMESH_REDUCE_NONE, NULL);
+    }
+  }
+
+  hmesh_tris_pass_free (&s);
+  return status;
+}
+
+/*
+.. Binary heap (max on 'key') of the half edges to remesh, with lazy
+.. updates : an edge may be pushed again, and its key is verified once
+.. popped (hmesh_tris_remesh ())
+*/
+typedef struct
+{
+  double key;
+  Node e;
+} HmeshTrisItem;
+
+typedef struct
+{
+  HmeshTrisItem * item;
+  size_t n, max;
+} HmeshTrisHeap;
+
+static
+int hmesh_tris_heap_push (HmeshTrisHeap * h, double key, Node e)
+{
+  if (h->n == h->max)
+  {
+    size_t max = h->max ? 2 * h->max : 1024;
+    HmeshTrisItem * item = realloc (h->item, max * sizeof (HmeshTrisItem));
+    if (!item)
+    {
+      hmesh_error ("hmesh_tris_heap_push () : realloc failed");
+      return HMESH_ERROR;
+    }
+    h->item = item;
+    h->max = max;
+  }
+  size_t i = h->n++;
+  for (; i > 0 && h->item[(i - 1)/2].key < key; i = (i - 1)/2)
+    h->item[i] = h->item[(i - 1)/2];
+  h->item[i] = (HmeshTrisItem) { .key = key, .e = e };
+  return HMESH_NO_ERROR;
+}
+
+static
+HmeshTrisItem hmesh_tris_heap_pop (HmeshTrisHeap * h)
+{
+  HmeshTrisItem top = h->item[0], last = h->item[--h->n];
+  size_t i = 0, c;
+  while ( (c = 2 * i + 1) < h->n )
+  {
+    if (c + 1 < h->n && h->item[c + 1].key > h->item[c].key)
+      ++c;
+    if (h->item[c].key <= last.key)
+      break;
+    h->item[i] = h->item[c];
+    i = c;
+  }
+  if (h->n)
+    h->item[i] = last;
+  return top;
+}
+
+/*
+.. Priority of the edge of 'e' (0 if it's in [amin, amax] and of a good
+.. quality) : l^2/amax^2 (> 1) if it's to be split for its length,
+.. amin^2/l^2 (> 1) if it's to be collapsed, and in (1, 2] if it's the
+.. longest edge of a triangle of a poor quality. 'collapse' is set for a
+.. collapse.
+*/
+static
+double hmesh_tri_priority (HmeshTris * t, Node e, HmeshRemesh * r,
+  int * collapse)
+{
+  double l = hmesh_tri_length2 (t, e), amax = r->amax * r->amax,
+    amin = r->amin * r->amin;
+  *collapse = 0;
+  if (l > amax)
+    return l / amax;
+  if (l < amin)
+  {
+    *collapse = 1;
+    return l > 0. ? amin / l : HUGE_VAL;
+  }
+  if ( r->quality <= 0. || !hmesh_tri_split_criteria (t, e, r) )
+    return 0.;
+  double x[3][3], q = r->quality * r->quality;
+  Node y = e;
+  for (int c = 0; c < 3; ++c, y = hmesh_tri_next (y))
+    hmesh_tri_position (t, HMESH_TRI_PIVOT (t->f, y), x[c]);
+  return 1. + (q - hmesh_tri_quality2 (x)) / q;
+}
+
+/*
+.. 1 if the collapse of the edge of 'e' at its mid point would make an
+.. edge longer than 'amax' (or if a star is open), so that a collapse
+.. is not undone by a split
+*/
+static
+int hmesh_tri_collapse_long (HmeshTris * t, Node e, double amax)
+{
+  HmeshCells * f = t->f;
+  Node h[2] = { e, HMESH_TRI_TWIN (f, e) }, star [HMESH_TRIS_MAX_VALENCE];
+  if (h[1].index == HMESH_INDEX_NULL)
+    return 1;
+  double a[3], b[3], u[3];
+  hmesh_tri_position (t, HMESH_TRI_PIVOT (f, h[0]), a);
+  hmesh_tri_position (t, HMESH_TRI_PIVOT (f, h[1]), b);
+  for (int k = 0; k < 2; ++k)
+  {
+    int n = hmesh_tri_star (f, h[k], star, HMESH_TRIS_MAX_VALENCE);
+    if (n < 0)
+      return 1;
+    for (int j = 0; j < n; ++j)
+    {
+      hmesh_tri_position (t, HMESH_TRI_PIVOT (f, hmesh_tri_next (star[j])),
+        u);
+      double l = 0.;
+      for (int d = 0; d < 3; ++d)
+        l += (u[d] - 0.5 * (a[d] + b[d])) * (u[d] - 0.5 * (a[d] + b[d]));
+      if (l > amax * amax)
+        return 1;
+    }
+  }
+  return 0;
+}
+
+/* Push the half edges of the faces 'face' to be remeshed */
+static
+int hmesh_tris_heap_faces (HmeshTrisHeap * h, HmeshTris * t,
+  HmeshRemesh * r, Node * face, int n)
+{
+  int collapse;
+  for (int j = 0; j < n; ++j)
+    for (int c = 0; c < 3; ++c)
+    {
+      Node e = hmesh_tri_hedge (face[j], c);
+      double key = hmesh_tri_priority (t, e, r, &collapse);
+      if ( key > 0. && hmesh_tris_heap_push (h, key, e) )
+        return HMESH_ERROR;
+    }
+  return HMESH_NO_ERROR;
+}
+
+/*
+.. "hmesh_tris_remesh ()" : Remesh 't' (HmeshRemesh 'r') incrementally,
+.. worst edge first, instead of the sweeps over all the edges of
+.. hmesh_remesh () of src/backup/hmesh-remesh.h. The half edges of the
+.. 'nface' faces 'face' (Ex: faces of the vertices moved in a time step),
+.. or of all the faces if 'face' is NULL, are pushed to a heap by their
+.. priority (hmesh_tri_priority ()). The worst edge is popped, and split
+.. or collapsed (hmesh_tris_split (), hmesh_tris_collapse ()), and only
+.. the half edges of the star of the vertex 'm' (or 'a') are pushed back.
+.. So, the cost scales with the region changed. An edge popped is
+.. verified (it may be a stale entry), a collapse which is abandoned, or
+.. which would make an edge longer than amax, is skipped. To stop a cycle
+.. of splits and collapses (amin > amax/2), the collapses are counted per
+.. vertex (temporary attribute '_ops' of 't->p') : a collapse sets the
+.. count of 'a' to the largest count of 'a' and 'b' plus one, a split gives
+.. the largest one to 'm', and an edge with a vertex at HMESH_TRIS_MAX_PASS
+.. is not collapsed. So, no vertex (nor the vertices it comes from) goes
+.. through more than HMESH_TRIS_MAX_PASS collapses, while the splits, which
+.. end by themselves, are never stopped. The number of operations is
+.. stored in 'nops', if not NULL.
+*/
+#define HMESH_OPS(_n_) (((uint8_t *) HMESH_ATTR (p, iops, (_n_).iblock))      \
+                         [(_n_).index])
+int hmesh_tris_remesh (HmeshTris * t, HmeshRemesh * r, Node * face,
+  size_t nface, size_t * nops)
+{
+  if (nops)
+    *nops = 0;
+  if (!t || !r)
+  {
+    hmesh_error ("hmesh_tris_remesh () : aborted");
+    return HMESH_ERROR;
+  }
+  HmeshCells * p = t->p, * f = t->f;
+  Index iops = hmesh_attr_add (p, "_ops", sizeof (uint8_t));
+  if (iops == HMESH_INDEX_NULL)
+  {
+    hmesh_error ("hmesh_tris_remesh () : cannot add '_ops'");
+    return HMESH_ERROR;
+  }
+  HMESH_FOREACH_BLOCK (p, iblk)
+    memset (HMESH_ATTR (p, iops, iblk), 0, HMESH_BLOCK_SIZE);
+  HmeshTrisHeap h = { .item = NULL, .n = 0, .max = 0 };
+  int status = HMESH_NO_ERROR;
+  size_t n = 0;
+
+  if (face)
+  {
+    for (size_t k = 0; !status && k < nface; ++k)
+      if (hmesh_node_in_use (f, face[k]))
+        status = hmesh_tris_heap_faces (&h, t, r, face + k, 1);
+  }
+  else
+    HMESH_FOREACH_BLOCK (f, iblk)
+    {
+      HMESH_FOREACH_INDEX (f, iblk, i)
+      {
+        Node x = { .index = i, .iblock = iblk };
+        if ( (status = hmesh_tris_heap_faces (&h, t, r, &x, 1)) )
+          break;
+      }
+      if (status)
+        break;
+    }
+
+  Node star [HMESH_TRIS_MAX_VALENCE], sb [HMESH_TRIS_MAX_VALENCE];
+  while ( !status && h.n )
+  {
+    HmeshTrisItem top = hmesh_tris_heap_pop (&h);
+    Node e = top.e, s;
+    if (!hmesh_tri_in_use (f, e))
+      continue;
+    int collapse;
+    double key = hmesh_tri_priority (t, e, r, &collapse);
+    if (key <= 0.)
+      continue;
+    if (key < top.key)
+    {
+      status = hmesh_tris_heap_push (&h, key, e);
+      continue;
+    }
+    Node a = HMESH_TRI_PIVOT (f, e),
+      b = HMESH_TRI_PIVOT (f, hmesh_tri_next (e));
+    int count = HMESH_OPS (a) > HMESH_OPS (b) ? HMESH_OPS (a) : HMESH_OPS (b);
+
+    if (collapse)
+    {
+      if ( count >= HMESH_TRIS_MAX_PASS ||
+           hmesh_tri_collapse_long (t, e, r->amax) )
+        continue;
+      /* an edge which cannot be collapsed is left as it is */
+      int nb = hmesh_tri_collapse_check (f, e, sb);
+      if (nb < 0)
+        continue;
+      s = HMESH_TRI_TWIN (f, hmesh_tri_prev (e));
+      if (hmesh_tris_collapse_checked (t, e, sb, nb))
+      {
+        status = HMESH_ERROR;
+        break;
+      }
+      HMESH_OPS (a) = count + 1;
+    }
+    else
+    {
+      s = hmesh_tris_split (t, e);
+      if (s.index == HMESH_INDEX_NULL)
+      {
+        status = HMESH_ERROR;
+        break;
+      }
+      HMESH_OPS (HMESH_TRI_PIVOT (f, s)) = count;
+    }
+    ++n;
+    int nstar = hmesh_tri_star_faces (f, s, star, 0);
+    if (nstar > 0)
+      status = hmesh_tris_heap_faces (&h, t, r, star, nstar);
+  }
+
+  if (hmesh_attr_destroy (p, iops))
+    status = HMESH_ERROR;
+  if (status)
+    hmesh_error ("hmesh_tris_remesh () : failed");
+  if (nops)
+    *nops = n;
+  free (h.item);
+  return status;
+}
+#undef HMESH_OPS
@@ -1,7 +1,9 @@
 #include <common.h>
 #include <tree-pool.h>
 #include <hmesh.h>
+#include <hmesh-private.h>
 #include <ctype.h>
+#include <math.h>
 
 /* 
 .. "hmesh_array_add" : Add a block @ iblock-th position.
@@ -23,7 +25,7 @@ void * hmesh_array_add (HmeshArray * a, Index iblock, void *** mem)
   .. (*mem)[iblock] for faster access. a->blockID[iblock] is updated (used
   .. only for deallocation. 
   */
-  Index blockID = hmesh_tpool_allocate_general (a->obj_size);
+  BlockID blockID = hmesh_tpool_allocate_general (a->obj_size);
   void * m = hmesh_tpool_address (blockID);
   if (!m)
   {
@@ -34,7 +36,7 @@ void * hmesh_array_add (HmeshArray * a, Index iblock, void *** mem)
   if (a->stack.max > a->max)
   {
     a->max = a->stack.max;
-    a->blockID = realloc (a->blockID, a->max * sizeof (Index));
+    a->blockID = realloc (a->blockID, a->max * sizeof (BlockID));
     *mem = realloc (*mem, a->max * sizeof (void *));
   }
   (*mem) [iblock] = m;
@@ -69,7 +71,8 @@ int hmesh_array_remove (HmeshArray * a, Index iblock, void *** mem)
 
 /*
 .. "hmesh_array" : Create a new attribute. "name" is the name of the attribute,
-.. "size" is the size of datatype in bytes. Note : only {1,2,4,8} are allowed.
+.. "size" is the size of datatype in bytes. Note : only {1,2,4,..,
+.. 2^HMESH_TREE_POOL_DEPTH} are allowed ({1,2,4,8} for the default depth).
 .. (*mem) is for the array of memory blocks for the attribute.
 */
 HmeshArray * hmesh_array (char * name, size_t size, void *** mem)
@@ -79,20 +82,50 @@ HmeshArray * hmesh_array (char * name, size_t size, void *** mem)
     hmesh_error ("hmesh_array () : Attribute name require [1,32) chars");
     return NULL;
   }
+  if ( !size || (size & (size - 1)) ||
+       (size > ((size_t) 1 << HMESH_TREE_POOL_DEPTH)) )
+  {
+    hmesh_error ("hmesh_array () : size %zu not supported by the tree pool "
+      "of depth %d", size, HMESH_TREE_POOL_DEPTH);
+    return NULL;
+  }
   HmeshArray * a = malloc (sizeof (HmeshArray));
   a->obj_size = size;
+  a->csize    = size;
+  a->tile     = 0;
   a->stack    = index_stack (HMESH_MAX_NBLOCKS, 8, NULL);
   a->max      = a->stack.max;
   strcpy (a->name, name);
   if (a->max)
   {
-    a->blockID = malloc (a->max * sizeof (Index));
+    a->blockID = malloc (a->max * sizeof (BlockID));
     *mem = malloc (a->max * sizeof (void *));
   }
 
   return a;
 }
 
+/*
+.. "hmesh_array_reserve ()" : Reserve space for blocks [0, nblocks) of "a",
+.. so that adding them doesn't realloc the metadata arrays.
+*/
+int hmesh_array_reserve (HmeshArray * a, Index nblocks, void *** mem)
+{
+  if (index_stack_reserve (&a->stack, nblocks))
+  {
+    hmesh_error ("hmesh_array_reserve () : cannot reserve %d blocks",
+      nblocks);
+    return HMESH_ERROR;
+  }
+  if (a->stack.max > a->max)
+  {
+    a->max = a->stack.max;
+    a->blockID = realloc (a->blockID, a->max * sizeof (BlockID));
+    *mem = realloc (*mem, a->max * sizeof (void *));
+  }
+  return HMESH_NO_ERROR;
+}
+
 /*
 .. "hmesh_array_destroy ()" : Destroy attribute object "a",
 .. and deallocate all of it's blocks stored in "(*mem)[]"
@@ -104,7 +137,8 @@ int hmesh_array_destroy (HmeshArray * a, void *** mem)
 
   int status = HMESH_NO_ERROR;
   IndexInfo * info = a->stack.info;
-  for (int i = 0; i < a->stack.n; ++i)
+  /* from the end, as removing a block reorders the in_use list */
+  for (int i = a->stack.n - 1; i >= 0; --i)
   {
     Index iblock = info[i].in_use;
     if ( (*mem)[iblock] )
@@ -127,11 +161,96 @@ int hmesh_array_destroy (HmeshArray * a, void *** mem)
     hmesh_error ("hmesh_array_destroy () : index stack cannot be cleaned."
       " (Memory Leak) ");
   }
+  free (a->blockID);
   free (a);
 
   return status;
 }
 
+/*
+.. "hmesh_array_snapshot ()" : copy of the array 'a' (with blocks 'mem'),
+.. that shares all the blocks of 'a' (hmesh_tpool_share ()). The blocks of
+.. the copy are stored in (*copy)[].
+*/
+static
+HmeshArray * hmesh_array_snapshot (HmeshArray * a, void ** mem,
+  void *** copy)
+{
+  HmeshArray * b = malloc (sizeof (HmeshArray));
+  if (!b)
+    return NULL;
+  *b = *a;
+  b->stack.info = malloc (a->stack.max * sizeof (IndexInfo));
+  b->blockID = malloc (a->max * sizeof (BlockID));
+  *copy = malloc (a->max * sizeof (void *));
+  if (!b->stack.info || !b->blockID || !*copy)
+  {
+    free (b->stack.info);
+    free (b->blockID);
+    free (*copy);
+    free (b);
+    *copy = NULL;
+    return NULL;
+  }
+  memcpy (b->stack.info, a->stack.info, a->stack.max * sizeof (IndexInfo));
+  memcpy (b->blockID, a->blockID, a->max * sizeof (BlockID));
+  memcpy (*copy, mem, a->max * sizeof (void *));
+
+  int status = HMESH_NO_ERROR;
+  for (Index i = 0; i < a->stack.n; ++i)
+    status |= hmesh_tpool_share (a->blockID [a->stack.info[i].in_use]);
+  if (status)
+    hmesh_error ("hmesh_array_snapshot () : cannot share blocks of '%s'",
+      a->name);
+  return b;
+}
+
+/*
+.. "hmesh_names_lookup ()" : index of the attribute 'name' of 'cells', or
+.. HMESH_INDEX_NULL
+*/
+static
+Index hmesh_names_lookup (HmeshCells * cells, const char * name)
+{
+  HmeshNames * t = &cells->names;
+  uint32_t h = hmesh_hash (name, strlen (name));
+  for (Index i = t->head [h & (HMESH_NAMES_SIZE - 1)];
+       i != HMESH_INDEX_NULL; i = t->next [i])
+    if ( t->hash [i] == h &&
+         !strcmp (((HmeshArray *) cells->attr [i])->name, name) )
+      return i;
+  return HMESH_INDEX_NULL;
+}
+
+/*
+.. Add the attribute 'iattr' of 'cells' to the table, by its name
+*/
+static
+void hmesh_names_insert (HmeshCells * cells, Index iattr)
+{
+  HmeshNames * t = &cells->names;
+  const char * name = ((HmeshArray *) cells->attr [iattr])->name;
+  uint32_t h = hmesh_hash (name, strlen (name)),
+    slot = h & (HMESH_NAMES_SIZE - 1);
+  t->hash [iattr] = h;
+  t->next [iattr] = t->head [slot];
+  t->head [slot]  = iattr;
+}
+
+/*
+.. Remove the attribute 'iattr' of 'cells' from the table
+*/
+static
+void hmesh_names_remove (HmeshCells * cells, Index iattr)
+{
+  HmeshNames * t = &cells->names;
+  Index * i = &t->head [t->hash [iattr] & (HMESH_NAMES_SIZE - 1)];
+  while (*i != HMESH_INDEX_NULL && *i != iattr)
+    i = &t->next [*i];
+  if (*i == iattr)
+    *i = t->next [iattr];
+}
+
 /*
 .. "hmesh_cells_expand () " Add 1 block to all the attributes of "cells"
 */
@@ -139,6 +258,11 @@ static
 int hmesh_cells_expand (HmeshCells * cells)
 {
   Index iblock = index_stack_free_head (cells->blocks, 0);
+  if (iblock == HMESH_INDEX_NULL)
+  {
+    hmesh_error ("hmesh_cells_expand () : out of block index");
+    return HMESH_ERROR;
+  }
   Index nattr = cells->scalars.n;
   while (nattr--)
   {
@@ -182,17 +306,42 @@ int hmesh_cells_expand (HmeshCells * cells)
   return HMESH_NO_ERROR;
 }
 
+/*
+.. "hmesh_cells_shrink ()" : Remove the block 'iblock' from all the
+.. attributes of "cells". Expected to be called for an empty block.
+*/
+static
+int hmesh_cells_shrink (HmeshCells * cells, Index iblock)
+{
+  int status = HMESH_NO_ERROR;
+  Index nattr = cells->scalars.n;
+  while (nattr--)
+  {
+    Index iattr = cells->scalars.info[nattr].in_use;
+    HmeshArray * attr = (HmeshArray *) cells->attr[iattr];
+    if (hmesh_array_remove (attr, iblock, &cells->mem[iattr]))
+    {
+      hmesh_error ("hmesh_cells_shrink () : cannot remove block from "
+        "attr '%s'", attr->name);
+      status = HMESH_ERROR;
+    }
+  }
+  return status;
+}
+
 /*
 .. Create a HmeshCells (list of vertices, edges, etc ..)
 */
 HmeshCells * hmesh_cells (int k, int K, int D)
 {
-  HmeshCells * cells = malloc  (sizeof (HmeshCells));
-
-  if ( (!cells) || (k > K) || (K > D) || (D > 3) )
+  if ( (k > K) || (K > D) || (D > 3) )
     /* D > 3 : Not Implemented */
     return NULL;
 
+  HmeshCells * cells = malloc  (sizeof (HmeshCells));
+  if (!cells)
+    return NULL;
+
   cells->attr = NULL;
   IndexStack * scalars = &cells->scalars;
   *scalars = index_stack (HMESH_MAX_NVARS, 8, &cells->attr);
@@ -202,10 +351,14 @@ HmeshCells * hmesh_cells (int k, int K, int D)
   .. (a) For all k-cell stack we maintain the indirection map and the inverse
   .. of the indirection map.
   .. (b) For 0-simplex we maintain the position vector {x.x, x.y, .. }
-  .. (c) For all k-simplex (k > 0), we maintain a 'k-1' stack.
-  .. (d) For all k-simplex (k < K <= D), we maintain 'twin' and 'next'
+  .. (c) For all k-simplex (k > 0), we maintain its (k+1) sub cells,
+  .. 'twin' and 'next'
+  .. (d) For all k-simplex (0 < k < K <= D), we maintain a 'k-1' stack.
+  .. So the sub cells are the attributes [2, k+2], 'next' is k+3, 'twin' is
+  .. k+4 and 'k-1' is k+5.
   */
-  int nattr = cells->min = 2 + ( (k == 0) ? D : ( (k < K) ? 3 : 2) ) 
+  int nattr = cells->min =
+    (k == 0) ? 2 + D : ( (k < K) ? k + 6 : k + 5 );
   for (int iattr = 0; iattr < nattr; ++iattr)
     index_stack_allocate (scalars, iattr);
   cells->mem = malloc (scalars->max * sizeof (void **));
@@ -216,7 +369,7 @@ HmeshCells * hmesh_cells (int k, int K, int D)
   /*
   .. Use indirection map
   */
-  Hmesh * map = attr[0] =
+  HmeshArray * map = attr[0] =
     hmesh_array ("indirection_map", sizeof (Index), &mem[0]);
   attr[1] =
     hmesh_array ("inverse_indirection_map", sizeof (Index), &mem[1]);
@@ -225,6 +378,10 @@ HmeshCells * hmesh_cells (int k, int K, int D)
   cells->k = k;
   cells->max = 0;
   cells->info = NULL;
+  cells->avail = index_stack (HMESH_MAX_NBLOCKS, 8, NULL);
+  cells->shared = 0;
+  cells->owners = NULL;
+  cells->tris = 0;
 
   if (k)
   {
@@ -248,6 +405,10 @@ HmeshCells * hmesh_cells (int k, int K, int D)
     ..----------------------------------------------------------------
     */
 
+    char sub [] = "sub.0", * i = &sub[4];
+    for (int iattr = 2; iattr < k + 3; ++iattr, (*i)++ )
+      attr[iattr] = hmesh_array (sub, sizeof (Node), &mem[iattr]);
+
     /*
     .. in half-edge meshes, we keep 'next' & 'twin'
     */
@@ -259,7 +420,7 @@ HmeshCells * hmesh_cells (int k, int K, int D)
     .. It should be rather a Cache of subset of (k-1)-simplices. 
     */
     if (k < K)
-      attr[k + 5] = hmesh_array ("k-1", sizeof (Node), &mem[k + 4]);
+      attr[k + 5] = hmesh_array ("k-1", sizeof (Node), &mem[k + 5]);
   }
   else
   {
@@ -271,18 +432,66 @@ HmeshCells * hmesh_cells (int k, int K, int D)
       attr[iattr] = hmesh_array (pos, sizeof (Real), &mem[iattr]);
   }
 
-  for (Index iattr = 0; iattr < nattr; ++iattr)
+  for (Index i = 0; i < HMESH_NAMES_SIZE; ++i)
+    cells->names.head [i] = HMESH_INDEX_NULL;
+  for (int iattr = 0; iattr < nattr; ++iattr)
+  {
     if (attr[iattr] == NULL)
+    {
       hmesh_error ("hmesh_cells () : attribute missing");
+      hmesh_cells_destroy (cells);
+      return NULL;
+    }
+    hmesh_names_insert (cells, iattr);
+  }
 
   /*
   .. Expand all attributes array by 1 memory block
   */
-  hmesh_cells_expand (cells);
+  if (hmesh_cells_expand (cells))
+  {
+    hmesh_cells_destroy (cells);
+    return NULL;
+  }
 
   return cells;
 }
 
+/*
+.. "hmesh_cells_reserve ()" : Pre-size the metadata of all the attributes of
+.. 'cells' for 'nnodes' nodes. Bulk loading of nodes, doesn't realloc them
+.. anymore (only the blocks themselves are allocated, as they are needed).
+.. NOTE : Attributes added later are sized for the blocks in use.
+*/
+int hmesh_cells_reserve (HmeshCells * cells, size_t nnodes)
+{
+  size_t bsize = hmesh_tpool_block_size (),
+    nblocks = (nnodes + bsize - 1) / bsize;
+  if (nblocks >= HMESH_MAX_NBLOCKS)
+  {
+    hmesh_error ("hmesh_cells_reserve () : %zu nodes exceed the limit",
+      nnodes);
+    return HMESH_ERROR;
+  }
+
+  IndexStack * scalars = &cells->scalars;
+  for (Index i = 0; i < scalars->n; ++i)
+  {
+    Index iattr = scalars->info[i].in_use;
+    if ( hmesh_array_reserve ((HmeshArray *) cells->attr[iattr],
+           (Index) nblocks, &cells->mem[iattr]) )
+      return HMESH_ERROR;
+  }
+
+  if (cells->max < cells->blocks->max)
+  {
+    cells->max = cells->blocks->max;
+    cells->info = realloc (cells->info, cells->max * sizeof (Index));
+  }
+
+  return HMESH_NO_ERROR;
+}
+
 /* Destroy cells with all it's attributes */
 int hmesh_cells_destroy (HmeshCells * cells)
 {
@@ -294,12 +503,18 @@ int hmesh_cells_destroy (HmeshCells * cells)
   {
     Index iattr = stack->info[n].in_use;
     HmeshArray * s = (HmeshArray *) attr[iattr];
-    status |= hmesh_array_destroy (s, &mem[iattr]);
+    if (s)
+      status |= hmesh_array_destroy (s, &mem[iattr]);
   }
   free (cells->attr);
   free (cells->mem);
   free (stack->info);
   free (cells->info);
+  free (cells->avail.info);
+  /* the last of the cells sharing blocks, frees the count */
+  if ( cells->owners &&
+       !__atomic_sub_fetch (cells->owners, 1, __ATOMIC_ACQ_REL) )
+    free (cells->owners);
   free (cells);
 
   if (status)
@@ -309,88 +524,330 @@ int hmesh_cells_destroy (HmeshCells * cells)
 }
 
 /*
-.. Add a scalar with name 'name' to the list of
-.. attributes of 'cells'. NOTE: name length should be < 32,
-.. and should follow C naming rules
+.. "hmesh_cells_snapshot ()" : copy-on-write snapshot of 'cells'. The
+.. snapshot is a HmeshCells of its own, sharing all the attribute blocks
+.. with 'cells'. Only the metadata (block tables, counts, names) is copied.
+.. Thereafter, a shared block is duplicated by the first of 'cells' or the
+.. snapshot that writes it (hmesh_cells_write ()), so that the other one is
+.. never modified. The snapshot is destroyed with hmesh_cells_destroy ().
+.. Once all but one of the cells sharing blocks are destroyed, the last one
+.. is no longer 'shared' (from its next write on).
+.. NOTE : once a snapshot is taken, the blocks and the sub nodes should be
+.. written through HMESH_WRITE () (or hmesh_cells_write ()), and the values
+.. of a node through HMESH_SCALAR_W () (..). The read accessors
+.. (HMESH_SCALAR (), HMESH_REAL (), ..) never copy a block. Reading the
+.. blocks of a snapshot in a thread, while 'cells' is modified in another,
+.. is safe. Destroying it (or copying its blocks) in that thread requires
+.. the concurrent mode of the tree pool.
 */
-HmeshArray * hmesh_scalar_new (HmeshCells * cells, char * name)
+HmeshCells * hmesh_cells_snapshot (HmeshCells * cells)
 {
-  if (!name)
+  if (!cells)
   {
-    hmesh_error ("hmesh_scalar_new () : no name specified");
+    hmesh_error ("hmesh_cells_snapshot () : NULL");
     return NULL;
   }
 
-  if (strlen (name) > HMESH_MAX_VARNAME)
+  if (!cells->owners)
   {
-    hmesh_error ("hmesh_scalar_new () : very long name");
+    if (!(cells->owners = malloc (sizeof (int))))
+    {
+      hmesh_error ("hmesh_cells_snapshot () : malloc failed");
+      return NULL;
+    }
+    *cells->owners = 1;
+  }
+  HmeshCells * snap = malloc (sizeof (HmeshCells));
+  if (!snap)
+  {
+    hmesh_error ("hmesh_cells_snapshot () : malloc failed");
     return NULL;
   }
-
-  if (! (isalpha (name[0]) || name[0] == '_') )
+  *snap = *cells;
+
+  IndexStack * scalars = &snap->scalars;
+  Index maxs = cells->scalars.max;
+  snap->attr = malloc (maxs * sizeof (void *));
+  snap->mem = malloc (cells->maxs * sizeof (void **));
+  scalars->info = malloc (maxs * sizeof (IndexInfo));
+  scalars->attribute = &snap->attr;
+  snap->info = malloc ((cells->max ? cells->max : 1) * sizeof (Index));
+  snap->avail.info = malloc (cells->avail.max * sizeof (IndexInfo));
+  if ( !snap->attr || !snap->mem || !scalars->info || !snap->info ||
+       !snap->avail.info )
   {
-    hmesh_error ("hmesh_scalar_new () : wrong naming");
+    free (snap->attr);
+    free (snap->mem);
+    free (scalars->info);
+    free (snap->info);
+    free (snap->avail.info);
+    free (snap);
+    hmesh_error ("hmesh_cells_snapshot () : malloc failed");
     return NULL;
   }
-
-  for (int i=1; name[i] != '\0'; ++i)
+  __atomic_add_fetch (cells->owners, 1, __ATOMIC_RELAXED);
+  memcpy (scalars->info, cells->scalars.info, maxs * sizeof (IndexInfo));
+  memcpy (snap->info, cells->info, cells->max * sizeof (Index));
+  memcpy (snap->avail.info, cells->avail.info,
+    cells->avail.max * sizeof (IndexInfo));
+
+  /* attributes not in use are NULL, as expected by index_stack */
+  for (Index iattr = 0; iattr < maxs; ++iattr)
+    snap->attr [iattr] = NULL;
+  int status = HMESH_NO_ERROR;
+  for (Index i = 0; i < scalars->n; ++i)
   {
-    if ( ! (isalnum (name[0]) || name[0] == '_') )
+    Index iattr = scalars->info[i].in_use;
+    snap->mem [iattr] = NULL;
+    snap->attr [iattr] = hmesh_array_snapshot (
+      (HmeshArray *) cells->attr[iattr], cells->mem[iattr],
+      &snap->mem[iattr]);
+    if (!snap->attr [iattr])
     {
-      hmesh_error ("hmesh_scalar_new () : wrong naming");
-      return NULL;
+      /* drop the attribute from the snapshot, to destroy it */
+      index_stack_deallocate (scalars, iattr);
+      --i;
+      status = HMESH_ERROR;
     }
   }
-
-  IndexStack * stack = &cells->scalars;
-  void ** attr = cells->attr;
-  for (int i=cells->min; i< stack->n; ++i)
+  if (status)
   {
-    Index iscalar = stack->info[i].in_use;
-    HmeshArray * s = (HmeshArray *) attr[iscalar];
-    if (!strcmp (s->name, name))
-    {
-      hmesh_error ("hmesh_scalar_new () : scalar '%s' exists", name);
-      return NULL;
-    }
+    hmesh_error ("hmesh_cells_snapshot () : failed");
+    hmesh_cells_destroy (snap);
+    return NULL;
   }
 
-  Index iscalar = index_stack_free_head (stack, 1);
-  if (iscalar == UINT16_MAX)
+  snap->blocks = &((HmeshArray *) snap->attr[0])->stack;
+  snap->shared = cells->shared = 1;
+  return snap;
+}
+
+/*
+.. All the other cells sharing blocks with 'cells' are destroyed : the blocks
+.. are owned only by 'cells', and it's no longer 'shared'.
+*/
+static inline
+int hmesh_cells_owned (HmeshCells * cells)
+{
+  if ( !cells->owners ||
+       __atomic_load_n (cells->owners, __ATOMIC_ACQUIRE) > 1 )
+    return 0;
+  __atomic_store_n (&cells->shared, 0, __ATOMIC_RELAXED);
+  return 1;
+}
+
+/*
+.. "hmesh_cells_write ()" : address of the block 'iblock' of the attribute
+.. 'iattr' to be written. In case the block is shared with a snapshot, it's
+.. duplicated before (copy-on-write), so that the returned block is owned
+.. only by 'cells'. Use HMESH_WRITE (), which skips the call for cells that
+.. are not shared.
+*/
+void * hmesh_cells_write (HmeshCells * cells, Index iattr, Index iblock)
+{
+  if (hmesh_cells_owned (cells))
+    return HMESH_ATTR (cells, iattr, iblock);
+  HmeshArray * a = (HmeshArray *) cells->attr[iattr];
+  BlockID old = a->blockID [iblock];
+  if (!hmesh_tpool_shared (old))
+    return HMESH_ATTR (cells, iattr, iblock);
+
+  BlockID blockID = hmesh_tpool_allocate_general (a->obj_size);
+  void * m = hmesh_tpool_address (blockID);
+  if (!m)
   {
-    hmesh_error ("hmesh_scalar_new () : out of scalar index");
+    hmesh_error ("hmesh_cells_write () : cannot copy block %d of '%s'",
+      iblock, a->name);
     return NULL;
   }
+  memcpy (m, HMESH_ATTR (cells, iattr, iblock),
+    a->obj_size * hmesh_tpool_block_size ());
+  /* drops the ownership of 'cells' only */
+  hmesh_tpool_deallocate (old);
+  a->blockID [iblock] = blockID;
+  HMESH_ATTR (cells, iattr, iblock) = m;
+  return m;
+}
+
+/*
+.. "hmesh_cells_unshare ()" : hmesh_cells_write () for all the attributes
+.. of the block 'iblock'
+*/
+int hmesh_cells_unshare (HmeshCells * cells, Index iblock)
+{
+  if (!cells->shared || hmesh_cells_owned (cells))
+    return HMESH_NO_ERROR;
+  int status = HMESH_NO_ERROR;
+  for (Index i = 0; i < cells->scalars.n; ++i)
+    if (!hmesh_cells_write (cells, cells->scalars.info[i].in_use, iblock))
+      status = HMESH_ERROR;
+  return status;
+}
+
+/*
+.. Names of scalars (and typed attributes) follow C naming rules. Names
+.. starting with '_' are reserved for the temporary attributes of the
+.. library (Ex: "_key", "_claim0"), which are added by hmesh_attr_add ()
+.. without any check, so that they never repeat a name in use.
+*/
+static
+int hmesh_name_valid (char * name)
+{
+  if (!isalpha (name[0]))
+    return 0;
+  for (int i=1; name[i] != '\0'; ++i)
+    if ( ! (isalnum (name[i]) || name[i] == '_') )
+      return 0;
+  return 1;
+}
+
+/*
+.. Return 1 if an attribute 'name' or a component "name.x" or "name.xx"
+.. (of a typed attribute in SoA) of it exists.
+*/
+static
+int hmesh_name_exists (HmeshCells * cells, char * name)
+{
+  char cname [HMESH_MAX_VARNAME + 4];
+  if (hmesh_names_lookup (cells, name) != HMESH_INDEX_NULL)
+    return 1;
+  sprintf (cname, "%.*s.x", HMESH_MAX_VARNAME, name);
+  if (hmesh_names_lookup (cells, cname) != HMESH_INDEX_NULL)
+    return 1;
+  strcat (cname, "x");
+  return hmesh_names_lookup (cells, cname) != HMESH_INDEX_NULL;
+}
 
+/*
+.. Add an attribute 'name' of 'size' bytes per node, to 'cells' at the
+.. index 'iattr' (already allocated in 'cells->scalars'). Blocks are added
+.. for all the blocks in use. Return the index of the attribute.
+*/
+Index hmesh_attr_insert (HmeshCells * cells, Index iattr, char * name,
+  size_t size)
+{
+  IndexStack * stack = &cells->scalars;
   if (stack->max > cells->maxs)
   {
     cells->mem =
       realloc (cells->mem, stack->max * sizeof (void**));
     cells->maxs = stack->max;
   }
-  void *** mem = &cells->mem[iscalar];
+  void *** mem = &cells->mem[iattr];
 
-  HmeshArray * s = hmesh_array (name, sizeof (Real), mem);
+  HmeshArray * s = hmesh_array (name, size, mem);
   if (!s)
   {
-    hmesh_error ("hmesh_scalar_new () : hmesh_array () failed");
-    return NULL;
+    hmesh_error ("hmesh_attr_add () : hmesh_array () failed");
+    index_stack_deallocate (stack, iattr);
+    return HMESH_INDEX_NULL;
   }
   IndexStack * blocks = cells->blocks;
-  for (int i=0; i < blocks->n; ++i)
+  for (Index i = 0; i < blocks->n; ++i)
   {
     Index iblock = blocks->info[i].in_use;
     if ( !hmesh_array_add (s, iblock, mem) )
     {
-      hmesh_error ("hmesh_scalar_new () : hmesh_array_add() : failed");
+      hmesh_error ("hmesh_attr_add () : hmesh_array_add() : failed");
       hmesh_array_destroy (s, mem);
-      return NULL;
+      index_stack_deallocate (stack, iattr);
+      return HMESH_INDEX_NULL;
     }
   }
 
-  cells->attr[iscalar] = s;
+  cells->attr[iattr] = s;
+  hmesh_names_insert (cells, iattr);
+
+  return iattr;
+}
+
+/*
+.. Add an attribute 'name' of 'size' bytes per node, to 'cells', at the
+.. first free index. Return the index of the attribute.
+*/
+Index hmesh_attr_add (HmeshCells * cells, char * name, size_t size)
+{
+  Index iattr = index_stack_free_head (&cells->scalars, 1);
+  if (iattr == HMESH_INDEX_NULL)
+  {
+    hmesh_error ("hmesh_attr_add () : out of scalar index");
+    return HMESH_INDEX_NULL;
+  }
+  return hmesh_attr_insert (cells, iattr, name, size);
+}
+
+/*
+.. Destroy the attribute 'iattr' of 'cells' and free its index
+*/
+int hmesh_attr_destroy (HmeshCells * cells, Index iattr)
+{
+  HmeshArray * s = (HmeshArray *) cells->attr[iattr];
+  hmesh_names_remove (cells, iattr);
+  if (hmesh_array_destroy (s, &cells->mem[iattr]))
+    return HMESH_ERROR;
+  cells->attr[iattr] = NULL;
+  cells->mem[iattr]  = NULL;
+  index_stack_deallocate (&cells->scalars, iattr);
+  return HMESH_NO_ERROR;
+}
+
+/*
+.. Add a scalar with name 'name' to the list of
+.. attributes of 'cells'. NOTE: name length should be < 32,
+.. and should follow C naming rules
+*/
+HmeshArray * hmesh_scalar_new (HmeshCells * cells, char * name)
+{
+  return hmesh_scalar_new_precision (cells, name, 8 * sizeof (Real));
+}
+
+/*
+.. "hmesh_scalar_new_precision ()" : Add a scalar of 'precision' 32
+.. (float) or 64 (double) bits, irrespective of Real. Use the accessors
+.. HMESH_F32 ()/HMESH_SCALAR_F32 () (or F64) for the scalar.
+*/
+HmeshArray * hmesh_scalar_new_precision (HmeshCells * cells, char * name,
+  int precision)
+{
+  if (precision != 32 && precision != 64)
+  {
+    hmesh_error ("hmesh_scalar_new () : precision %d not supported",
+      precision);
+    return NULL;
+  }
+
+  if (!name)
+  {
+    hmesh_error ("hmesh_scalar_new () : no name specified");
+    return NULL;
+  }
+
+  if (strlen (name) > HMESH_MAX_VARNAME)
+  {
+    hmesh_error ("hmesh_scalar_new () : very long name");
+    return NULL;
+  }
+
+  if (!hmesh_name_valid (name))
+  {
+    hmesh_error ("hmesh_scalar_new () : wrong naming");
+    return NULL;
+  }
+
+  if (hmesh_name_exists (cells, name))
+  {
+    hmesh_error ("hmesh_scalar_new () : scalar '%s' exists", name);
+    return NULL;
+  }
+
+  Index iscalar = hmesh_attr_add (cells, name, precision / 8);
+  if (iscalar == HMESH_INDEX_NULL)
+  {
+    hmesh_error ("hmesh_scalar_new () : failed");
+    return NULL;
+  }
 
-  return s;
+  return (HmeshArray *) cells->attr[iscalar];
 }
 
 /*
@@ -398,32 +855,22 @@ HmeshArray * hmesh_scalar_new (HmeshCells * cells, char * name)
 */
 int hmesh_scalar_remove (HmeshCells * cells, char * name)
 {
-  if ( ! (name||cells) )
+  if ( ! (name && cells) )
   {
     hmesh_error ("hmesh_scalar_remove () : aborted");
     return HMESH_ERROR;
   }
 
-  IndexStack * stack = &cells->scalars;
-  void ** attr = cells->attr, *** mem = cells->mem;
-  Index n = stack->n;
-  while (n-- > cells->min)
+  Index iscalar = hmesh_names_lookup (cells, name);
+  if (iscalar != HMESH_INDEX_NULL && iscalar >= (Index) cells->min)
   {
-    Index iscalar = stack->info[n].in_use;
-    HmeshArray * s = (HmeshArray *) attr[iscalar];
-    if ( !strcmp (s->name, name))
+    if (hmesh_attr_destroy (cells, iscalar))
     {
-      if (hmesh_array_destroy (s, &mem[iscalar]))
-      {
-        hmesh_error ("hmesh_scalar_remove () : "
-          "cannot remove scalar '%s'", name);
-        return HMESH_ERROR;
-      }
-      attr[iscalar] = NULL;
-      mem[iscalar]  = NULL;
-      index_stack_deallocate (stack, iscalar);
-      return HMESH_NO_ERROR;
+      hmesh_error ("hmesh_scalar_remove () : "
+        "cannot remove scalar '%s'", name);
+      return HMESH_ERROR;
     }
+    return HMESH_NO_ERROR;
   }
 
   hmesh_error ("hmesh_scalar_remove () : scalar '%s' not found", name);
@@ -431,57 +878,1213 @@ int hmesh_scalar_remove (HmeshCells * cells, char * name)
 }
 
 /*
-.. Add a node to the 'cells'
+.. "hmesh_scalar_get ()" : index of the attribute 'name' of 'cells'
 */
-Node hmesh_node_new (HmeshCells * cells)
+Index hmesh_scalar_get (HmeshCells * cells, char * name)
 {
-
-  Index blk = cells->last;
-  if (cells->info [blk] == hmesh_tpool_block_size ())
-  {
-    if (hmesh_cells_expand () != HMESH_NO_ERROR)
-      return (Node) {.index = UINT16_MAX, .iblock = UINT16_MAX};
-    blk = cells->last;
-  }
-
-  return (Node) {.index = cells->info [blk]++, .iblock = blk};
+  if (!cells || !name)
+    return HMESH_INDEX_NULL;
+  return hmesh_names_lookup (cells, name);
 }
 
 /*
-.. Remove a node from 'cells'.
+.. "hmesh_attr_new ()" : Add a typed attribute 'name' of Reals ('type' :
+.. scalar, vec2, vec3, sym. tensor) with the 'layout' SoA, AoS or AoSoA to
+.. 'cells'. The attribute is described in '*a', to be used with the
+.. accessors HMESH_SOA_COMP () etc. The components of SoA are the arrays
+.. "name.x", "name.y", .. ("name.xx", "name.xy", .. for a tensor).
 */
-int hmesh_node_remove (HmeshCells * cells, Node node)
+int hmesh_attr_new (HmeshCells * cells, char * name, HmeshType type,
+  HmeshLayout layout, HmeshAttr * a)
 {
-  if (  )
-  if ( (prev[index] == UINT16_MAX) || (!index) ||
-      (index >= hmesh_tpool_block_size ()) )
-    return HMESH_ERROR;
+  static const char * vcomp [] = { "x", "y", "z" },
+    * tcomp [] = { "xx", "xy", "xz", "yy", "yz", "zz" };
 
-  Index iblock = node.iblock, index = node.index,
-    * map  = (Index *) HMESH_ATTR (cells, 0, iblock),
-    * mapi = (Index *) HMESH_ATTR (cells, 1, iblock);
-
-  if ( (prev[index] == UINT16_MAX) || (!index) ||
-      (index >= hmesh_tpool_block_size ()) )
+  if (!cells || !name || !a)
+  {
+    hmesh_error ("hmesh_attr_new () : aborted");
+    return HMESH_ERROR;
+  }
+  if (strlen (name) > HMESH_MAX_VARNAME - 3 || !hmesh_name_valid (name))
+  {
+    hmesh_error ("hmesh_attr_new () : wrong naming '%s'", name);
+    return HMESH_ERROR;
+  }
+  if (hmesh_name_exists (cells, name))
+  {
+    hmesh_error ("hmesh_attr_new () : attribute '%s' exists", name);
     return HMESH_ERROR;
+  }
+  if (type != HMESH_TYPE_SCALAR && type != HMESH_TYPE_VEC2 &&
+      type != HMESH_TYPE_VEC3 && type != HMESH_TYPE_SYMTENSOR)
+  {
+    hmesh_error ("hmesh_attr_new () : unknown type %d", type);
+    return HMESH_ERROR;
+  }
 
-  /* remove 'index' from used list */
-  next[prev[index]] = next[index];
-  prev[next[index]] = prev[index];
-  cells->info[4*iblock] = prev[index];
+  /* number of components, rounded to a power of 2 */
+  int ncomp = type, stride = 1;
+  while (stride < ncomp)
+    stride <<= 1;
 
-  /* add 'index' to free list, update free head*/
-  next[index] = cells->info[4*iblock+1];
-  prev[index] = UINT16_MAX;
-  cells->info[4*iblock+1] = index;
+  a->ncomp  = ncomp;
+  a->layout = layout;
+  for (int i = 0; i < HMESH_MAX_NCOMP; ++i)
+    a->iattr[i] = HMESH_INDEX_NULL;
 
-  /* Update count*/
-  cells->info[4*iblock+2]--;
-  cells->info[4*iblock+3]++;
+  if (layout == HMESH_LAYOUT_SOA || ncomp == 1)
+  {
+    a->layout = HMESH_LAYOUT_SOA;
+    a->stride = 1;
+    for (int i = 0; i < ncomp; ++i)
+    {
+      char cname [HMESH_MAX_VARNAME + 1];
+      if (ncomp == 1)
+        strcpy (cname, name);
+      else
+        sprintf (cname, "%s.%s", name,
+          type == HMESH_TYPE_SYMTENSOR ? tcomp[i] : vcomp[i]);
+      if ( (a->iattr[i] = hmesh_attr_add (cells, cname, sizeof (Real)))
+           == HMESH_INDEX_NULL )
+      {
+        hmesh_error ("hmesh_attr_new () : cannot add '%s'", cname);
+        while (i--)
+          hmesh_attr_destroy (cells, a->iattr[i]);
+        return HMESH_ERROR;
+      }
+    }
+    return HMESH_NO_ERROR;
+  }
+
+  if (layout != HMESH_LAYOUT_AOS && layout != HMESH_LAYOUT_AOSOA)
+  {
+    hmesh_error ("hmesh_attr_new () : unknown layout %d", layout);
+    return HMESH_ERROR;
+  }
+  size_t size = stride * sizeof (Real);
+  if (size > ((size_t) 1 << HMESH_TREE_POOL_DEPTH))
+  {
+    hmesh_error ("hmesh_attr_new () : %zu bytes per node of '%s' not "
+      "supported by the tree pool of depth %d", size, name,
+      HMESH_TREE_POOL_DEPTH);
+    return HMESH_ERROR;
+  }
+  a->stride = stride;
+  if ( (a->iattr[0] = hmesh_attr_add (cells, name, size))
+       == HMESH_INDEX_NULL )
+  {
+    hmesh_error ("hmesh_attr_new () : cannot add '%s'", name);
+    return HMESH_ERROR;
+  }
+  HmeshArray * s = (HmeshArray *) cells->attr[a->iattr[0]];
+  s->csize = sizeof (Real);
+  s->tile  = (layout == HMESH_LAYOUT_AOSOA) ? HMESH_TILE : 0;
+
+  return HMESH_NO_ERROR;
+}
+
+/*
+.. "hmesh_attr_remove ()" : Remove the typed attribute 'a' from 'cells'
+*/
+int hmesh_attr_remove (HmeshCells * cells, HmeshAttr * a)
+{
+  int status = HMESH_NO_ERROR;
+  for (int i = 0; i < HMESH_MAX_NCOMP; ++i)
+    if (a->iattr[i] != HMESH_INDEX_NULL)
+    {
+      status |= hmesh_attr_destroy (cells, a->iattr[i]);
+      a->iattr[i] = HMESH_INDEX_NULL;
+    }
+  if (status)
+    hmesh_error ("hmesh_attr_remove () : failed");
+  return status;
+}
+
+/*
+.. Nodes of a block are tracked with the indirection map (attr 0) and its
+.. inverse (attr 1). For a block with 'n' = cells->info[iblock] nodes in use,
+.. map[0, n) are the indices (node.index) in use, and map[n, bsize) are free.
+.. imap[index] is the position of 'index' in map, so that 'index' is in use
+.. iff (imap[index] < n). The data of a node is never moved, so a Node is a
+.. stable handle, while the map is densely packed. Insertion and removal
+.. are O(1), without any malloc.
+..
+.. New nodes are added to the 'tail' block. Once it's full, a block with
+.. free slots ('avail') is used, or else a new block is added.
+*/
+
+/*
+.. "hmesh_cells_tail ()" : Once the 'tail' block is full, choose a block
+.. with free slots as the 'tail', or else add a new block.
+*/
+static
+int hmesh_cells_tail (HmeshCells * cells)
+{
+  IndexStack * avail = &cells->avail;
+  if (avail->n)
+  {
+    Index blk = avail->info[avail->n - 1].in_use;
+    index_stack_deallocate (avail, blk);
+    cells->tail = blk;
+    return HMESH_NO_ERROR;
+  }
+  return hmesh_cells_expand (cells);
+}
+
+/*
+.. Add a node to the 'cells'
+*/
+Node hmesh_node_new (HmeshCells * cells)
+{
+  Index blk = cells->tail;
+  if (cells->info [blk] == hmesh_tpool_block_size ())
+  {
+    if (hmesh_cells_tail (cells) != HMESH_NO_ERROR)
+      return (Node) {.index = HMESH_INDEX_NULL, .iblock = HMESH_INDEX_NULL};
+    blk = cells->tail;
+  }
+
+  Index * map = (Index *) HMESH_ATTR (cells, 0, blk);
+  return (Node) {.index = map [cells->info [blk]++], .iblock = blk};
+}
+
+/*
+.. "hmesh_nodes_new ()" : Add 'n' nodes to the 'cells', and store them in
+.. 'out' (if not NULL). The metadata of the attributes are reserved at once,
+.. and the nodes are taken block by block. Returns the number of nodes
+.. added, which is less than 'n' only in case of an error.
+*/
+size_t hmesh_nodes_new (HmeshCells * cells, size_t n, Node * out)
+{
+  size_t bsize = hmesh_tpool_block_size (),
+    nfree = bsize - cells->info [cells->tail];
+  IndexStack * avail = &cells->avail;
+  for (Index i = 0; i < avail->n; ++i)
+    nfree += bsize - cells->info [avail->info[i].in_use];
+  if (n > nfree)
+  {
+    size_t nblocks = cells->blocks->n + (n - nfree + bsize - 1) / bsize;
+    if (hmesh_cells_reserve (cells, nblocks * bsize))
+      return 0;
+  }
+
+  size_t added = 0;
+  while (added < n)
+  {
+    Index blk = cells->tail;
+    if (cells->info [blk] == bsize)
+    {
+      if (hmesh_cells_tail (cells) != HMESH_NO_ERROR)
+        break;
+      blk = cells->tail;
+    }
+
+    Index * map = (Index *) HMESH_ATTR (cells, 0, blk), m = cells->info [blk];
+    size_t chunk = bsize - m < n - added ? bsize - m : n - added;
+    if (out)
+      for (size_t i = 0; i < chunk; ++i)
+        out [added + i] = (Node) {.index = map [m + i], .iblock = blk};
+    cells->info [blk] = m + chunk;
+    added += chunk;
+  }
+
+  return added;
+}
+
+/*
+.. Remove a node from 'cells'. The last node in the map of the block takes
+.. the position of the removed node. An empty block (other than the tail)
+.. is returned to the pool.
+*/
+int hmesh_node_remove (HmeshCells * cells, Node node)
+{
+  Index iblock = node.iblock, index = node.index;
+  IndexStack * blocks = cells->blocks;
+  size_t bsize = hmesh_tpool_block_size ();
+
+  if ( (iblock >= blocks->max) || (index >= bsize) ||
+       (blocks->info[iblock].loc == HMESH_INDEX_NULL) )
+  {
+    hmesh_error ("hmesh_node_remove () : invalid node [%d:%d]",
+      iblock, index);
+    return HMESH_ERROR;
+  }
+
+  Index * map  = (Index *) HMESH_ATTR (cells, 0, iblock),
+    * imap = (Index *) HMESH_ATTR (cells, 1, iblock),
+    n = cells->info[iblock], loc = imap[index];
+
+  if (loc >= n)
+  {
+    hmesh_error ("hmesh_node_remove () : node [%d:%d] not in use",
+      iblock, index);
+    return HMESH_ERROR;
+  }
+
+  /* a block shared with a snapshot is copied, before it's modified */
+  if ( cells->shared &&
+       ( !(map  = (Index *) hmesh_cells_write (cells, 0, iblock)) ||
+         !(imap = (Index *) hmesh_cells_write (cells, 1, iblock)) ) )
+    return HMESH_ERROR;
+
+  /* swap with the last node in use */
+  Index last = map[--n];
+  map[loc]    = last;
+  imap[last]  = loc;
+  map[n]      = index;
+  imap[index] = n;
+  cells->info[iblock] = n;
+
+  if (iblock == cells->tail)
+    return HMESH_NO_ERROR;
+
+  /* block has free slots now */
+  if (n == bsize - 1)
+    index_stack_allocate (&cells->avail, iblock);
+
+  /* return an empty block */
+  if (!n)
+  {
+    index_stack_deallocate (&cells->avail, iblock);
+    return hmesh_cells_shrink (cells, iblock);
+  }
+
+  return HMESH_NO_ERROR;
+}
+
+/*
+.. "hmesh_remap_free ()" : free the remap table of a compaction
+*/
+void hmesh_remap_free (HmeshRemap * remap)
+{
+  if (!remap->node)
+    return;
+  for (Index iblock = 0; iblock < remap->max; ++iblock)
+    if (remap->node [iblock])
+      free (remap->node [iblock]);
+  free (remap->node);
+  remap->node = NULL;
+  remap->max = 0;
+}
+
+/*
+.. "hmesh_cells_remap ()" : Replace the nodes stored in the attribute
+.. 'iattr' (of type Node) of all the nodes of 'cells', with their new nodes
+.. in the 'remap' table.
+*/
+int hmesh_cells_remap (HmeshCells * cells, Index iattr, HmeshRemap * remap)
+{
+  if ( (iattr >= cells->maxs) || !cells->attr[iattr] ||
+       ((HmeshArray *) cells->attr[iattr])->obj_size != sizeof (Node) )
+  {
+    hmesh_error ("hmesh_cells_remap () : attr %d is not of Node", iattr);
+    return HMESH_ERROR;
+  }
+
+  HMESH_FOREACH_BLOCK (cells, iblock)
+  {
+    Node * node = (Node *) HMESH_WRITE (cells, iattr, iblock);
+    if (!node)
+      return HMESH_ERROR;
+    HMESH_FOREACH_INDEX (cells, iblock, index)
+      node [index] = hmesh_remap_node (remap, node [index]);
+  }
+
+  return HMESH_NO_ERROR;
+}
+
+/*
+.. Replace the half edges (3 f + c) stored in the attribute 'iattr' of the
+.. faces of HmeshTris, with the half edges of the new faces in the 'remap'
+.. table. The corner 'c' of a half edge is kept, as it moves with its face.
+*/
+static
+int hmesh_tris_remap (HmeshCells * f, Index iattr, HmeshRemap * remap)
+{
+  HMESH_FOREACH_BLOCK (f, iblock)
+  {
+    Node * node = (Node *) HMESH_WRITE (f, iattr, iblock);
+    if (!node)
+      return HMESH_ERROR;
+    HMESH_FOREACH_INDEX (f, iblock, index)
+    {
+      Node e = node [index];
+      if (e.index != HMESH_INDEX_NULL)
+        node [index] = hmesh_tri_hedge (
+          hmesh_remap_node (remap, hmesh_tri_face (e)), e.index % 3);
+    }
+  }
+  return HMESH_NO_ERROR;
+}
+
+/*
+.. Update the references of 'cells' to its own moved nodes : 'next' and
+.. 'twin' of k-cells (k > 0), or the twins (half edges) of the faces of
+.. HmeshTris.
+*/
+static
+int hmesh_cells_remap_self (HmeshCells * cells, HmeshRemap * remap)
+{
+  int status = HMESH_NO_ERROR;
+  if (cells->tris)
+    for (int c = 0; c < 3; ++c)
+      status |= hmesh_tris_remap (cells, HMESH_TRI_ITWIN + c, remap);
+  else if (cells->k)
+  {
+    status |= hmesh_cells_remap (cells, cells->k + 3, remap);
+    status |= hmesh_cells_remap (cells, cells->k + 4, remap);
+  }
+  return status;
+}
+
+/*
+.. Copy the data of the node 'from' of the block 'src' of 'a', to the node
+.. 'to' of the block 'dst'. Components of a tiled array (AoSoA) are apart
+.. by 'tile' objects.
+*/
+static inline
+void hmesh_array_copy (HmeshArray * a, void * dst, Index to, void * src,
+  Index from)
+{
+  size_t size = a->obj_size;
+  if (!a->tile)
+  {
+    memcpy ((char *) dst + to * size, (char *) src + from * size, size);
+    return;
+  }
+  size_t csize = a->csize, ncomp = size / csize, tile = a->tile,
+    ito = ((to & ~(tile - 1)) * ncomp + (to & (tile - 1))) * csize,
+    ifrom = ((from & ~(tile - 1)) * ncomp + (from & (tile - 1))) * csize;
+  for (size_t i = 0; i < ncomp; ++i)
+    memcpy ((char *) dst + ito + i * tile * csize,
+      (char *) src + ifrom + i * tile * csize, csize);
+}
+
+typedef struct
+{
+  Index n, iblock;
+} HmeshBlockCount;
+
+static
+int hmesh_block_count_compare (const void * a, const void * b)
+{
+  /* descending order of the number of nodes */
+  return (int) ((const HmeshBlockCount *) b)->n -
+    (int) ((const HmeshBlockCount *) a)->n;
+}
+
+/*
+.. "hmesh_cells_compact ()" : Move the nodes of the sparse blocks of 'cells'
+.. to the free slots of the dense blocks, so that the nodes occupy the least
+.. number of blocks. All the attributes are moved, and the emptied blocks
+.. are returned to the tree pool. The densest blocks are kept, so that the
+.. least number of nodes is moved.
+.. The new node of each moved node is stored in 'remap' (if not NULL), which
+.. should be freed by hmesh_remap_free (). The references to the nodes of
+.. 'cells' by the nodes of 'cells' itself ('next' and 'twin', or the twins
+.. of the faces of HmeshTris) are updated. Other references (Ex: vertices
+.. of edges) should be updated using hmesh_cells_remap (), or use
+.. hmesh_compact () for the whole mesh (hmesh_tris_compact () for
+.. HmeshTris).
+*/
+int hmesh_cells_compact (HmeshCells * cells, HmeshRemap * remap)
+{
+  HmeshRemap r = { .node = NULL, .max = 0, .bsize = 0 };
+  IndexStack * blocks = cells->blocks;
+  Index nblocks = blocks->n;
+  size_t bsize = hmesh_tpool_block_size (), nnodes = 0;
+
+  HmeshBlockCount * count = malloc (nblocks * sizeof (HmeshBlockCount));
+  if (!count)
+  {
+    hmesh_error ("hmesh_cells_compact () : malloc failed");
+    return HMESH_ERROR;
+  }
+  for (Index i = 0; i < nblocks; ++i)
+  {
+    Index iblock = blocks->info[i].in_use;
+    count[i] = (HmeshBlockCount) { .n = cells->info [iblock],
+      .iblock = iblock };
+    nnodes += count[i].n;
+  }
+  qsort (count, nblocks, sizeof (HmeshBlockCount),
+    hmesh_block_count_compare);
+
+  /* blocks [0, ndense) are kept. At least 1 block is kept */
+  Index ndense = nnodes ? (Index) ((nnodes + bsize - 1) / bsize) : 1;
+  if (ndense >= nblocks)
+  {
+    free (count);
+    if (remap)
+      *remap = r;
+    return HMESH_NO_ERROR;
+  }
+
+  r.max   = blocks->max;
+  r.bsize = (Index) bsize;
+  r.node  = calloc (r.max, sizeof (Node *));
+
+  /*
+  .. the new nodes of the sparse blocks, allocated before any node is moved.
+  .. A free slot (Ex: a stale handle) is remapped to HMESH_NODE_NULL
+  */
+  Index nattr = 0, * iattrs = malloc (cells->scalars.n * sizeof (Index));
+  int failed = !r.node || !iattrs;
+  for (Index isparse = ndense; isparse < nblocks && !failed; ++isparse)
+  {
+    Node * moved = r.node [count[isparse].iblock] =
+      malloc (bsize * sizeof (Node));
+    if (!(failed = !moved))
+      for (size_t j = 0; j < bsize; ++j)
+        moved [j] = HMESH_NODE_NULL;
+  }
+  if (failed)
+  {
+    if (r.node)
+      hmesh_remap_free (&r);
+    free (iattrs);
+    free (count);
+    hmesh_error ("hmesh_cells_compact () : malloc failed");
+    return HMESH_ERROR;
+  }
+
+  /* attributes to be moved, other than map & imap */
+  for (Index i = 0; i < cells->scalars.n; ++i)
+    if (cells->scalars.info[i].in_use > 1)
+      iattrs [nattr++] = cells->scalars.info[i].in_use;
+
+  /* blocks receiving the nodes are written */
+  int status = HMESH_NO_ERROR;
+  for (Index i = 0; i < ndense; ++i)
+    status |= hmesh_cells_unshare (cells, count[i].iblock);
+
+  Index idense = 0;
+  for (Index isparse = ndense; isparse < nblocks; ++isparse)
+  {
+    Index src = count[isparse].iblock, n = cells->info [src],
+      * smap = (Index *) HMESH_ATTR (cells, 0, src);
+    Node * moved = r.node [src];
+    for (Index j = 0; j < n; ++j)
+    {
+      /* next dense block with a free slot */
+      while (cells->info [count[idense].iblock] == bsize)
+        ++idense;
+      Index dst = count[idense].iblock,
+        * dmap = (Index *) HMESH_ATTR (cells, 0, dst),
+        from = smap[j], to = dmap [cells->info [dst]++];
+      moved [from] = (Node) { .index = to, .iblock = dst };
+
+      for (Index a = 0; a < nattr; ++a)
+      {
+        Index iattr = iattrs[a];
+        hmesh_array_copy ((HmeshArray *) cells->attr[iattr],
+          HMESH_ATTR (cells, iattr, dst), to,
+          HMESH_ATTR (cells, iattr, src), from);
+      }
+    }
+    cells->info [src] = 0;
+  }
+
+  /*
+  .. Release the emptied blocks. The blocks with free slots are
+  .. re-evaluated, and the least dense block is the new tail
+  */
+  IndexStack * avail = &cells->avail;
+  while (avail->n)
+    index_stack_deallocate (avail, avail->info[avail->n - 1].in_use);
+  for (Index isparse = ndense; isparse < nblocks; ++isparse)
+    status |= hmesh_cells_shrink (cells, count[isparse].iblock);
+  cells->tail = count[ndense - 1].iblock;
+  for (Index i = 0; i + 1 < ndense; ++i)
+    if (cells->info [count[i].iblock] < bsize)
+      index_stack_allocate (avail, count[i].iblock);
+
+  /* references within the cells */
+  status |= hmesh_cells_remap_self (cells, &r);
+
+  free (iattrs);
+  free (count);
+  if (remap)
+    *remap = r;
+  else
+    hmesh_remap_free (&r);
+
+  if (status)
+    hmesh_error ("hmesh_cells_compact () : failed");
+  return status;
+}
+
+/*
+.. Update the references of the (k+1)-cells of 'h' to the moved k-cells,
+.. i.e. the sub cells and 'k-1' of (k+1)-cells.
+*/
+static
+int hmesh_remap_sup (Hmesh * h, int k, HmeshRemap * remap)
+{
+  HmeshCells * c[4] = { h->p, h->e, h->t, h->v },
+    * sup = (k < h->K) ? c[k + 1] : NULL;
+  int status = HMESH_NO_ERROR;
+  if (sup && remap->node)
+  {
+    /* sub cells [2, k+3] and 'k-1' of (k+1)-cells */
+    for (Index iattr = 2; iattr < (Index) (k + 4); ++iattr)
+      status |= hmesh_cells_remap (sup, iattr, remap);
+    if (k + 1 < h->K)
+      status |= hmesh_cells_remap (sup, k + 6, remap);
+  }
+  return status;
+}
+
+/*
+.. "hmesh_compact ()" : Compact all the cells of the mesh, and update the
+.. references to the moved nodes, i.e. the sub cells and 'k-1' of
+.. (k+1)-cells, in case k-cells are compacted.
+*/
+int hmesh_compact (Hmesh * h)
+{
+  HmeshCells * c[4] = { h->p, h->e, h->t, h->v };
+  int status = HMESH_NO_ERROR;
+  for (int k = 0; k <= h->K; ++k)
+  {
+    HmeshRemap remap;
+    if (!c[k] || hmesh_cells_compact (c[k], &remap))
+    {
+      status = HMESH_ERROR;
+      continue;
+    }
+    status |= hmesh_remap_sup (h, k, &remap);
+    hmesh_remap_free (&remap);
+  }
+  return status;
+}
+
+/*
+.. "hmesh_cells_reorder ()" : Move the nodes of 'cells', so that 'order[i]'
+.. is the i-th node in the order of memory, i.e. the slot (i % bsize) of
+.. the (i / bsize)-th block. 'order' should be a permutation of all the 'n'
+.. nodes in use. The nodes are copied to new (dense) blocks, and the old
+.. blocks are returned to the pool, so that memory of the cells is needed
+.. twice during the reorder. The new node of each node is stored in
+.. 'remap' (if not NULL) as in hmesh_cells_compact (), and 'next' & 'twin'
+.. of 'cells' (or the twins of the faces of HmeshTris) are updated.
+*/
+int hmesh_cells_reorder (HmeshCells * cells, Node * order, size_t n,
+  HmeshRemap * remap)
+{
+  HmeshRemap r = { .node = NULL, .max = 0, .bsize = 0 };
+  IndexStack * blocks = cells->blocks;
+  size_t bsize = hmesh_tpool_block_size (), nnodes = 0;
+  HMESH_FOREACH_BLOCK (cells, iblock)
+    nnodes += HMESH_BLOCK_COUNT (cells, iblock);
+  if (nnodes != n)
+  {
+    hmesh_error ("hmesh_cells_reorder () : %zu nodes in order, %zu in use",
+      n, nnodes);
+    return HMESH_ERROR;
+  }
+
+  /* verify 'order' is a permutation of the nodes in use */
+  r.max   = blocks->max;
+  r.bsize = (Index) bsize;
+  r.node  = calloc (r.max, sizeof (Node *));
+  HMESH_FOREACH_BLOCK (cells, iblock)
+  {
+    r.node [iblock] = malloc (bsize * sizeof (Node));
+    for (size_t j = 0; j < bsize; ++j)
+      r.node [iblock][j] = HMESH_NODE_NULL;
+  }
+  for (size_t i = 0; i < n; ++i)
+  {
+    Node o = order[i];
+    if ( o.iblock >= r.max || o.index >= bsize || !r.node [o.iblock] ||
+         ((Index *) HMESH_ATTR (cells, 1, o.iblock))[o.index] >=
+           cells->info [o.iblock] ||
+         r.node [o.iblock][o.index].index != HMESH_INDEX_NULL )
+    {
+      hmesh_error ("hmesh_cells_reorder () : order[%zu] is not a node in "
+        "use, or repeated", i);
+      hmesh_remap_free (&r);
+      return HMESH_ERROR;
+    }
+    r.node [o.iblock][o.index].index = 0;
+  }
+
+  /* old blocks. The blocks with free slots are re-evaluated */
+  Index nold = blocks->n, * old = malloc ((nold ? nold : 1) * sizeof (Index));
+  for (Index i = 0; i < nold; ++i)
+    old[i] = blocks->info[i].in_use;
+  IndexStack * avail = &cells->avail;
+  while (avail->n)
+    index_stack_deallocate (avail, avail->info[avail->n - 1].in_use);
+
+  /* attributes to be moved, other than map & imap */
+  Index nattr = 0, * iattrs = malloc (cells->scalars.n * sizeof (Index));
+  for (Index i = 0; i < cells->scalars.n; ++i)
+    if (cells->scalars.info[i].in_use > 1)
+      iattrs [nattr++] = cells->scalars.info[i].in_use;
+
+  int status = HMESH_NO_ERROR;
+  for (size_t i = 0; i < n; i += bsize)
+  {
+    if (hmesh_cells_expand (cells))
+    {
+      status = HMESH_ERROR;
+      break;
+    }
+    Index dst = cells->tail, m = (Index) ((n - i < bsize) ? n - i : bsize);
+    for (Index to = 0; to < m; ++to)
+    {
+      Node from = order [i + to];
+      r.node [from.iblock][from.index] =
+        (Node) { .index = to, .iblock = dst };
+      for (Index a = 0; a < nattr; ++a)
+      {
+        Index iattr = iattrs[a];
+        hmesh_array_copy ((HmeshArray *) cells->attr[iattr],
+          HMESH_ATTR (cells, iattr, dst), to,
+          HMESH_ATTR (cells, iattr, from.iblock), from.index);
+      }
+    }
+    cells->info [dst] = m;
+  }
+
+  if (!status)
+  {
+    /* an empty cells keeps its (empty) block */
+    for (Index i = 0; i < nold && n; ++i)
+    {
+      cells->info [old[i]] = 0;
+      status |= hmesh_cells_shrink (cells, old[i]);
+    }
+    status |= hmesh_cells_remap_self (cells, &r);
+  }
+
+  free (iattrs);
+  free (old);
+  if (remap && !status)
+    *remap = r;
+  else
+    hmesh_remap_free (&r);
+
+  if (status)
+    hmesh_error ("hmesh_cells_reorder () : failed");
+  return status;
+}
+
+/*
+.. Space filling curve key of a point of 'HMESH_CURVE_BITS' bits per
+.. coordinate 'x[0, D)'. The bits are interleaved (x[0] first), from the
+.. most significant. For HMESH_CURVE_HILBERT, 'x' is transformed before (J.
+.. Skilling, "Programming the Hilbert curve", AIP Conf. Proc. 707, 2004).
+*/
+#define HMESH_CURVE_BITS 21
+
+static
+uint64_t hmesh_curve_key (uint32_t * x, int D, HmeshCurve curve)
+{
+  const int b = HMESH_CURVE_BITS;
+  if (curve == HMESH_CURVE_HILBERT)
+  {
+    uint32_t M = 1u << (b - 1), P, Q, t;
+    /* inverse undo */
+    for (Q = M; Q > 1; Q >>= 1)
+    {
+      P = Q - 1;
+      for (int i = 0; i < D; ++i)
+        if (x[i] & Q)
+          x[0] ^= P;
+        else
+        {
+          t = (x[0] ^ x[i]) & P;
+          x[0] ^= t;
+          x[i] ^= t;
+        }
+    }
+    /* gray encode */
+    for (int i = 1; i < D; ++i)
+      x[i] ^= x[i-1];
+    t = 0;
+    for (Q = M; Q > 1; Q >>= 1)
+      if (x[D-1] & Q)
+        t ^= Q - 1;
+    for (int i = 0; i < D; ++i)
+      x[i] ^= t;
+  }
+
+  uint64_t key = 0;
+  for (int j = b - 1; j >= 0; --j)
+    for (int i = 0; i < D; ++i)
+      key = (key << 1) | ((x[i] >> j) & 1);
+  return key;
+}
+
+static
+int hmesh_key_compare (const void * a, const void * b)
+{
+  uint64_t x = ((const HmeshKey *) a)->key, y = ((const HmeshKey *) b)->key;
+  return (x > y) - (x < y);
+}
+
+/*
+.. Sort 'key' by the key, as in hmesh_nodes_sort () : LSD radix sort of 16
+.. bit digits (digits not in use are skipped), qsort () for small 'n'
+*/
+static
+int hmesh_keys_sort (HmeshKey * key, size_t n)
+{
+  if (n < (1<<12))
+  {
+    qsort (key, n, sizeof (HmeshKey), hmesh_key_compare);
+    return HMESH_NO_ERROR;
+  }
+
+  HmeshKey * tmp = malloc (n * sizeof (HmeshKey));
+  size_t * count = malloc ((1<<16) * sizeof (size_t));
+  if (!tmp || !count)
+  {
+    free (tmp);
+    free (count);
+    hmesh_error ("hmesh_keys_sort () : malloc failed");
+    return HMESH_ERROR;
+  }
+
+  uint64_t used = 0;
+  for (size_t i = 0; i < n; ++i)
+    used |= key[i].key;
+
+  HmeshKey * src = key, * dst = tmp;
+  for (int shift = 0; shift < 64; shift += 16)
+  {
+    if ( !((used >> shift) & 0xFFFF) )
+      continue;
+
+    memset (count, 0, (1<<16) * sizeof (size_t));
+    for (size_t i = 0; i < n; ++i)
+      ++count [(src[i].key >> shift) & 0xFFFF];
+    size_t sum = 0;
+    for (size_t d = 0; d < (1<<16); ++d)
+    {
+      size_t c = count[d];
+      count[d] = sum;
+      sum += c;
+    }
+    for (size_t i = 0; i < n; ++i)
+      dst [count [(src[i].key >> shift) & 0xFFFF]++] = src[i];
+
+    HmeshKey * t = src;
+    src = dst;
+    dst = t;
+  }
 
+  if (src != key)
+    memcpy (key, src, n * sizeof (HmeshKey));
+  free (tmp);
+  free (count);
   return HMESH_NO_ERROR;
 }
 
+/* bounding box [lo, hi] of the vertices 'p' (in R^D) */
+void hmesh_bounds (HmeshCells * p, int D, Real lo[3], Real hi[3])
+{
+  for (int d = 0; d < 3; ++d)
+  {
+    lo[d] = HUGE_VAL;
+    hi[d] = -HUGE_VAL;
+  }
+  HMESH_FOREACH_BLOCK (p, iblock)
+    for (int d = 0; d < D; ++d)
+    {
+      Real * x = HMESH_REAL (p, 2 + d, iblock);
+      HMESH_FOREACH_INDEX (p, iblock, index)
+      {
+        if (x[index] < lo[d])
+          lo[d] = x[index];
+        if (x[index] > hi[d])
+          hi[d] = x[index];
+      }
+    }
+}
+
+/*
+.. Reorder 'cells' along the space filling 'curve'. The key of each node is
+.. stored in the attribute 'ikey' : the key of its position in the box
+.. [lo, hi] (for 'sub' NULL, i.e. vertices), or else the key of its
+.. 'sub.0' (the attribute 'isub' of 'sub', which is moved already).
+*/
+int hmesh_cells_curve (HmeshCells * cells, Index ikey, HmeshCells * sub,
+  Index isub, int D, Real lo[3], Real hi[3], HmeshCurve curve,
+  HmeshRemap * remap)
+{
+  size_t n = 0;
+  HMESH_FOREACH_BLOCK (cells, iblock)
+    n += HMESH_BLOCK_COUNT (cells, iblock);
+  HmeshKey * key = malloc ((n ? n : 1) * sizeof (HmeshKey));
+  Node * order = malloc ((n ? n : 1) * sizeof (Node));
+  size_t i = 0;
+  HMESH_FOREACH_BLOCK (cells, iblock)
+  {
+    uint64_t * kb = (uint64_t *) HMESH_ATTR (cells, ikey, iblock);
+    HMESH_FOREACH_INDEX (cells, iblock, index)
+    {
+      Node node = { .index = index, .iblock = iblock };
+      if (sub)
+      {
+        Node s = HMESH_SUBNODE (cells, node, 0);
+        kb [index] = ((uint64_t *) HMESH_ATTR (sub, isub, s.iblock))
+          [s.index];
+      }
+      else
+      {
+        uint32_t q[3] = { 0, 0, 0 };
+        for (int d = 0; d < D; ++d)
+        {
+          Real x = HMESH_REAL (cells, 2 + d, iblock) [index],
+            range = hi[d] - lo[d];
+          q[d] = range > 0. ? (uint32_t) ((x - lo[d]) / range *
+            ((1u << HMESH_CURVE_BITS) - 1)) : 0;
+        }
+        kb [index] = hmesh_curve_key (q, D, curve);
+      }
+      key [i++] = (HmeshKey) { .key = kb [index], .node = node };
+    }
+  }
+  int status = hmesh_keys_sort (key, n);
+  for (i = 0; i < n; ++i)
+    order [i] = key [i].node;
+  free (key);
+  if (!status)
+    status = hmesh_cells_reorder (cells, order, n, remap);
+  free (order);
+  return status;
+}
+
+/*
+.. "hmesh_reorder ()" : Renumber all the cells of the mesh along a space
+.. filling curve (HMESH_CURVE_MORTON or HMESH_CURVE_HILBERT), so that the
+.. nodes close in space are close in memory. Vertices are sorted by the
+.. key of their position (in the bounding box of the vertices), and the
+.. k-cells (k > 0) by the key of their sub cell 'sub.0'. References to the
+.. moved nodes (sub cells, 'k-1', 'next', 'twin') are updated.
+.. NOTE : Node attributes added by the user are not updated.
+*/
+int hmesh_reorder (Hmesh * h, HmeshCurve curve)
+{
+  if (!h || (curve != HMESH_CURVE_MORTON && curve != HMESH_CURVE_HILBERT))
+  {
+    hmesh_error ("hmesh_reorder () : aborted");
+    return HMESH_ERROR;
+  }
+
+  HmeshCells * c[4] = { h->p, h->e, h->t, h->v };
+  int status = HMESH_NO_ERROR;
+  Real lo[3], hi[3];
+  hmesh_bounds (c[0], h->D, lo, hi);
+
+  /*
+  .. A temporary attribute '_key' (of the key) is added to each cells, so
+  .. that the key of a k-cell is of 'sub.0' (which is moved already)
+  */
+  Index ikey [4] = { HMESH_INDEX_NULL, HMESH_INDEX_NULL, HMESH_INDEX_NULL,
+    HMESH_INDEX_NULL };
+  for (int k = 0; k <= h->K; ++k)
+  {
+    ikey [k] = hmesh_attr_add (c[k], "_key", sizeof (uint64_t));
+    HmeshRemap remap;
+    if ( ikey [k] == HMESH_INDEX_NULL ||
+         hmesh_cells_curve (c[k], ikey[k], k ? c[k-1] : NULL,
+           k ? ikey[k-1] : HMESH_INDEX_NULL, h->D, lo, hi, curve, &remap) )
+    {
+      status = HMESH_ERROR;
+      break;
+    }
+    status |= hmesh_remap_sup (h, k, &remap);
+    hmesh_remap_free (&remap);
+    if (status)
+      break;
+  }
+
+  for (int k = 0; k <= h->K; ++k)
+    if (ikey [k] != HMESH_INDEX_NULL)
+      hmesh_attr_destroy (c[k], ikey [k]);
+
+  if (status)
+    hmesh_error ("hmesh_reorder () : failed");
+  return status;
+}
+
+static
+int hmesh_node_compare (const void * a, const void * b)
+{
+  const Node * x = (const Node *) a, * y = (const Node *) b;
+  return (x->iblock != y->iblock) ? (x->iblock < y->iblock ? -1 : 1) :
+    (x->index < y->index ? -1 : x->index > y->index);
+}
+
+/*
+.. "hmesh_nodes_sort ()" : Sort 'n' nodes by (iblock, index). It's a LSD
+.. radix sort of 16 bit digits : index first, then iblock. Digits which are
+.. 0 for all the nodes are skipped, so it's 2 passes for most of the lists.
+.. Short lists are sorted with qsort ().
+*/
+int hmesh_nodes_sort (Node * node, size_t n)
+{
+  if (n < (1<<12))
+  {
+    qsort (node, n, sizeof (Node), hmesh_node_compare);
+    return HMESH_NO_ERROR;
+  }
+
+  Node * tmp = malloc (n * sizeof (Node));
+  size_t * count = malloc ((1<<16) * sizeof (size_t));
+  if (!tmp || !count)
+  {
+    free (tmp);
+    free (count);
+    hmesh_error ("hmesh_nodes_sort () : malloc failed");
+    return HMESH_ERROR;
+  }
+
+  /* bits in use */
+  Index iused = 0, bused = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    iused |= node[i].index;
+    bused |= node[i].iblock;
+  }
+
+  Node * src = node, * dst = tmp;
+  for (int pass = 0; pass < 2 * HMESH_INDEX_BITS / 16; ++pass)
+  {
+    int block = pass >= HMESH_INDEX_BITS / 16,
+      shift = 16 * (block ? pass - HMESH_INDEX_BITS / 16 : pass);
+    if ( !(((block ? bused : iused) >> shift) & 0xFFFF) )
+      continue;
+
+    memset (count, 0, (1<<16) * sizeof (size_t));
+    for (size_t i = 0; i < n; ++i)
+      ++count [((block ? src[i].iblock : src[i].index) >> shift) & 0xFFFF];
+    size_t sum = 0;
+    for (size_t d = 0; d < (1<<16); ++d)
+    {
+      size_t c = count[d];
+      count[d] = sum;
+      sum += c;
+    }
+    for (size_t i = 0; i < n; ++i)
+      dst [count [((block ? src[i].iblock : src[i].index) >> shift) &
+        0xFFFF]++] = src[i];
+
+    Node * t = src;
+    src = dst;
+    dst = t;
+  }
+
+  if (src != node)
+    memcpy (node, src, n * sizeof (Node));
+  free (tmp);
+  free (count);
+  return HMESH_NO_ERROR;
+}
+
+static inline
+size_t hmesh_hedge_slot (HmeshCells * e, Node x, int reverse, size_t mask)
+{
+  HmeshHedgeKey key = { .v = { HMESH_IVERTEX (e, x, reverse),
+    HMESH_IVERTEX (e, x, !reverse) } };
+  return hmesh_hash ((const char *) &key, sizeof (key)) & mask;
+}
+
+/*
+.. "hmesh_hedges_new ()" : Add the half edges of the 'nface' triangles
+.. 'face' (3 vertices each, counter clockwise) to the half edges 'h->e'.
+.. The half edge 's' of a face goes from its vertex 's' to 's+1', i.e.
+.. 'sub.0' is the pivot. 'next' is set within each face and 'twin' is set
+.. by matching the vertices with all the half edges of 'h->e' with an
+.. unset twin (so that faces can be added to an existing surface). A half
+.. edge with no match is a boundary, and its twin is HMESH_NODE_NULL. The
+.. new half edges (3 per face, in the order of the faces) are stored in
+.. 'out', if not NULL.
+.. NOTE : A half edge repeated (i.e. a non-manifold edge, or faces with
+.. inconsistent orientation) is an error, and the half edges are not
+.. removed in that case.
+.. NOTE : the half edges are in the order of 'face', so the walks of an
+.. unordered surface miss the cache on each hop (slower than 'Hedge').
+.. Call hmesh_reorder () after, before the walks.
+*/
+int hmesh_hedges_new (Hmesh * h, Node (* face)[3], size_t nface, Node * out)
+{
+  HmeshCells * v = h ? h->p : NULL, * e = h ? h->e : NULL;
+  if ( !e || (!face && nface) )
+  {
+    hmesh_error ("hmesh_hedges_new () : aborted");
+    return HMESH_ERROR;
+  }
+  for (size_t f = 0; f < nface; ++f)
+    for (int s = 0; s < 3; ++s)
+      if (!hmesh_node_in_use (v, face[f][s]))
+      {
+        hmesh_error ("hmesh_hedges_new () : vertex %d of face %zu not in "
+          "use", s, f);
+        return HMESH_ERROR;
+      }
+
+  size_t n = 3 * nface;
+  Node * he = out ? out : malloc ((n ? n : 1) * sizeof (Node));
+  if ( !he || hmesh_nodes_new (e, n, he) != n )
+  {
+    if (he != out)
+      free (he);
+    hmesh_error ("hmesh_hedges_new () : cannot add %zu half edges", n);
+    return HMESH_ERROR;
+  }
+
+  Index ifrom = 2, ito = 3, inext = e->k + 3, itwin = e->k + 4;
+  for (size_t f = 0; f < nface; ++f)
+    for (int s = 0; s < 3; ++s)
+    {
+      Node x = he [3*f + s];
+      hmesh_cells_unshare (e, x.iblock);
+      ((Node *) HMESH_ATTR (e, ifrom, x.iblock)) [x.index] = face[f][s];
+      ((Node *) HMESH_ATTR (e, ito, x.iblock)) [x.index] =
+        face[f][(s + 1) % 3];
+      ((Node *) HMESH_ATTR (e, inext, x.iblock)) [x.index] =
+        he [3*f + (s + 1) % 3];
+      ((Node *) HMESH_ATTR (e, itwin, x.iblock)) [x.index] = HMESH_NODE_NULL;
+    }
+
+  /* half edges with an unset twin, by (sub.0, sub.1) */
+  size_t nopen = 0;
+  HMESH_FOREACH_NODE (e, x)
+    nopen += (HMESH_TWIN (e, x).index == HMESH_INDEX_NULL);
+  size_t size = 1;
+  while (size < 2 * nopen)
+    size <<= 1;
+  Node * table = malloc (size * sizeof (Node));
+  int status = table ? HMESH_NO_ERROR : HMESH_ERROR;
+  for (size_t i = 0; table && i < size; ++i)
+    table[i] = HMESH_NODE_NULL;
+
+  HMESH_FOREACH_NODE (e, x)
+  {
+    if (!table || HMESH_TWIN (e, x).index != HMESH_INDEX_NULL)
+      continue;
+    size_t i = hmesh_hedge_slot (e, x, 0, size - 1);
+    for (; table[i].index != HMESH_INDEX_NULL; i = (i + 1) & (size - 1))
+      if ( hmesh_node_same (HMESH_IVERTEX (e, table[i], 0),
+             HMESH_IVERTEX (e, x, 0)) &&
+           hmesh_node_same (HMESH_IVERTEX (e, table[i], 1),
+             HMESH_IVERTEX (e, x, 1)) )
+      {
+        hmesh_error ("hmesh_hedges_new () : half edge [%d:%d] repeated",
+          x.iblock, x.index);
+        status = HMESH_ERROR;
+        break;
+      }
+    table[i] = x;
+  }
+
+  /* twin of (a, b) is (b, a) */
+  for (size_t j = 0; !status && j < size; ++j)
+  {
+    Node x = table[j];
+    if ( x.index == HMESH_INDEX_NULL ||
+         HMESH_TWIN (e, x).index != HMESH_INDEX_NULL )
+      continue;
+    for (size_t i = hmesh_hedge_slot (e, x, 1, size - 1);
+         table[i].index != HMESH_INDEX_NULL; i = (i + 1) & (size - 1))
+      if ( hmesh_node_same (HMESH_IVERTEX (e, table[i], 0),
+             HMESH_IVERTEX (e, x, 1)) &&
+           hmesh_node_same (HMESH_IVERTEX (e, table[i], 1),
+             HMESH_IVERTEX (e, x, 0)) )
+      {
+        Node t = table[i];
+        ((Node *) HMESH_WRITE (e, itwin, x.iblock)) [x.index] = t;
+        ((Node *) HMESH_WRITE (e, itwin, t.iblock)) [t.index] = x;
+        break;
+      }
+  }
+
+  free (table);
+  if (he != out)
+    free (he);
+  if (status)
+    hmesh_error ("hmesh_hedges_new () : failed");
+  return status;
+}
+
+/*
+.. "hmesh_hedges_valid ()" : Verify the half edges 'h->e' of a triangulated
+.. surface. Returns 0 if valid, or the errors found (HmeshHedgeError)
+.. HMESH_HEDGE_UNSET : a vertex or 'next' is not a node in use
+.. HMESH_HEDGE_TWIN  : 'twin' of 'twin' is not the half edge, or the twins
+.. don't have the same vertices (reversed)
+.. HMESH_HEDGE_FACE  : face is not a triangle, or sub.1 is not sub.0 of
+.. 'next'
+.. HMESH_HEDGE_STAR  : a half edge of the star of a vertex (i.e. its half
+.. edges going out) has a different pivot. Verified only if the twins and
+.. the faces are valid (otherwise the star may not be a cycle).
+.. A boundary (unset twin) is valid.
+*/
+int hmesh_hedges_valid (Hmesh * h)
+{
+  HmeshCells * v = h ? h->p : NULL, * e = h ? h->e : NULL;
+  if (!e)
+  {
+    hmesh_error ("hmesh_hedges_valid () : aborted");
+    return HMESH_HEDGE_UNSET;
+  }
+
+  int error = HMESH_HEDGE_VALID;
+  HMESH_FOREACH_NODE (e, x)
+  {
+    Node a = HMESH_IVERTEX (e, x, 0), b = HMESH_IVERTEX (e, x, 1),
+      n = HMESH_NEXT (e, x), t = HMESH_TWIN (e, x);
+    if ( !hmesh_node_in_use (v, a) || !hmesh_node_in_use (v, b) ||
+         !hmesh_node_in_use (e, n) )
+    {
+      error |= HMESH_HEDGE_UNSET;
+      continue;
+    }
+    if (t.index != HMESH_INDEX_NULL)
+    {
+      if ( !hmesh_node_in_use (e, t) ||
+           !hmesh_node_same (HMESH_TWIN (e, t), x) ||
+           !hmesh_node_same (HMESH_IVERTEX (e, t, 0), b) ||
+           !hmesh_node_same (HMESH_IVERTEX (e, t, 1), a) )
+        error |= HMESH_HEDGE_TWIN;
+    }
+    /* 'next' of a half edge is verified, before the loop moves to it */
+    int nv = 0;
+    HMESH_FOREACH_FACE (e, x, f)
+    {
+      Node q = HMESH_NEXT (e, f);
+      if ( ++nv > 3 || !hmesh_node_in_use (e, q) ||
+           !hmesh_node_same (HMESH_IVERTEX (e, f, 1),
+             HMESH_IVERTEX (e, q, 0)) )
+      {
+        nv = 0;
+        break;
+      }
+    }
+    if (nv != 3)
+      error |= HMESH_HEDGE_FACE;
+  }
+  if (error)
+    return error;
+
+  HMESH_FOREACH_NODE (e, x)
+  {
+    Node a = HMESH_IVERTEX (e, x, 0);
+    HMESH_FOREACH_STAR (e, x, s)
+      if (!hmesh_node_same (HMESH_IVERTEX (e, s, 0), a))
+      {
+        error |= HMESH_HEDGE_STAR;
+        break;
+      }
+  }
+  return error;
+}
+
 /* API to create, and free a mesh */
 int hmesh_destroy (Hmesh * h)
 {
@@ -510,7 +2113,7 @@ Hmesh * hmesh (int K, int D)
 {
   if ( (K > D) || (D > 3) || (!D) )
   {
-    hmesh_error ("hmesh () :  Incompatible dim. K%d, D%D", K, D);
+    hmesh_error ("hmesh () :  Incompatible dim. K%d, D%d", K, D);
     return NULL;
   }
   if (K == 3)
@@ -531,7 +2134,7 @@ Hmesh * hmesh (int K, int D)
     *c[k] = NULL;
 
   /* create cells of points, edges, etc .. */
-  for (int k = 0; k <= d; ++k)
+  for (int k = 0; k <= K; ++k)
   {
     HmeshCells * cells = hmesh_cells (k, K, D);
     if (!cells)
@@ -545,3 +2148,45 @@ Hmesh * hmesh (int K, int D)
 
   return h;
 }
+
+/*
+.. "hmesh_snapshot ()" : copy-on-write snapshot of all the cells of the
+.. mesh (hmesh_cells_snapshot ()). It's a rollback point : to undo the
+.. changes of 'h' since the snapshot, destroy 'h' and continue with a
+.. snapshot of the snapshot (so that it can be rolled back again).
+.. Ex: Hmesh * save = hmesh_snapshot (h);
+..     hmesh_remesh (..);
+..     if (quality < threshold) {
+..       hmesh_destroy (h);
+..       h = hmesh_snapshot (save);
+..     }
+..     hmesh_destroy (save);
+*/
+Hmesh * hmesh_snapshot (Hmesh * h)
+{
+  if (!h)
+  {
+    hmesh_error ("hmesh_snapshot () : NULL");
+    return NULL;
+  }
+
+  Hmesh * snap = malloc (sizeof (Hmesh));
+  if (!snap)
+  {
+    hmesh_error ("hmesh_snapshot () : malloc failed");
+    return NULL;
+  }
+  *snap = *h;
+  HmeshCells ** c[4] = { &h->p, &h->e, &h->t, &h->v },
+    ** s[4] = { &snap->p, &snap->e, &snap->t, &snap->v };
+  for (int k = 0; k < 4; ++k)
+    *s[k] = NULL;
+  for (int k = 0; k < 4; ++k)
+    if (*c[k] && !(*s[k] = hmesh_cells_snapshot (*c[k])))
+    {
+      hmesh_error ("hmesh_snapshot () : failed");
+      hmesh_destroy (snap);
+      return NULL;
+    }
+  return snap;
+}
@@ -14,25 +14,62 @@
 #include <sys/mman.h>
 #include <string.h>
 #include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
 
 /*
 .. Use the hmesh_tallocate () function to allocate memory chunksi of size of
 .. { 8 x PAGE_SIZE, 4 x PAGE_SIZE, 2 x PAGE_SIZE, 1 x PAGE_SIZE }
 */
 
+/*
+.. Maximum number of trees. With 17 bits available for 'itree' in the (32
+.. bit) block index, the limit is rather set by the size of the table of
+.. trees. 8192 trees of 8MB can pool upto 64GB.
+*/
+#ifndef HMESH_TREE_POOL_MAX_TREES
+#define HMESH_TREE_POOL_MAX_TREES 8192
+#endif
+
 /*
 .. "HmeshTpool" : collection of tree pools
-.. 'trees' : collection of pools
-.. 'ntree's : number of trees in use
+.. 'trees' : collection of pools. It's a fixed array (and not realloc'ed), so
+.. that hmesh_tpool_address () can be called without a lock.
+.. 'ntree's : number of trees in use. Trees in [0, ntrees) that are
+.. trimmed (returned to OS) have 'root' = NULL, and their slot is reused.
 .. 'free_list' : Free blocks of each level
+.. 'fresh' : tree with root chunks that are not yet committed (-1, if none)
+.. 'empty' : bytes mapped by the trees with no block in use
+.. 'keep'  : high-water mark of 'empty'. Beyond this, empty trees are
+.. trimmed automatically.
+.. 'stats' : counters of hmesh_tpool_stats (). 'used', 'free' and
+.. 'fragmentation' are evaluated only when asked.
 */
 typedef struct
 {
-  HmeshTpool * trees;
+  HmeshTpool trees [HMESH_TREE_POOL_MAX_TREES];
   int ntrees;
   FreeTBlock * free_list [HMESH_TREE_POOL_DEPTH + 1];
+  int fresh;
+  size_t empty, keep;
+  HmeshTpoolStats stats;
 } HmeshTpools;
 
+/*
+.. "TpoolCache" : free blocks cached by a thread in the concurrent mode.
+.. 'n[depth]' : number of cached blocks of depth 'depth'
+.. 'block[depth]' : cached blocks. From the tree's point of view, these
+.. blocks are in use.
+*/
+typedef struct
+{
+  int   n     [HMESH_TREE_POOL_DEPTH + 1];
+  BlockID block [HMESH_TREE_POOL_DEPTH + 1][HMESH_TPOOL_CACHE_SIZE];
+} TpoolCache;
+
 /*
 .. For the moment, let's fix the BLOCK_SIZE = no: of nodes per block to 4096.
 .. So the size of chunks fall in 4096 * \{ 1, 2, 4, 8\}, guaranteeing the
@@ -40,15 +77,46 @@ typedef struct
 .. 8MB of chunk (by default).
 */
 #define HMESH_TREE_POOL_SIZE 1<<23
-static  HmeshTpools HMESH_TREE_POOLS = {0};
+static  HmeshTpools HMESH_TREE_POOLS =
+  { .fresh = -1, .keep = HMESH_TREE_POOL_SIZE };
 const   size_t HMESH_TREE_POOL_NODES = (1 << (HMESH_TREE_POOL_DEPTH+1)) - 1;
 const   size_t HMESH_TREE_BLOCK_SIZE = HMESH_PAGE_SIZE;
 
+/*
+.. Concurrent mode. 'HMESH_TPOOL_LOCK' guards the free lists and the flags of
+.. all the trees. 'HMESH_TPOOL_KEY' is used only to flush the cache of a
+.. thread, when it exits.
+*/
+static int             HMESH_TPOOL_CONCURRENT = 0;
+static pthread_mutex_t HMESH_TPOOL_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t  HMESH_TPOOL_ONCE = PTHREAD_ONCE_INIT;
+static pthread_key_t   HMESH_TPOOL_KEY;
+static __thread TpoolCache * HMESH_TPOOL_TCACHE = NULL;
+
+/*
+.. Backing requested for the trees created hereafter (hmesh_tpool_backing ())
+.. 'HMESH_TPOOL_MODE' : HMESH_TPOOL_PAGES or a combination of
+.. HMESH_TPOOL_HUGETLB, HMESH_TPOOL_THP and HMESH_TPOOL_NUMA
+.. 'HMESH_TPOOL_NODE' : NUMA node, in case of HMESH_TPOOL_NUMA
+*/
+static int HMESH_TPOOL_MODE = HMESH_TPOOL_PAGES;
+static int HMESH_TPOOL_NODE = 0;
+
+/*
+.. Size of a huge page. Used to align the arenas for THP
+*/
+#define HMESH_HUGE_PAGE_SIZE (1<<21)
+
 size_t hmesh_tpool_block_size ()
 {
   return HMESH_TREE_BLOCK_SIZE;
 }
 
+int hmesh_tpool_depth ()
+{
+  return HMESH_TREE_POOL_DEPTH;
+}
+
 HmeshTpool * hmesh_tpool_tree (int itree)
 {
   return itree < HMESH_TREE_POOLS.ntrees ?
@@ -56,9 +124,9 @@ HmeshTpool * hmesh_tpool_tree (int itree)
 }
 
 static inline
-void * hmesh_tpool_address_is (void * start, Index inode, int depth)
+void * hmesh_tpool_address_is (void * start, BlockID inode, int depth)
 {
-  Index
+  BlockID
     h     = 1 << depth,
     H     = 1 << HMESH_TREE_POOL_DEPTH,
     D     = 1 << (HMESH_TREE_POOL_DEPTH - depth),
@@ -68,28 +136,40 @@ void * hmesh_tpool_address_is (void * start, Index inode, int depth)
     (iroot*H + (index - h + 1)*D) * HMESH_TREE_BLOCK_SIZE);
 }
 
-void * hmesh_tpool_address (Index blockID)
+/*
+.. Decoding the address is in the hot path. The depth of the block is
+.. encoded in the block ID, so the flags of the tree are not read. 'inode' is
+.. in bound by construction (masked), so there are two branches to check
+.. 'itree' (it also rejects HMESH_TPOOL_NULL, as its 'itree' is out of
+.. limit), and the root of the tree (NULL, once trimmed).
+*/
+void * hmesh_tpool_address (BlockID blockID)
 {
-  Index
-    itree = blockID >> 13,
-    inode = blockID & 8191;
+  BlockID
+    itree = blockID >> HMESH_TPOOL_TREE_SHIFT,
+    inode = blockID & HMESH_TPOOL_NODE_MASK,
+    depth = (blockID >> HMESH_TPOOL_NODE_BITS) & 7;
 
-  if ( ! (itree < HMESH_TREE_POOLS.ntrees && inode < 4096) )
+  BlockID ntrees = __atomic_load_n (&HMESH_TREE_POOLS.ntrees,
+    __ATOMIC_ACQUIRE);
+  if (itree >= ntrees)
+    return NULL;
+  void * root = HMESH_TREE_POOLS.trees[itree].root;
+  if (!root)
     return NULL;
 
-  return hmesh_tpool_address_is (HMESH_TREE_POOLS.trees[itree].root,
-    inode, HMESH_TREE_POOLS.trees[itree].flags[inode] & 7);
+  return hmesh_tpool_address_is (root, inode, depth);
 }
 
 static inline
-Index hmesh_tpool_parent (Index inode)
+BlockID hmesh_tpool_parent (BlockID inode)
 {
   return ( ( (inode & HMESH_TREE_POOL_NODES) - 1) >> 1) |
     (inode & ~HMESH_TREE_POOL_NODES);
 }
 
 static inline
-Index hmesh_tpool_child (Index inode, Index ichild)
+BlockID hmesh_tpool_child (BlockID inode, BlockID ichild)
 {
   /*assert (ichild <2)*/
   return (inode & ~HMESH_TREE_POOL_NODES) |
@@ -106,6 +186,7 @@ void hmesh_tpool_pop (FreeTBlock * fb, int depth)
     HMESH_TREE_POOLS.free_list [depth] = fb->next;
   if ( fb->next )
     fb->next->prev = fb->prev;
+  HMESH_TREE_POOLS.stats.nfree [depth]--;
 }
 
 static inline
@@ -117,23 +198,24 @@ void hmesh_tpool_push (FreeTBlock * fb, int depth)
     fb->next->prev = fb;
   /* add the free block at the free list head*/
   HMESH_TREE_POOLS.free_list[depth] = fb;
+  HMESH_TREE_POOLS.stats.nfree [depth]++;
 }
 
 static
-Index  hmesh_tpool_divide (FreeTBlock * _fb, int level, int depth)
+BlockID  hmesh_tpool_divide (FreeTBlock * _fb, int level, int depth)
 {
   /* Divide a freeblock till 'depth' */
   hmesh_tpool_pop (_fb, level);
 
-  Index
+  BlockID
     blockID = _fb->blockID,
-    inode = blockID & 8191,
-    itree = blockID >> 13;
+    inode = blockID & HMESH_TPOOL_NODE_MASK,
+    itree = blockID >> HMESH_TPOOL_TREE_SHIFT;
 
-  if (itree >= HMESH_TREE_POOLS.ntrees || inode >= 4096)
+  if (itree >= (BlockID) HMESH_TREE_POOLS.ntrees)
   {
     hmesh_error ("hmesh_tpool_deallocate () : out of bound");
-    return UINT16_MAX;
+    return HMESH_TPOOL_NULL;
   }
 
   HmeshTpool * tree = & HMESH_TREE_POOLS.trees [itree];
@@ -143,7 +225,7 @@ Index  hmesh_tpool_divide (FreeTBlock * _fb, int level, int depth)
     /*
     .. Keep on dividing the chunk till the size is of desirable size
     */
-    Index
+    BlockID
       left  = hmesh_tpool_child (inode, 0),
       right = hmesh_tpool_child (inode, 1);
 
@@ -152,30 +234,78 @@ Index  hmesh_tpool_divide (FreeTBlock * _fb, int level, int depth)
 
     FreeTBlock * fb = (FreeTBlock *)
       hmesh_tpool_address_is (tree->root, right, level);
-    *fb = (FreeTBlock) { .blockID = right | (itree << 13) };
+    *fb = (FreeTBlock)
+      { .blockID = right | (itree << HMESH_TPOOL_TREE_SHIFT) };
     /* pushing right half as a free block @ free list head*/
     hmesh_tpool_push (fb, level);
 
     flags[inode] = (level - 1) | 64;  /* inode is divided and no more a leaf */
+    HMESH_TREE_POOLS.stats.nsplit++;
 
     inode = left;                                        /* Go to left child */
   }
 
   flags[inode] = depth;
-  return inode | (itree << 13);
+  if (!(tree->nused++))
+    HMESH_TREE_POOLS.empty -= tree->size;
+  HMESH_TREE_POOLS.stats.nused [depth]++;
+  HMESH_TREE_POOLS.stats.nalloc++;
+  return inode | (depth << HMESH_TPOOL_NODE_BITS) |
+    (itree << HMESH_TPOOL_TREE_SHIFT);
+}
+
+/*
+.. "hmesh_tpool_unmap ()" : return an empty tree 'itree' to OS. All its free
+.. blocks are unlinked from the free lists, before munmap ().
+*/
+static
+size_t hmesh_tpool_unmap (BlockID itree)
+{
+  HmeshTpool * tree = & HMESH_TREE_POOLS.trees [itree];
+  assert (tree->root && !tree->nused);
+
+  /* only the committed root chunks may have free blocks */
+  size_t nnodes = tree->next << (HMESH_TREE_POOL_DEPTH + 1);
+  uint8_t * flags = tree->flags;
+  for (BlockID inode = 0; inode < nnodes; ++inode)
+  {
+    if ( !(flags[inode] & 128) )
+      continue;
+    int depth = flags[inode] & 7;
+    hmesh_tpool_pop ( (FreeTBlock *)
+      hmesh_tpool_address_is (tree->root, inode, depth), depth );
+  }
+
+  size_t size = tree->size;
+  if (munmap (tree->root, size))
+    hmesh_error ("hmesh_tpool_unmap () : munmap () failed");
+  free (tree->flags);
+  free (tree->share);
+  HMESH_TREE_POOLS.empty -= size;
+  HMESH_TREE_POOLS.stats.ntrees--;
+  HMESH_TREE_POOLS.stats.mapped -= size;
+  if (HMESH_TREE_POOLS.fresh == (int) itree)
+    HMESH_TREE_POOLS.fresh = -1;
+  *tree = (HmeshTpool) { .root = NULL, .flags = NULL, .share = NULL,
+    .size = 0, .node = -1 };
+
+  return size;
 }
 
 /* assumes max depth < 8 */
-int hmesh_tpool_deallocate (Index blockID)
+static
+int hmesh_tpool_release (BlockID blockID)
 {
 
   /*
-  .. last 13 bits are reserved to store node index,
-  .. and the rest are used to store tree no (itree)
+  .. last HMESH_TPOOL_NODE_BITS bits are reserved to store node index, the
+  .. next 3 bits store the depth and the rest are used to store tree no (itree)
   */
-  Index itree = blockID >> 13, inode = blockID & 8191;
+  BlockID
+    itree = blockID >> HMESH_TPOOL_TREE_SHIFT,
+    inode = blockID & HMESH_TPOOL_NODE_MASK;
 
-  if (itree >= HMESH_TREE_POOLS.ntrees || inode >= 4096)
+  if (itree >= (BlockID) HMESH_TREE_POOLS.ntrees)
   {
     hmesh_error ("hmesh_tpool_deallocate () : out of bound");
     return HMESH_ERROR;
@@ -190,42 +320,149 @@ int hmesh_tpool_deallocate (Index blockID)
   uint8_t * flags = tree->flags,
     depth = flags [inode] & 7;
 
-  if ( flags[inode] & (128|64) )
+  if ( (flags[inode] & (128|64)) ||
+       (depth != ((blockID >> HMESH_TPOOL_NODE_BITS) & 7)) )
   {
     hmesh_error ("hmesh_tpool_deallocate () : "
       "tree pool node cannot be deallocated");
     return HMESH_ERROR;
   }
 
+  HMESH_TREE_POOLS.stats.nused [depth]--;
+  HMESH_TREE_POOLS.stats.ndealloc++;
+
   /*
   .. While deallocating a block coalesce with 'buddy'/'sibling' if possible
   */
   do
   {
-    Index sibling = inode + ((inode & 1) ? 1 : -1);
-    if ( (128 & flags[sibling]) && depth )
+    BlockID sibling = inode + ((inode & 1) ? 1 : -1);
+    if ( depth && (128 & flags[sibling]) )
     {
       flags [sibling] = flags[inode] = (depth | 64);
       FreeTBlock * fb = (FreeTBlock *)
         hmesh_tpool_address_is ( tree->root, sibling, depth);
-      assert ((fb->blockID & 8191) == sibling);
+      assert ((fb->blockID & HMESH_TPOOL_NODE_MASK) == sibling);
       hmesh_tpool_pop (fb, depth);
       inode = hmesh_tpool_parent (inode);
+      HMESH_TREE_POOLS.stats.ncoalesce++;
     }
     else
     {
-      flags[inode] |= 128;
+      /* a free leaf (a coalesced parent is no more marked as 'not leaf') */
+      flags[inode] = depth | 128;
       FreeTBlock * fb = (FreeTBlock *)
         hmesh_tpool_address_is ( tree->root, inode, depth);
-      *fb = (FreeTBlock) { .blockID = inode | (itree << 13) };
+      *fb = (FreeTBlock)
+        { .blockID = inode | (itree << HMESH_TPOOL_TREE_SHIFT) };
       hmesh_tpool_push (fb, depth);
       break;
     }
   } while (depth--);
 
+  /*
+  .. In case the tree is empty, and there are more empty trees than the
+  .. high-water mark, return the tree to OS.
+  */
+  if (!(--(tree->nused)))
+  {
+    HMESH_TREE_POOLS.empty += tree->size;
+    if (HMESH_TREE_POOLS.empty > HMESH_TREE_POOLS.keep)
+      hmesh_tpool_unmap (itree);
+  }
+
   return HMESH_NO_ERROR;
 }
 
+/*
+.. "hmesh_tpool_mbind ()" : bind [mem, mem + size) to the NUMA node 'node'
+.. using mbind () syscall (no dependency on libnuma). 'move' : migrate the
+.. pages that are already touched. Returns 0 if successful.
+*/
+static
+int hmesh_tpool_mbind (void * mem, size_t size, int node, int move)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+  if (node < 0 || node >= (int) (8 * sizeof (unsigned long)))
+    return HMESH_ERROR;
+  /*
+  .. MPOL_BIND = 2, MPOL_MF_MOVE = 2 (from <numaif.h>). 'maxnode' is one more
+  .. than the number of bits in the mask, as the kernel discards the last bit
+  */
+  unsigned long mask = 1UL << node;
+  long status = syscall (SYS_mbind, mem, size, 2, &mask,
+    8 * sizeof (unsigned long) + 1, move ? 2 : 0);
+  return status ? HMESH_ERROR : HMESH_NO_ERROR;
+#else
+  (void) mem; (void) size; (void) node; (void) move;
+  return HMESH_ERROR_NI;
+#endif
+}
+
+/*
+.. "hmesh_tpool_map ()" : mmap () an arena of 'size' bytes, honouring the
+.. requested backing (HMESH_TPOOL_MODE), as far as possible. Falls back to
+.. 4KB pages. '*backing' is set to the backing obtained.
+*/
+static
+void * hmesh_tpool_map (size_t size, int * backing)
+{
+  int mode = HMESH_TPOOL_MODE, prot = PROT_READ | PROT_WRITE,
+    flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void * mem = MAP_FAILED;
+  *backing = HMESH_TPOOL_PAGES;
+
+#ifdef MAP_HUGETLB
+  /*
+  .. Explicit huge pages. Fails, unless huge pages are reserved
+  .. (/proc/sys/vm/nr_hugepages) and 'size' is a multiple of huge page size
+  */
+  if (mode & HMESH_TPOOL_HUGETLB)
+  {
+    mem = mmap (NULL, size, prot, flags | MAP_HUGETLB, -1, 0);
+    if (mem != MAP_FAILED)
+      *backing |= HMESH_TPOOL_HUGETLB;
+  }
+#endif
+
+#ifdef MADV_HUGEPAGE
+  /*
+  .. Transparent huge pages. The arena is aligned to the huge page size, by
+  .. mapping an extra huge page and trimming both the ends.
+  */
+  if (mem == MAP_FAILED && (mode & HMESH_TPOOL_THP) &&
+      !(size % HMESH_HUGE_PAGE_SIZE))
+  {
+    size_t align = HMESH_HUGE_PAGE_SIZE;
+    char * m = mmap (NULL, size + align, prot, flags, -1, 0);
+    if (m != MAP_FAILED)
+    {
+      size_t head = (align - ((uintptr_t) m % align)) % align;
+      if (head)
+        munmap (m, head);
+      munmap (m + head + size, align - head);
+      mem = m + head;
+      if (!madvise (mem, size, MADV_HUGEPAGE))
+        *backing |= HMESH_TPOOL_THP;
+    }
+  }
+#endif
+
+  if (mem == MAP_FAILED)
+    mem = mmap (NULL, size, prot, flags, -1, 0);
+  if (mem == MAP_FAILED)
+    return NULL;
+
+  /*
+  .. Bind before the pages are touched, so that no page migration is needed
+  */
+  if ( (mode & HMESH_TPOOL_NUMA) &&
+       !hmesh_tpool_mbind (mem, size, HMESH_TPOOL_NODE, 0) )
+    *backing |= HMESH_TPOOL_NUMA;
+
+  return mem;
+}
+
 /*
 .. Creating a memory block using mmap (). This function will be called when you
 .. ask to allocate the first time, or you run out of the current block
@@ -233,17 +470,23 @@ int hmesh_tpool_deallocate (Index blockID)
 static
 void * hmesh_tpool_add ()
 {
-  if (HMESH_TREE_POOLS.ntrees == 8)
+  /*
+  .. Reuse the slot of a trimmed tree (if any)
+  */
+  int itree = 0;
+  HmeshTpools * pool = & HMESH_TREE_POOLS;
+  while (itree < pool->ntrees && pool->trees[itree].root)
+    ++itree;
+  if (itree == HMESH_TREE_POOL_MAX_TREES)
   {
-    hmesh_error ("hmesh_tpool_add () : Index insufficient for "
-      "block index. Rewrite using uin32_t");
+    hmesh_error ("hmesh_tpool_add () : reached the limit of "
+      "HMESH_TREE_POOL_MAX_TREES trees");
     return NULL;
   }
   /*
   .. Create a new tree pool and add it to the list of pool
   .. HMESH_TREE_POOLS.root[ntrees++] = mmap (..)
-  .. 1 X PAGE_SIZE is used to stored flagsrmation on tree_pool,
-  .. 2047 X PAGE_SIZE is free to use (if successful).
+  .. 2048 X PAGE_SIZE is free to use (if successful).
   */
 
   /* 'psize' : or pool size = 8MB
@@ -256,16 +499,13 @@ void * hmesh_tpool_add ()
     rsize = (1<<HMESH_TREE_POOL_DEPTH) * HMESH_TREE_BLOCK_SIZE,
     limit = 2 * rsize, maxnodes = 1 << (HMESH_TREE_POOL_DEPTH+1);
 
-  int itree = HMESH_TREE_POOLS.ntrees,
-    depth = HMESH_TREE_POOL_DEPTH;
-
   while (psize >= limit)
   {
     /* Trying to pool memory directly from OS rather than
     .. using malloc (). */
-    void * mem = mmap (NULL, psize, PROT_READ | PROT_WRITE,
-      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (mem == MAP_FAILED)
+    int backing;
+    void * mem = hmesh_tpool_map (psize, &backing);
+    if (!mem)
     {
       /*
       .. "hmesh_tpool_add () : Warning! mmap () failed for %zd bytes");
@@ -274,63 +514,54 @@ void * hmesh_tpool_add ()
       continue;
     }
 
+    /*
+    .. Flags of the nodes are stored separately (and not in the first page
+    .. of the pool), so that the whole pool is available for blocks
+    */
+    size_t nroots = psize / rsize;
+    uint8_t * flags = calloc (nroots * maxnodes, sizeof (uint8_t)),
+      * share = calloc (nroots * maxnodes, sizeof (uint8_t));
+    if (!flags || !share)
+    {
+      free (flags);
+      free (share);
+      munmap (mem, psize);
+      break;
+    }
+
     /* Created a pool of size 'psize'. */
-    HmeshTpools * pool = & HMESH_TREE_POOLS;
-    ++(pool->ntrees);
-    pool->trees = realloc
-        ( pool->trees, (pool->ntrees) * sizeof (HmeshTpool) );
     HmeshTpool * tree = pool->trees + itree;
     *tree = (HmeshTpool)
     {
-      .root  = mem,
-      .flags = (uint8_t *) mem,
-      .size  = psize
+      .root    = mem,
+      .flags   = flags,
+      .share   = share,
+      .size    = psize,
+      .next    = 0,
+      .backing = backing,
+      .node    = (backing & HMESH_TPOOL_NUMA) ? HMESH_TPOOL_NODE : -1
     };
-
-    /* Let's use a part of the pool [0, PAGE_SIZE)
-    .. to store the tree nodes flags*/
-
-    /* Update the flags on the nodes */
-    size_t rchunks = psize / rsize; assert (rchunks);
-    uint8_t * flags = tree->flags;
-    FreeTBlock _0b;
-    for (int j = rchunks - 1; j >= 0; --j)
-    {
-      Index inode = j * maxnodes;
-      /*
-      .. Adding chunk to free_list @ root (level = 0)
-      .. Encode level and the flag that node is not in use
-      .. _Flag NODE_IS_FREE = 128, NODE_IS_NOT_LEAF = 64;
-      */
-
-      FreeTBlock * fb = !j ? & _0b :
-        (FreeTBlock *) hmesh_tpool_address_is (mem, inode, 0);
-
-      *fb = (FreeTBlock) { .blockID = (itree << 13) | inode };
-      /* pushing @ free head of free_list[0]*/
-      hmesh_tpool_push (fb, 0);
-      flags [inode++] = 128;
-
-      int level = 1;
-      /*
-      .. children of root nodes are not yet developed and not free
-      */
-      do
-      {
-        for (Index i = 0; i< (1<<level); ++i)
-          flags[inode++] = level | 64;
-      } while (++level <= depth);
-      /* to round off [2^(N+1)-1] to [2^(N+1)] */
-      ++inode;
-      assert (inode % maxnodes == 0);
-    }
+    /*
+    .. 'ntrees' is read without lock by hmesh_tpool_address (). So the tree
+    .. is published only after it's set.
+    */
+    if (itree == pool->ntrees)
+      __atomic_store_n (&pool->ntrees, itree + 1, __ATOMIC_RELEASE);
 
     /*
-    .. Since we use only a (1/2)^N of the first rchunk, we need to divide it
-    .. N times successively, each time adding the right block to free_list
+    .. Root chunks are not touched here. They are committed one by one
+    .. (hmesh_tpool_commit ()) when there is no free block in free lists.
     */
-    Index flagsNode = hmesh_tpool_divide (&_0b, 0, depth);
-    assert ( flagsNode == ((itree << 13) | ((1<<depth) - 1)) );
+    pool->fresh = itree;
+
+    /* the new tree is empty */
+    pool->empty += psize;
+
+    HmeshTpoolStats * stats = & pool->stats;
+    stats->ntrees++;
+    stats->mapped += psize;
+    if (stats->mapped > stats->peak)
+      stats->peak = stats->mapped;
 
     return mem;
   }
@@ -340,40 +571,453 @@ void * hmesh_tpool_add ()
 }
 
 /*
-.. fixme : make this an internal routine.
+.. "hmesh_tpool_commit ()" : commit the next untouched root chunk of the
+.. tree 'fresh' (a new tree is created, if there is none). The flags of the
+.. nodes of the root chunk are set, and the root is pushed to free_list[0].
+.. Only the first page of the chunk is touched (to write the free block).
+*/
+static
+FreeTBlock * hmesh_tpool_commit ()
+{
+  HmeshTpools * pool = & HMESH_TREE_POOLS;
+  size_t rsize = (1<<HMESH_TREE_POOL_DEPTH) * HMESH_TREE_BLOCK_SIZE,
+    maxnodes = 1 << (HMESH_TREE_POOL_DEPTH+1);
+
+  if (pool->fresh < 0)
+    if (!hmesh_tpool_add ())
+      return NULL;
+
+  BlockID itree = pool->fresh;
+  HmeshTpool * tree = & pool->trees [itree];
+  BlockID inode = (tree->next++) * maxnodes;
+  if (tree->next == tree->size / rsize)
+    /* all root chunks of the tree are committed */
+    pool->fresh = -1;
+
+  /*
+  .. Encode level and the flag that node is not in use
+  .. _Flag NODE_IS_FREE = 128, NODE_IS_NOT_LEAF = 64;
+  .. children of root nodes are not yet developed and not free
+  */
+  uint8_t * flags = tree->flags + inode;
+  *flags++ = 128;
+  for (int level = 1; level <= HMESH_TREE_POOL_DEPTH; ++level)
+    for (int i = 0; i < (1<<level); ++i)
+      *flags++ = level | 64;
+
+  FreeTBlock * fb = (FreeTBlock *)
+    hmesh_tpool_address_is (tree->root, inode, 0);
+  *fb = (FreeTBlock) { .blockID = (itree << HMESH_TPOOL_TREE_SHIFT) | inode };
+  /* pushing @ free head of free_list[0]*/
+  hmesh_tpool_push (fb, 0);
+
+  return fb;
+}
+
+/*
+.. "hmesh_tpool_take ()" : take a block of depth 'depth' from the free lists
+.. of the tree. In the concurrent mode, expected to be called with the lock.
+*/
+static
+BlockID hmesh_tpool_take (int depth)
+{
+  /* Cannot find free block @ this level; try larger chunks */
+  /* In case level < depth, divide till depth */
+  int level = depth;
+  do
+  {
+    FreeTBlock * fb = HMESH_TREE_POOLS.free_list [level];
+    if (fb)
+      return hmesh_tpool_divide (fb, level, depth);
+  } while (level--);
+
+  /*
+  .. In case there is no free blocks @ all levels, commit an untouched root
+  .. chunk (or create a new pool)
+  */
+  FreeTBlock * fb = hmesh_tpool_commit ();
+  if (fb)
+    return hmesh_tpool_divide (fb, 0, depth);
+
+  hmesh_error ("hmesh_tpool_allocate () : no availability");
+  return HMESH_TPOOL_NULL;
+}
+
+/*
+.. Return all the cached blocks of 'cache' to the tree.
+.. In the concurrent mode, expected to be called with the lock.
+*/
+static
+void hmesh_tpool_drain (TpoolCache * cache)
+{
+  for (int depth = 0; depth <= HMESH_TREE_POOL_DEPTH; ++depth)
+    while (cache->n[depth])
+      hmesh_tpool_release (cache->block[depth][--(cache->n[depth])]);
+}
+
+/*
+.. Destructor of the thread cache. Called when a thread exits
+*/
+static
+void hmesh_tpool_cache_free (void * c)
+{
+  TpoolCache * cache = (TpoolCache *) c;
+  pthread_mutex_lock (&HMESH_TPOOL_LOCK);
+  hmesh_tpool_drain (cache);
+  pthread_mutex_unlock (&HMESH_TPOOL_LOCK);
+  free (cache);
+}
+
+static
+void hmesh_tpool_key ()
+{
+  pthread_key_create (&HMESH_TPOOL_KEY, hmesh_tpool_cache_free);
+}
+
+/*
+.. Cache of the calling thread. Created at the first call
+*/
+static inline
+TpoolCache * hmesh_tpool_cache ()
+{
+  TpoolCache * cache = HMESH_TPOOL_TCACHE;
+  if (cache)
+    return cache;
+  cache = calloc (1, sizeof (TpoolCache));
+  if (!cache)
+    return NULL;
+  pthread_once (&HMESH_TPOOL_ONCE, hmesh_tpool_key);
+  pthread_setspecific (HMESH_TPOOL_KEY, cache);
+  return HMESH_TPOOL_TCACHE = cache;
+}
+
+/*
+.. "hmesh_tpool_allocate ()" : allocate a block of depth 'depth'. In the
+.. concurrent mode, the block is popped from the cache of the thread. An empty
+.. cache is refilled with HMESH_TPOOL_CACHE_SIZE/2 blocks, with a single lock.
 */
-Index hmesh_tpool_allocate (int depth)
+BlockID hmesh_tpool_allocate (int depth)
 {
-  if (depth > HMESH_TREE_POOL_DEPTH)
+  if (depth > HMESH_TREE_POOL_DEPTH || depth < 0)
   {
     hmesh_error ("hmesh_tpool_allocate () : depth out of bound");
-    return UINT16_MAX;
+    return HMESH_TPOOL_NULL;
   }
 
-  int twice = 2;
-      /* Cannot find free block @ this level; try larger chunks */
-      /* In case level < depth, divide till depth
-    .. In case there is no free blocks @ all levels, create a new pool
-    */
-  while (twice--)
+  if (!HMESH_TPOOL_CONCURRENT)
+    return hmesh_tpool_take (depth);
+
+  TpoolCache * cache = hmesh_tpool_cache ();
+  if (!cache)
+  {
+    hmesh_error ("hmesh_tpool_allocate () : cannot create thread cache");
+    return HMESH_TPOOL_NULL;
+  }
+
+  int * n = &cache->n[depth];
+  BlockID * block = cache->block[depth];
+  if (!*n)
   {
-    int level = depth;
-    do
+    pthread_mutex_lock (&HMESH_TPOOL_LOCK);
+    while (*n < HMESH_TPOOL_CACHE_SIZE/2)
     {
-      FreeTBlock * fb = HMESH_TREE_POOLS.free_list [level];
-      if (!fb) continue;
-      return hmesh_tpool_divide (fb, level, depth);
-    } while (level--);
+      BlockID blockID = hmesh_tpool_take (depth);
+      if (blockID == HMESH_TPOOL_NULL)
+        break;
+      block[(*n)++] = blockID;
+    }
+    pthread_mutex_unlock (&HMESH_TPOOL_LOCK);
+    if (!*n)
+      return HMESH_TPOOL_NULL;
+  }
+
+  return block[--(*n)];
+}
+
+/*
+.. Share count of a block in use, or NULL if 'blockID' is out of bound.
+.. The count is not guarded by the lock, but modified atomically, as the
+.. owners of a shared block may be in different threads.
+*/
+static inline
+uint8_t * hmesh_tpool_share_count (BlockID blockID)
+{
+  BlockID
+    itree = blockID >> HMESH_TPOOL_TREE_SHIFT,
+    inode = blockID & HMESH_TPOOL_NODE_MASK;
+  BlockID ntrees = __atomic_load_n (&HMESH_TREE_POOLS.ntrees,
+    __ATOMIC_ACQUIRE);
+  if (itree >= ntrees || !HMESH_TREE_POOLS.trees [itree].share)
+    return NULL;
+  return &HMESH_TREE_POOLS.trees [itree].share [inode];
+}
 
-    if (twice)
+/*
+.. Drop an extra owner of 'blockID'. Returns 1 if there was one (so that
+.. the block is still in use by the other owners), 0 otherwise.
+*/
+static inline
+int hmesh_tpool_unshare (BlockID blockID)
+{
+  uint8_t * count = hmesh_tpool_share_count (blockID);
+  if (!count)
+    return 0;
+  uint8_t c = __atomic_load_n (count, __ATOMIC_ACQUIRE);
+  while (c)
+    if (__atomic_compare_exchange_n (count, &c, c - 1, 0, __ATOMIC_ACQ_REL,
+          __ATOMIC_ACQUIRE))
+      return 1;
+  return 0;
+}
+
+/*
+.. "hmesh_tpool_share ()" : add an owner to the block 'blockID' (in use).
+.. Each owner calls hmesh_tpool_deallocate () once, and the block is
+.. returned to the pool by the last one. At most 255 extra owners.
+*/
+int hmesh_tpool_share (BlockID blockID)
+{
+  uint8_t * count = hmesh_tpool_share_count (blockID);
+  if (!count ||
+      (HMESH_TREE_POOLS.trees [blockID >> HMESH_TPOOL_TREE_SHIFT].flags
+         [blockID & HMESH_TPOOL_NODE_MASK] & (128|64)))
+  {
+    hmesh_error ("hmesh_tpool_share () : block not in use");
+    return HMESH_ERROR;
+  }
+  uint8_t c = __atomic_load_n (count, __ATOMIC_ACQUIRE);
+  do
+    if (c == UINT8_MAX)
     {
-      void * mem = hmesh_tpool_add ();
-      if (!mem) break;
+      hmesh_error ("hmesh_tpool_share () : too many owners");
+      return HMESH_ERROR;
     }
+  while (!__atomic_compare_exchange_n (count, &c, c + 1, 0,
+           __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  return HMESH_NO_ERROR;
+}
+
+/*
+.. "hmesh_tpool_shared ()" : number of extra owners of 'blockID'. A block
+.. with no extra owner (0) can be written in place by its owner.
+*/
+int hmesh_tpool_shared (BlockID blockID)
+{
+  uint8_t * count = hmesh_tpool_share_count (blockID);
+  return count ? __atomic_load_n (count, __ATOMIC_ACQUIRE) : 0;
+}
+
+/*
+.. "hmesh_tpool_deallocate ()" : return the block 'blockID' to the pool. In
+.. the concurrent mode, the block is pushed to the cache of the thread. A full
+.. cache is drained to HMESH_TPOOL_CACHE_SIZE/2 blocks, with a single lock.
+.. A shared block (hmesh_tpool_share ()) loses an owner instead.
+*/
+int hmesh_tpool_deallocate (BlockID blockID)
+{
+  if (hmesh_tpool_unshare (blockID))
+    return HMESH_NO_ERROR;
+
+  if (!HMESH_TPOOL_CONCURRENT)
+    return hmesh_tpool_release (blockID);
+
+  BlockID
+    itree = blockID >> HMESH_TPOOL_TREE_SHIFT,
+    inode = blockID & HMESH_TPOOL_NODE_MASK;
+  BlockID ntrees = __atomic_load_n (&HMESH_TREE_POOLS.ntrees,
+    __ATOMIC_ACQUIRE);
+  if (itree >= ntrees)
+  {
+    hmesh_error ("hmesh_tpool_deallocate () : out of bound");
+    return HMESH_ERROR;
   }
 
-  hmesh_error ("hmesh_tpool_allocate () : no availability");
-  return UINT16_MAX;
+  /*
+  .. flags of a block in use are not modified by other threads, as long as
+  .. the block is owned by the calling thread.
+  */
+  uint8_t flag = HMESH_TREE_POOLS.trees [itree].flags [inode];
+  if ( (flag & (128|64)) ||
+       ((flag & 7) != ((blockID >> HMESH_TPOOL_NODE_BITS) & 7)) )
+  {
+    hmesh_error ("hmesh_tpool_deallocate () : "
+      "tree pool node cannot be deallocated");
+    return HMESH_ERROR;
+  }
+
+  TpoolCache * cache = hmesh_tpool_cache ();
+  if (!cache)
+  {
+    pthread_mutex_lock (&HMESH_TPOOL_LOCK);
+    int status = hmesh_tpool_release (blockID);
+    pthread_mutex_unlock (&HMESH_TPOOL_LOCK);
+    return status;
+  }
+
+  int depth = flag & 7;
+  if (cache->n[depth] == HMESH_TPOOL_CACHE_SIZE)
+  {
+    int * n = &cache->n[depth];
+    BlockID * block = cache->block[depth];
+    pthread_mutex_lock (&HMESH_TPOOL_LOCK);
+    while (*n > HMESH_TPOOL_CACHE_SIZE/2)
+      hmesh_tpool_release (block[--(*n)]);
+    pthread_mutex_unlock (&HMESH_TPOOL_LOCK);
+  }
+  cache->block[depth][cache->n[depth]++] = blockID;
+
+  return HMESH_NO_ERROR;
+}
+
+/*
+.. "hmesh_tpool_flush ()" : return all the blocks cached by the calling
+.. thread to the tree.
+*/
+void hmesh_tpool_flush ()
+{
+  TpoolCache * cache = HMESH_TPOOL_TCACHE;
+  if (!cache)
+    return;
+  pthread_mutex_lock (&HMESH_TPOOL_LOCK);
+  hmesh_tpool_drain (cache);
+  pthread_mutex_unlock (&HMESH_TPOOL_LOCK);
+}
+
+/*
+.. "hmesh_tpool_trim ()" : return all the empty trees to OS. The cache of
+.. the calling thread is flushed before. Returns the number of bytes unmapped.
+.. NOTE : blocks cached by other threads are in use, and hence a tree with
+.. such blocks is not trimmed.
+*/
+size_t hmesh_tpool_trim ()
+{
+  size_t size = 0;
+  if (HMESH_TPOOL_CONCURRENT)
+  {
+    hmesh_tpool_flush ();
+    pthread_mutex_lock (&HMESH_TPOOL_LOCK);
+  }
+  for (BlockID itree = 0; itree < (BlockID) HMESH_TREE_POOLS.ntrees; ++itree)
+  {
+    HmeshTpool * tree = & HMESH_TREE_POOLS.trees [itree];
+    if (tree->root && !tree->nused)
+      size += hmesh_tpool_unmap (itree);
+  }
+  if (HMESH_TPOOL_CONCURRENT)
+    pthread_mutex_unlock (&HMESH_TPOOL_LOCK);
+  return size;
+}
+
+/*
+.. "hmesh_tpool_trim_limit ()" : set the high-water mark of the bytes mapped
+.. by empty trees. Beyond this, a tree is returned to OS as soon as it's
+.. empty. By default, a single empty tree is kept mapped, to avoid repeated
+.. mmap ()/munmap (). Returns the previous limit.
+*/
+size_t hmesh_tpool_trim_limit (size_t bytes)
+{
+  size_t previous = HMESH_TREE_POOLS.keep;
+  HMESH_TREE_POOLS.keep = bytes;
+  return previous;
+}
+
+/*
+.. "hmesh_tpool_stats ()" : copy the statistics of the tree pool to 'stats'.
+.. It's cheap (a loop over the trees), and can be called in production runs
+.. to size HMESH_TREE_POOL_SIZE or to catch leaks (nalloc - ndealloc).
+*/
+int hmesh_tpool_stats (HmeshTpoolStats * stats)
+{
+  if (!stats)
+  {
+    hmesh_error ("hmesh_tpool_stats () : NULL");
+    return HMESH_ERROR;
+  }
+
+  if (HMESH_TPOOL_CONCURRENT)
+    pthread_mutex_lock (&HMESH_TPOOL_LOCK);
+
+  HmeshTpools * pool = & HMESH_TREE_POOLS;
+  *stats = pool->stats;
+
+  size_t rsize = (1<<HMESH_TREE_POOL_DEPTH) * HMESH_TREE_BLOCK_SIZE,
+    uncommitted = 0;
+  for (int itree = 0; itree < pool->ntrees; ++itree)
+  {
+    HmeshTpool * tree = & pool->trees [itree];
+    if (tree->root)
+      uncommitted += tree->size - tree->next * rsize;
+  }
+
+  stats->used = 0;
+  stats->free = uncommitted;
+  for (int depth = 0; depth <= HMESH_TREE_POOL_DEPTH; ++depth)
+  {
+    size_t bsize = rsize >> depth;
+    stats->used += stats->nused [depth] * bsize;
+    stats->free += stats->nfree [depth] * bsize;
+  }
+  /* free memory in root chunks (incl. uncommitted) is not fragmented */
+  size_t rfree = uncommitted + stats->nfree [0] * rsize;
+  stats->fragmentation = stats->free ?
+    1. - (double) rfree / stats->free : 0.;
+
+  if (HMESH_TPOOL_CONCURRENT)
+    pthread_mutex_unlock (&HMESH_TPOOL_LOCK);
+
+  return HMESH_NO_ERROR;
+}
+
+/*
+.. "hmesh_tpool_backing ()" : request the backing 'mode' for the trees
+.. created hereafter. 'node' is the NUMA node, used only with
+.. HMESH_TPOOL_NUMA. Returns the previously requested mode. The backing
+.. obtained for a tree is available in hmesh_tpool_tree (itree)->backing.
+*/
+int hmesh_tpool_backing (int mode, int node)
+{
+  int previous = HMESH_TPOOL_MODE;
+  HMESH_TPOOL_MODE = mode;
+  HMESH_TPOOL_NODE = node;
+  return previous;
+}
+
+/*
+.. "hmesh_tpool_bind ()" : bind an existing tree 'itree' to the NUMA node
+.. 'node'. Pages already touched are migrated.
+*/
+int hmesh_tpool_bind (int itree, int node)
+{
+  HmeshTpool * tree = hmesh_tpool_tree (itree);
+  if (!tree)
+  {
+    hmesh_error ("hmesh_tpool_bind () : tree %d not found", itree);
+    return HMESH_ERROR;
+  }
+  int status = hmesh_tpool_mbind (tree->root, tree->size, node, 1);
+  if (status)
+  {
+    hmesh_error ("hmesh_tpool_bind () : mbind () failed for node %d", node);
+    return status;
+  }
+  tree->backing |= HMESH_TPOOL_NUMA;
+  tree->node = node;
+  return HMESH_NO_ERROR;
+}
+
+/*
+.. "hmesh_tpool_concurrent ()" : switch on/off the concurrent mode. Expected
+.. to be called from a single thread, when no other thread is using the pool.
+.. Switching off flushes the cache of the calling thread only. Other threads
+.. should call hmesh_tpool_flush () (or exit) before that.
+*/
+int hmesh_tpool_concurrent (int enable)
+{
+  int previous = HMESH_TPOOL_CONCURRENT;
+  if (previous && !enable)
+    hmesh_tpool_flush ();
+  HMESH_TPOOL_CONCURRENT = enable ? 1 : 0;
+  return previous;
 }
 
 /* This is the API to allocate a memory block of size
@@ -381,7 +1025,7 @@ Index hmesh_tpool_allocate (int depth)
 .. NOTE : as of now obj_size in 1, 2, 4, 8 can be
 .. handled.
 */
-Index hmesh_tpool_allocate_general (size_t obj_size)
+BlockID hmesh_tpool_allocate_general (size_t obj_size)
 {
   size_t n = obj_size, r = 0;
   int level = 0;
@@ -397,13 +1041,13 @@ Index hmesh_tpool_allocate_general (size_t obj_size)
   {
     hmesh_error ("hmesh_tpool_allocate_general () : "
       "obj_size should be [1, 2, .., 2^HPOOL_DEPTH]");
-    return UINT16_MAX;
+    return HMESH_TPOOL_NULL;
   }
   --level;
   if ( level > HMESH_TREE_POOL_DEPTH )
   {
     hmesh_error ("hmesh_tpool_allocate_general () : out of bound");
-    return UINT16_MAX;
+    return HMESH_TPOOL_NULL;
   }
   return
     hmesh_tpool_allocate (HMESH_TREE_POOL_DEPTH - level);
@@ -412,7 +1056,7 @@ Index hmesh_tpool_allocate_general (size_t obj_size)
 /*
 .. Allocate a page of size 4096 bytes
 */
-Index hmesh_tpool_allocate_page ()
+BlockID hmesh_tpool_allocate_page ()
 {
   return hmesh_tpool_allocate (HMESH_TREE_POOL_DEPTH);
 }
@@ -429,7 +1073,24 @@ void hmesh_tpool_destroy ()
   while (itree--)
   {
     /* fixme: add error msg */
-    munmap (tree->root, tree->size);
+    if (tree->root)
+    {
+      munmap (tree->root, tree->size);
+      free (tree->flags);
+      free (tree->share);
+    }
     ++tree;
   }
+
+  /*
+  .. Blocks cached by the calling thread are no more valid. NOTE : caches
+  .. of other threads (if any) should have been flushed before.
+  */
+  TpoolCache * cache = HMESH_TPOOL_TCACHE;
+  if (cache)
+    memset (cache->n, 0, sizeof (cache->n));
+  size_t keep = HMESH_TREE_POOLS.keep;
+  memset (&HMESH_TREE_POOLS, 0, sizeof (HmeshTpools));
+  HMESH_TREE_POOLS.keep = keep;
+  HMESH_TREE_POOLS.fresh = -1;
 }
@@ -0,0 +1,221 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include "now.h"
+
+/*
+.. Typed attributes (hmesh_attr_new ()) : vertex normals of a triangulated
+.. N x N grid, with the position 'p' and the normal 'nrm' (vec3) stored as
+.. SoA, AoS and AoSoA. The vertices are assigned to the grid points in a
+.. random order (as in a remeshed surface). Normals of the triangles are
+.. accumulated to their vertices (area weighted). The normals should be the
+.. same for all the layouts. After a compaction, values should be preserved.
+.. NOTE : AoS & AoSoA vec3 of double (32 bytes per node, padded) require
+.. a tree pool of depth 5,
+.. CFLAGS=-DHMESH_TREE_POOL_DEPTH=5 make attr-layout.tst
+.. (after a 'make clean' in src/). Otherwise hmesh_attr_new () should
+.. reject them, and they are skipped.
+*/
+
+#define N      1024
+#define NSWEEP 5
+
+/* accumulate the normals of the triangles to the vertices */
+#define NORMALS(_COMP_)                                                       \
+  HMESH_FOREACH_BLOCK (v, iblk)                                               \
+    HMESH_FOREACH_INDEX (v, iblk, i)                                          \
+    {                                                                         \
+      Node n = { .index = i, .iblock = iblk };                                \
+      for (int d = 0; d < 3; ++d)                                             \
+        _COMP_ (v, *nrm, d, n) = 0.;                                          \
+    }                                                                         \
+  for (size_t t = 0; t < ntri; ++t)                                           \
+  {                                                                           \
+    Node a = tri[t][0], b = tri[t][1], c = tri[t][2];                         \
+    Real u[3], w[3];                                                          \
+    for (int d = 0; d < 3; ++d)                                               \
+    {                                                                         \
+      u[d] = _COMP_ (v, *p, d, b) - _COMP_ (v, *p, d, a);                     \
+      w[d] = _COMP_ (v, *p, d, c) - _COMP_ (v, *p, d, a);                     \
+    }                                                                         \
+    Real f[3] = { u[1]*w[2] - u[2]*w[1], u[2]*w[0] - u[0]*w[2],               \
+      u[0]*w[1] - u[1]*w[0] };                                                \
+    for (int d = 0; d < 3; ++d)                                               \
+    {                                                                         \
+      _COMP_ (v, *nrm, d, a) += f[d];                                         \
+      _COMP_ (v, *nrm, d, b) += f[d];                                         \
+      _COMP_ (v, *nrm, d, c) += f[d];                                         \
+    }                                                                         \
+  }
+
+typedef void (* Normals) (HmeshCells *, HmeshAttr *, HmeshAttr *,
+  Node (*)[3], size_t);
+
+static void normals_soa (HmeshCells * v, HmeshAttr * p, HmeshAttr * nrm,
+  Node (* tri)[3], size_t ntri)
+{
+  NORMALS (HMESH_SOA_COMP)
+}
+
+static void normals_aos (HmeshCells * v, HmeshAttr * p, HmeshAttr * nrm,
+  Node (* tri)[3], size_t ntri)
+{
+  NORMALS (HMESH_AOS_COMP)
+}
+
+static void normals_aosoa (HmeshCells * v, HmeshAttr * p, HmeshAttr * nrm,
+  Node (* tri)[3], size_t ntri)
+{
+  NORMALS (HMESH_AOSOA_COMP)
+}
+
+/* component 'd' of a node, irrespective of the layout */
+static Real comp (HmeshCells * v, HmeshAttr * a, int d, Node n)
+{
+  return a->layout == HMESH_LAYOUT_SOA ? HMESH_SOA_COMP (v, *a, d, n) :
+    a->layout == HMESH_LAYOUT_AOS ? HMESH_AOS_COMP (v, *a, d, n) :
+    HMESH_AOSOA_COMP (v, *a, d, n);
+}
+
+static void set (HmeshCells * v, HmeshAttr * a, int d, Node n, Real val)
+{
+  if (a->layout == HMESH_LAYOUT_SOA)
+    HMESH_SOA_COMP (v, *a, d, n) = val;
+  else if (a->layout == HMESH_LAYOUT_AOS)
+    HMESH_AOS_COMP (v, *a, d, n) = val;
+  else
+    HMESH_AOSOA_COMP (v, *a, d, n) = val;
+}
+
+int main ()
+{
+  HmeshCells * v = hmesh_cells (0, 2, 3);
+  size_t nv = N * N, ntri = 2 * (N - 1) * (N - 1);
+
+  /* grid point -> vertex, in a random order */
+  Node * vertex = malloc (nv * sizeof (Node));
+  hmesh_nodes_new (v, nv, vertex);
+  srand (1);
+  for (size_t i = nv - 1; i > 0; --i)
+  {
+    size_t j = ((size_t) rand () * RAND_MAX + rand ()) % (i + 1);
+    Node o = vertex[i];
+    vertex[i] = vertex[j];
+    vertex[j] = o;
+  }
+  Node (* tri)[3] = malloc (ntri * sizeof (Node [3]));
+  size_t t = 0;
+  for (int i = 0; i < N - 1; ++i)
+    for (int j = 0; j < N - 1; ++j)
+    {
+      Node a = vertex[i*N + j], b = vertex[(i + 1)*N + j],
+        c = vertex[(i + 1)*N + j + 1], d = vertex[i*N + j + 1];
+      tri[t][0] = a; tri[t][1] = b; tri[t++][2] = c;
+      tri[t][0] = a; tri[t][1] = c; tri[t++][2] = d;
+    }
+
+  const char * name[3] = { "SoA", "AoS", "AoSoA" };
+  Normals normals[3] = { normals_soa, normals_aos, normals_aosoa };
+  Real * ref = malloc (3 * nv * sizeof (Real));
+  int padded = hmesh_tpool_depth () >= 5;
+  for (int l = 0; l < 3; ++l)
+  {
+    HmeshAttr p, nrm;
+    if (l != HMESH_LAYOUT_SOA && !padded)
+    {
+      int errors = !hmesh_attr_new (v, "p", HMESH_TYPE_VEC3, l, &p);
+      if (errors)
+        hmesh_attr_remove (v, &p);
+      hmesh_error_flush ();
+      fprintf (stdout, "\n%-6s : skipped, tree pool of depth %d, errors %d",
+        name[l], hmesh_tpool_depth (), errors);
+      continue;
+    }
+    if ( hmesh_attr_new (v, "p", HMESH_TYPE_VEC3, l, &p) ||
+         hmesh_attr_new (v, "nrm", HMESH_TYPE_VEC3, l, &nrm) )
+    {
+      hmesh_error_flush ();
+      fprintf (stdout, "\n%-6s : not supported by the tree pool of depth %d",
+        name[l], hmesh_tpool_depth ());
+      hmesh_attr_remove (v, &p);
+      continue;
+    }
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < N; ++j)
+      {
+        Node n = vertex[i*N + j];
+        set (v, &p, 0, n, (Real) i);
+        set (v, &p, 1, n, (Real) j);
+        set (v, &p, 2, n, (Real) (0.1 * ((i * j) % 17)));
+      }
+
+    double start = now ();
+    for (int s = 0; s < NSWEEP; ++s)
+      normals[l] (v, &p, &nrm, tri, ntri);
+    double time = (now () - start) / NSWEEP;
+
+    int errors = 0;
+    for (size_t i = 0; i < nv; ++i)
+      for (int d = 0; d < 3; ++d)
+        if (!l)
+          ref[3*i + d] = comp (v, &nrm, d, vertex[i]);
+        else if (ref[3*i + d] != comp (v, &nrm, d, vertex[i]))
+          ++errors;
+
+    fprintf (stdout, "\n%-6s : normals %6.2f ns/triangle, errors %d",
+      name[l], 1e9 * time / ntri, errors);
+
+    hmesh_attr_remove (v, &p);
+    hmesh_attr_remove (v, &nrm);
+  }
+
+  /*
+  .. Compaction of all layouts : remove 3/4 th of the vertices and compact.
+  .. The values of the remaining vertices are moved with their nodes.
+  */
+  HmeshAttr a[3];
+  int nlayout = 0, errors = 0;
+  for (int l = 0; l < 3; ++l)
+  {
+    char aname [] = "a0";
+    aname[1] += l;
+    if (l != HMESH_LAYOUT_SOA && !padded)
+      continue;
+    if (!hmesh_attr_new (v, aname, HMESH_TYPE_VEC3, l, &a[nlayout]))
+      ++nlayout;
+  }
+  hmesh_error_flush ();
+  for (size_t i = 0; i < nv; ++i)
+    for (int l = 0; l < nlayout; ++l)
+      for (int d = 0; d < 3; ++d)
+        set (v, &a[l], d, vertex[i], (Real) (3*i + d));
+  for (size_t i = nv/4; i < nv; ++i)
+    hmesh_node_remove (v, vertex[i]);
+  HmeshRemap remap;
+  Index nblocks = v->blocks->n;
+  errors += hmesh_cells_compact (v, &remap);
+  for (size_t i = 0; i < nv/4; ++i)
+  {
+    Node n = hmesh_remap_node (&remap, vertex[i]);
+    for (int l = 0; l < nlayout; ++l)
+      for (int d = 0; d < 3; ++d)
+        if (comp (v, &a[l], d, n) != (Real) (3*i + d))
+          ++errors;
+  }
+  hmesh_remap_free (&remap);
+  fprintf (stdout, "\ncompact: %d layouts, blocks %d -> %d, errors %d\n",
+    nlayout, nblocks, v->blocks->n, errors);
+
+  free (ref);
+  free (tri);
+  free (vertex);
+  hmesh_cells_destroy (v);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
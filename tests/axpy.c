@@ -0,0 +1,174 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include "now.h"
+
+/*
+.. Benchmark of an axpy, x += dt * u, over the position vector
+.. {x.x, x.y, x.z} of the vertices, using
+.. (a) HMESH_SCALAR () : node by node, from a list of nodes
+.. (b) HMESH_FOREACH_INDEX () : block by block, over the nodes in use
+.. (c) HMESH_FOREACH_BLOCK () : block by block, over all the slots
+.. (d) plain arrays of the nodes in use, packed, as a reference of the
+.. cost of the same kernel with no indirection and no unused slots.
+.. 1/8 th of the nodes are removed, so that the blocks are not full.
+*/
+
+#define NNODES (1<<16)
+#define NSWEEP 500
+
+static Index scalar (HmeshCells * cells, char * name)
+{
+  HmeshArray * s = hmesh_scalar_new (cells, name);
+  Index is = 0;
+  while (cells->attr[is] != s)
+    ++is;
+  return is;
+}
+
+static double checksum (HmeshCells * cells)
+{
+  double sum = 0.;
+  HMESH_FOREACH_BLOCK (cells, iblk)
+    for (Index d = 2; d < 5; ++d)
+    {
+      Real * x = HMESH_REAL (cells, d, iblk);
+      HMESH_FOREACH_INDEX (cells, iblk, i)
+        sum += x[i];
+    }
+  return sum;
+}
+
+static void reset (HmeshCells * cells, Index * iu)
+{
+  HMESH_FOREACH_BLOCK (cells, iblk)
+    for (Index d = 0; d < 3; ++d)
+    {
+      Real * x = HMESH_REAL (cells, 2 + d, iblk),
+        * u = HMESH_REAL (cells, iu[d], iblk);
+      for (int i = 0; i < HMESH_BLOCK_SIZE; ++i)
+      {
+        x[i] = 0.;
+        u[i] = (Real) (i % 7);
+      }
+    }
+}
+
+int main ()
+{
+  HmeshCells * v = hmesh_cells (0, 2, 3);
+  Index iu[3] = { scalar (v, "ux"), scalar (v, "uy"), scalar (v, "uz") };
+
+  Node * node = malloc (NNODES * sizeof (Node));
+  size_t n = hmesh_nodes_new (v, NNODES, node);
+  for (size_t i = 0; i < n; i += 8)
+    hmesh_node_remove (v, node[i]);
+  /* list of nodes in use */
+  size_t m = 0;
+  for (size_t i = 0; i < n; ++i)
+    if (i % 8)
+      node[m++] = node[i];
+
+  Real dt = 0.5;
+  double t[4], sum[4];
+
+  /* (a) */
+  reset (v, iu);
+  double start = now ();
+  for (int s = 0; s < NSWEEP; ++s)
+    for (size_t i = 0; i < m; ++i)
+    {
+      Node nd = node[i];
+      HMESH_SCALAR (v, 2, nd) += dt * HMESH_SCALAR (v, iu[0], nd);
+      HMESH_SCALAR (v, 3, nd) += dt * HMESH_SCALAR (v, iu[1], nd);
+      HMESH_SCALAR (v, 4, nd) += dt * HMESH_SCALAR (v, iu[2], nd);
+    }
+  t[0] = now () - start;
+  sum[0] = checksum (v);
+
+  /* (b) */
+  reset (v, iu);
+  start = now ();
+  for (int s = 0; s < NSWEEP; ++s)
+    HMESH_FOREACH_BLOCK (v, iblk)
+    {
+      Real * x = HMESH_REAL (v, 2, iblk), * ux = HMESH_REAL (v, iu[0], iblk),
+        * y = HMESH_REAL (v, 3, iblk), * uy = HMESH_REAL (v, iu[1], iblk),
+        * z = HMESH_REAL (v, 4, iblk), * uz = HMESH_REAL (v, iu[2], iblk);
+      HMESH_FOREACH_INDEX (v, iblk, i)
+      {
+        x[i] += dt * ux[i];
+        y[i] += dt * uy[i];
+        z[i] += dt * uz[i];
+      }
+    }
+  t[1] = now () - start;
+  sum[1] = checksum (v);
+
+  /* (c) */
+  reset (v, iu);
+  start = now ();
+  for (int s = 0; s < NSWEEP; ++s)
+    HMESH_FOREACH_BLOCK (v, iblk)
+    {
+      Real * restrict x = HMESH_REAL (v, 2, iblk),
+        * restrict y = HMESH_REAL (v, 3, iblk),
+        * restrict z = HMESH_REAL (v, 4, iblk),
+        * restrict ux = HMESH_REAL (v, iu[0], iblk),
+        * restrict uy = HMESH_REAL (v, iu[1], iblk),
+        * restrict uz = HMESH_REAL (v, iu[2], iblk);
+      for (int i = 0; i < HMESH_BLOCK_SIZE; ++i)
+      {
+        x[i] += dt * ux[i];
+        y[i] += dt * uy[i];
+        z[i] += dt * uz[i];
+      }
+    }
+  t[2] = now () - start;
+  sum[2] = checksum (v);
+
+  /* (d) */
+  Real * a = malloc (6 * m * sizeof (Real));
+  for (size_t i = 0; i < m; ++i)
+    for (int d = 0; d < 3; ++d)
+    {
+      a[d*m + i] = 0.;
+      a[(3 + d)*m + i] = (Real) (node[i].index % 7);
+    }
+  start = now ();
+  for (int s = 0; s < NSWEEP; ++s)
+  {
+    Real * restrict x = a, * restrict y = a + m, * restrict z = a + 2*m,
+      * restrict ux = a + 3*m, * restrict uy = a + 4*m,
+      * restrict uz = a + 5*m;
+    for (size_t i = 0; i < m; ++i)
+    {
+      x[i] += dt * ux[i];
+      y[i] += dt * uy[i];
+      z[i] += dt * uz[i];
+    }
+  }
+  t[3] = now () - start;
+  sum[3] = 0.;
+  for (size_t i = 0; i < 3*m; ++i)
+    sum[3] += a[i];
+  free (a);
+
+  const char * name[4] = { "HMESH_SCALAR ()", "HMESH_FOREACH_INDEX ()",
+    "HMESH_FOREACH_BLOCK ()", "packed arrays" };
+  for (int k = 0; k < 4; ++k)
+    fprintf (stdout, "\n%-24s : %6.2f ns/node, checksum %s", name[k],
+      1e9 * t[k] / NSWEEP / m, sum[k] == sum[0] ? "ok" : "failed");
+  fprintf (stdout, "\n");
+
+  free (node);
+  hmesh_cells_destroy (v);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
@@ -4,7 +4,7 @@
 
 int main() {
 
-  HmeshCells * vertices = hmesh_cells (0,3);
+  HmeshCells * vertices = hmesh_cells (0, 2, 3);
 
   hmesh_scalar_new (vertices, "s");
   hmesh_scalar_new (vertices, "0"); //Error : naming should follow C naming rules
@@ -28,7 +28,7 @@ int main() {
     fprintf (stdout, "\n\t%s", attr->name);
   }
   fprintf (stdout, "\nList of scalar attr");  
-  for (int i = vertices->min; i<vertices->scalars.n; ++i)
+  for (Index i = vertices->min; i<vertices->scalars.n; ++i)
   {
     Index iscalar = vertices->scalars.info[i].in_use;
     HmeshArray * attr = (HmeshArray *) vertices->attr[iscalar];
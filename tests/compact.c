@@ -0,0 +1,162 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include "now.h"
+
+/*
+.. Compaction of a mesh of edges (hmesh_compact ()). Most of the vertices and
+.. edges are removed in a random order, leaving sparse blocks. After the
+.. compaction, every edge should still refer to the same vertices and to
+.. the same 'next' edge. Number of blocks and the time of a sweep over all
+.. the blocks of a scalar are reported before and after the compaction.
+.. The handle of a removed node should be remapped to HMESH_NODE_NULL, if
+.. its block is emptied.
+*/
+
+#define NNODES (1<<20)
+#define NSWEEP 20
+
+static void shuffle (Node * node, int n)
+{
+  for (int i = n - 1; i > 0; --i)
+  {
+    int j = rand () % (i + 1);
+    Node o = node[i];
+    node[i] = node[j];
+    node[j] = o;
+  }
+}
+
+/* sweep over all the slots of the blocks in use */
+static double sweep (HmeshCells * cells, Index is, Real * sum)
+{
+  size_t bsize = hmesh_tpool_block_size ();
+  IndexStack * blocks = cells->blocks;
+  double start = now ();
+  for (int s = 0; s < NSWEEP; ++s)
+    for (Index i = 0; i < blocks->n; ++i)
+    {
+      Real * x = HMESH_REAL (cells, is, blocks->info[i].in_use);
+      for (size_t j = 0; j < bsize; ++j)
+        *sum += x[j];
+    }
+  return (now () - start) / NSWEEP;
+}
+
+/* verify the vertices and the 'next' edge of each edge */
+static int verify (Hmesh * h, Index ia, Index ib, Index in, Index iid)
+{
+  HmeshCells * v = h->p, * e = h->e;
+  int errors = 0;
+  IndexStack * blocks = e->blocks;
+  for (Index i = 0; i < blocks->n; ++i)
+  {
+    Index iblock = blocks->info[i].in_use,
+      * map = (Index *) HMESH_ATTR (e, 0, iblock);
+    for (Index j = 0; j < e->info[iblock]; ++j)
+    {
+      Node edge = { .index = map[j], .iblock = iblock },
+        a = HMESH_IVERTEX (e, edge, 0), b = HMESH_IVERTEX (e, edge, 1),
+        next = HMESH_SUBNODE (e, edge, 1 + 1);
+      if ( HMESH_SCALAR (v, 2, a) != HMESH_SCALAR (e, ia, edge) ||
+           HMESH_SCALAR (v, 2, b) != HMESH_SCALAR (e, ib, edge) ||
+           HMESH_SCALAR (e, iid, next) != HMESH_SCALAR (e, in, edge) )
+        ++errors;
+    }
+  }
+  return errors;
+}
+
+static Index scalar (HmeshCells * cells, char * name)
+{
+  HmeshArray * s = hmesh_scalar_new (cells, name);
+  Index is = 0;
+  while (cells->attr[is] != s)
+    ++is;
+  return is;
+}
+
+int main ()
+{
+  Hmesh * h = hmesh (1, 3);
+  HmeshCells * v = h->p, * e = h->e;
+  Index ia = scalar (e, "a"), ib = scalar (e, "b"), in = scalar (e, "n"),
+    iid = scalar (e, "id");
+
+  Node * vertex = malloc (NNODES * sizeof (Node)),
+    * edge = malloc (NNODES * sizeof (Node));
+  hmesh_nodes_new (v, NNODES, vertex);
+  hmesh_nodes_new (e, NNODES, edge);
+
+  /* remove 3/4 th of the vertices */
+  srand (1);
+  shuffle (vertex, NNODES);
+  for (int i = NNODES/4; i < NNODES; ++i)
+    hmesh_node_remove (v, vertex[i]);
+  for (int i = 0; i < NNODES/4; ++i)
+    HMESH_SCALAR (v, 2, vertex[i]) = (Real) i;
+
+  /* remove 3/4 th of the edges, and connect the rest */
+  shuffle (edge, NNODES);
+  for (int i = NNODES/4; i < NNODES; ++i)
+    hmesh_node_remove (e, edge[i]);
+  for (int i = 0; i < NNODES/4; ++i)
+  {
+    int a = rand () % (NNODES/4), b = rand () % (NNODES/4),
+      n = rand () % (NNODES/4);
+    HMESH_IVERTEX (e, edge[i], 0) = vertex[a];
+    HMESH_IVERTEX (e, edge[i], 1) = vertex[b];
+    HMESH_SUBNODE (e, edge[i], 1 + 1) = edge[n];
+    HMESH_SCALAR (e, ia, edge[i]) = (Real) a;
+    HMESH_SCALAR (e, ib, edge[i]) = (Real) b;
+    HMESH_SCALAR (e, in, edge[i]) = (Real) n;
+    HMESH_SCALAR (e, iid, edge[i]) = (Real) i;
+  }
+
+  Real sum = 0.;
+  fprintf (stdout, "\nbefore : vertex blocks %4d, edge blocks %4d, "
+    "sweep %.3f ms, errors %d", v->blocks->n, e->blocks->n,
+    1e3 * sweep (v, 2, &sum), verify (h, ia, ib, in, iid));
+
+  double start = now ();
+  int status = hmesh_compact (h);
+  double t = now () - start;
+
+  fprintf (stdout, "\nafter  : vertex blocks %4d, edge blocks %4d, "
+    "sweep %.3f ms, errors %d", v->blocks->n, e->blocks->n,
+    1e3 * sweep (v, 2, &sum), verify (h, ia, ib, in, iid));
+  fprintf (stdout, "\nhmesh_compact () : %.1f ms, status %d (sum %g)",
+    1e3 * t, status, (double) sum);
+
+  /* stale handles : every other vertex is removed */
+  HmeshCells * c = hmesh_cells (0, 1, 3);
+  HmeshRemap remap;
+  hmesh_nodes_new (c, NNODES/4, vertex);
+  for (int i = 1; i < NNODES/4; i += 2)
+    hmesh_node_remove (c, vertex[i]);
+  status = hmesh_cells_compact (c, &remap);
+  int nnull = 0, errors = 0;
+  for (int i = 1; i < NNODES/4; i += 2)
+  {
+    Node n = hmesh_remap_node (&remap, vertex[i]);
+    nnull += (n.index == HMESH_INDEX_NULL && n.iblock == HMESH_INDEX_NULL);
+    errors += (n.index != vertex[i].index || n.iblock != vertex[i].iblock) &&
+      n.index != HMESH_INDEX_NULL;
+  }
+  fprintf (stdout, "\nstale handles : %d of %d remapped to NULL, status %d, "
+    "errors %d\n", nnull, NNODES/8, status, errors + !nnull);
+  hmesh_remap_free (&remap);
+  hmesh_cells_destroy (c);
+
+  free (vertex);
+  free (edge);
+  hmesh_destroy (h);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
@@ -31,7 +31,7 @@ void TpoolStatus()
       for(int j=10*k; j<10*(k+1); ++j)
       {
         Index start = j*16;
-        for (Index index = (1<<level) - 1; index < (1<<(level+1)) - 1; ++index)
+        for (int index = (1<<level) - 1; index < (1<<(level+1)) - 1; ++index)
         {
           Index inode = start + index; 
           char state =  flags[inode] & 128 ? 'f' :  /* free */
@@ -55,7 +55,7 @@ int main()
 
   srand(time(0));
 
-  HmeshCells * vertices = hmesh_cells (0,3);
+  HmeshCells * vertices = hmesh_cells (0, 2, 3);
 
   fflush (stdout);
   /* Insert a 'node' (vertex) to vertices */
@@ -4,7 +4,7 @@
 
 int main() {
 
-  HmeshCells * edges = hmesh_cells (1,3);
+  HmeshCells * edges = hmesh_cells (1, 2, 3);
 
   hmesh_scalar_new (edges, "s");
   hmesh_scalar_new (edges, "0"); //Error : naming should follow C naming rules
@@ -28,7 +28,7 @@ int main() {
     fprintf (stdout, "\n\t%s", attr->name);
   }
   fprintf (stdout, "\nList of scalar attr");  
-  for (int i = edges->min; i<edges->scalars.n; ++i)
+  for (Index i = edges->min; i<edges->scalars.n; ++i)
   {
     Index iscalar = edges->scalars.info[i].in_use;
     HmeshArray * attr = (HmeshArray *) edges->attr[iscalar];
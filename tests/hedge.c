@@ -0,0 +1,386 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include "now.h"
+
+/*
+.. Half edges on HmeshCells (hmesh_hedges_new ()) compared with the pointer
+.. based 'Hedge' of src/backup/hmesh.h. A torus of 2 N^2 triangles is
+.. created from its faces (in a random order), and the twins found should
+.. be those of the torus. The memory per half edge and the time of the
+.. walks over the faces and the stars of all the vertices are compared,
+.. before and after hmesh_reorder () (the walks of Node are faster than
+.. Hedge only after the reorder). Both should give the same sums. An open grid (with a boundary), a
+.. repeated face and a corrupted twin are verified by hmesh_hedges_valid ().
+*/
+
+#define N 1024
+#define M 8
+
+/* the pointer based half edge, as in src/backup/hmesh.h */
+typedef struct _Hedge Hedge;
+struct _Hedge
+{
+  Hedge * next, * prev, * flip;
+  Real * v;
+  long alias, id;
+  int pid;
+  unsigned short flags;
+};
+
+static void shuffle (size_t * a, size_t n)
+{
+  for (size_t i = n - 1; i > 0; --i)
+  {
+    size_t j = ((size_t) rand () * RAND_MAX + rand ()) % (i + 1), o = a[i];
+    a[i] = a[j];
+    a[j] = o;
+  }
+}
+
+static int same (Node a, Node b)
+{
+  return a.index == b.index && a.iblock == b.iblock;
+}
+
+/* face 't' of the quad (i,j) (periodic) */
+static size_t fc (long i, long j, int t)
+{
+  i = (i + N) % N;
+  j = (j + N) % N;
+  return (i*N + j)*2 + t;
+}
+
+/* triangles of the open M x M grid of the vertices 'p' */
+static int grid_faces (Node * p, Node (* grid)[3])
+{
+  int k = 0;
+  for (int i = 0; i < M - 1; ++i)
+    for (int j = 0; j < M - 1; ++j)
+    {
+      Node a = p[i*M + j], b = p[(i+1)*M + j], c = p[(i+1)*M + j + 1],
+        d = p[i*M + j + 1];
+      grid[k][0] = a; grid[k][1] = b; grid[k++][2] = c;
+      grid[k][0] = a; grid[k][1] = c; grid[k++][2] = d;
+    }
+  return k;
+}
+
+/* star of each vertex of the worklist (sum of the squares of laplacian) */
+static double star_node (HmeshCells * v, HmeshCells * e, Node * work,
+  size_t n)
+{
+  double sum = 0.;
+  for (size_t w = 0; w < n; ++w)
+  {
+    Real x = 0.;
+    HMESH_FOREACH_STAR (e, work[w], h)
+      x += HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, h, 1));
+    Real l = x - 6. * HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, work[w], 0));
+    sum += l * l;
+  }
+  return sum;
+}
+
+static double star_pointer (Hedge ** work, size_t n)
+{
+  double sum = 0.;
+  for (size_t w = 0; w < n; ++w)
+  {
+    Hedge * h = work[w];
+    Real x = 0.;
+    do
+    {
+      x += *h->next->v;
+      h = h->flip->next;
+    } while (h != work[w]);
+    Real l = x - 6. * *work[w]->v;
+    sum += l * l;
+  }
+  return sum;
+}
+
+static double star_batch (HmeshCells * v, HmeshCells * e, Node * work,
+  size_t n, Real * x)
+{
+  for (size_t w = 0; w < n; ++w)
+    x[w] = 0.;
+  HMESH_FOREACH_STARS (e, work, n, s)
+    x[s.w] += HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, s.e, 1));
+  double sum = 0.;
+  for (size_t w = 0; w < n; ++w)
+  {
+    Real l = x[w] - 6. * HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, work[w], 0));
+    sum += l * l;
+  }
+  return sum;
+}
+
+/* first half edge (in the order of memory) going out of each vertex */
+static size_t starts (HmeshCells * v, HmeshCells * e, Index imark,
+  Node * work)
+{
+  HMESH_FOREACH_NODE (v, p)
+    HMESH_SCALAR (v, imark, p) = 0.;
+  size_t n = 0;
+  HMESH_FOREACH_NODE (e, x)
+  {
+    Node a = HMESH_IVERTEX (e, x, 0);
+    if (!HMESH_SCALAR (v, imark, a))
+    {
+      HMESH_SCALAR (v, imark, a) = 1.;
+      work[n++] = x;
+    }
+  }
+  return n;
+}
+
+static size_t pstarts (Hedge * hedge, size_t ne, Real * px, Hedge ** work)
+{
+  size_t n = 0, nv = (size_t) N * N;
+  char * mark = calloc (nv, 1);
+  for (size_t i = 0; i < ne; ++i)
+    if (!mark [hedge[i].v - px])
+    {
+      mark [hedge[i].v - px] = 1;
+      work[n++] = &hedge[i];
+    }
+  free (mark);
+  return n;
+}
+
+/* perimeter (in x.x) of all the faces */
+static double face_node (HmeshCells * v, HmeshCells * e)
+{
+  double sum = 0.;
+  HMESH_FOREACH_NODE (e, x)
+  {
+    Real p = 0.;
+    HMESH_FOREACH_FACE (e, x, f)
+      p += HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, f, 0));
+    sum += p;
+  }
+  return sum;
+}
+
+static double face_pointer (Hedge * hedge, size_t n)
+{
+  double sum = 0.;
+  for (size_t i = 0; i < n; ++i)
+  {
+    Hedge * h = &hedge[i];
+    Real p = 0.;
+    do
+    {
+      p += *h->v;
+      h = h->next;
+    } while (h != &hedge[i]);
+    sum += p;
+  }
+  return sum;
+}
+
+int main ()
+{
+  Hmesh * h = hmesh (2, 3);
+  HmeshCells * v = h->p, * e = h->e;
+  size_t nv = (size_t) N * N, nf = 2 * nv, ne = 3 * nf;
+
+  /* vertices (i,j) and faces, in a random order */
+  srand (1);
+  Node * vertex = malloc (nv * sizeof (Node));
+  hmesh_nodes_new (v, nv, vertex);
+  size_t * order = malloc (nf * sizeof (size_t)),
+    * position = malloc (nf * sizeof (size_t));
+  for (size_t i = 0; i < nv; ++i)
+    order[i] = i;
+  shuffle (order, nv);
+  Node * created = malloc (nv * sizeof (Node));
+  memcpy (created, vertex, nv * sizeof (Node));
+  for (size_t i = 0; i < nv; ++i)
+    vertex[i] = created [order[i]];
+  free (created);
+  Real * px = malloc (nv * sizeof (Real));
+  for (size_t i = 0; i < nv; ++i)
+    px[i] = HMESH_SCALAR (v, 2, vertex[i]) = (Real) (i % 1000);
+  for (size_t f = 0; f < nf; ++f)
+    order[f] = f;
+  shuffle (order, nf);
+  for (size_t k = 0; k < nf; ++k)
+    position[order[k]] = k;
+
+  /* quad (i,j) : A = (p00, p10, p11), B = (p00, p11, p01) */
+  Node (* face)[3] = malloc (nf * sizeof (Node [3]));
+  size_t (* fv)[3] = malloc (nf * sizeof (size_t [3]));
+  for (long i = 0; i < N; ++i)
+    for (long j = 0; j < N; ++j)
+    {
+      size_t p[4] = { i*N + j, ((i + 1) % N)*N + j,
+        ((i + 1) % N)*N + (j + 1) % N, i*N + (j + 1) % N };
+      int tv[2][3] = { {0, 1, 2}, {0, 2, 3} };
+      for (int t = 0; t < 2; ++t)
+        for (int s = 0; s < 3; ++s)
+        {
+          size_t k = position [fc (i, j, t)];
+          fv[k][s] = p [tv[t][s]];
+          face[k][s] = vertex [p [tv[t][s]]];
+        }
+    }
+
+  Node * he = malloc (ne * sizeof (Node));
+  double start = now ();
+  int errors = hmesh_hedges_new (h, face, nf, he);
+  double tnew = now () - start;
+  start = now ();
+  int valid = hmesh_hedges_valid (h);
+  double tvalid = now () - start;
+  errors += (valid != HMESH_HEDGE_VALID);
+
+  /* twins of the torus : A0 - B1 of (i,j-1), A1 - B2 of (i+1,j), A2 - B0 */
+  for (long i = 0; i < N; ++i)
+    for (long j = 0; j < N; ++j)
+    {
+      size_t a = 3 * position [fc (i, j, 0)];
+      errors += !same (HMESH_TWIN (e, he[a]),
+        he [3 * position [fc (i, j - 1, 1)] + 1]);
+      errors += !same (HMESH_TWIN (e, he[a + 1]),
+        he [3 * position [fc (i + 1, j, 1)] + 2]);
+      errors += !same (HMESH_TWIN (e, he[a + 2]),
+        he [3 * position [fc (i, j, 1)]]);
+    }
+
+  /* the pointer based half edges, in the same order */
+  Hedge * hedge = malloc (ne * sizeof (Hedge));
+  for (size_t k = 0; k < nf; ++k)
+    for (int s = 0; s < 3; ++s)
+    {
+      Hedge * x = &hedge [3*k + s];
+      x->next = &hedge [3*k + (s + 1) % 3];
+      x->prev = &hedge [3*k + (s + 2) % 3];
+      x->v = &px [fv[k][s]];
+      x->alias = x->id = (long) (3*k + s);
+      x->pid = 0;
+      x->flags = (unsigned short) (s << 3);
+    }
+  for (long i = 0; i < N; ++i)
+    for (long j = 0; j < N; ++j)
+    {
+      Hedge * a = &hedge [3 * position [fc (i, j, 0)]],
+        * b = &hedge [3 * position [fc (i, j - 1, 1)] + 1],
+        * c = &hedge [3 * position [fc (i + 1, j, 1)] + 2],
+        * d = &hedge [3 * position [fc (i, j, 1)]];
+      a[0].flip = b; b->flip = &a[0];
+      a[1].flip = c; c->flip = &a[1];
+      a[2].flip = d; d->flip = &a[2];
+    }
+
+  /* worklists, in the order of memory of the half edges */
+  Index imark = (hmesh_scalar_new (v, "mark"), hmesh_scalar_get (v, "mark"));
+  Node * work = malloc (nv * sizeof (Node));
+  Hedge ** pwork = malloc (nv * sizeof (Hedge *));
+  Real * x = malloc (nv * sizeof (Real));
+  errors += (starts (v, e, imark, work) != nv) +
+    (pstarts (hedge, ne, px, pwork) != nv);
+
+  double t[7], r[7];
+  start = now ();
+  r[0] = star_pointer (pwork, nv);
+  t[0] = now () - start;
+  start = now ();
+  r[1] = star_node (v, e, work, nv);
+  t[1] = now () - start;
+  start = now ();
+  r[2] = star_batch (v, e, work, nv, x);
+  t[2] = now () - start;
+  start = now ();
+  r[3] = face_pointer (hedge, ne);
+  t[3] = now () - start;
+  start = now ();
+  r[4] = face_node (v, e);
+  t[4] = now () - start;
+
+  /* Node handles can be renumbered (Hilbert), unlike the pointers */
+  start = now ();
+  errors += hmesh_reorder (h, HMESH_CURVE_HILBERT);
+  double treorder = now () - start;
+  errors += (starts (v, e, imark, work) != nv) +
+    (hmesh_hedges_valid (h) != HMESH_HEDGE_VALID);
+  start = now ();
+  r[5] = star_batch (v, e, work, nv, x);
+  t[5] = now () - start;
+  start = now ();
+  r[6] = face_node (v, e);
+  t[6] = now () - start;
+  errors += (r[1] != r[0]) + (r[2] != r[0]) + (r[5] != r[0]) +
+    (r[4] != r[3]) + (r[6] != r[3]);
+
+  size_t bytes = 0;
+  for (Index i = 0; i < e->scalars.n; ++i)
+    bytes += ((HmeshArray *) e->attr[e->scalars.info[i].in_use])->obj_size;
+
+  fprintf (stdout, "\n%zu half edges : new %.1f ns, valid %.1f ns, reorder "
+    "%.1f ns per half edge", ne, 1e9 * tnew / ne, 1e9 * tvalid / ne,
+    1e9 * treorder / ne);
+  fprintf (stdout, "\nbytes/half edge : Node %zu (handle %zu), Hedge %zu",
+    bytes, sizeof (Node), sizeof (Hedge));
+  const char * name[7] = { "stars Hedge", "stars Node", "stars Node batch",
+    "faces Hedge", "faces Node", "stars Node batch (Hilbert)",
+    "faces Node (Hilbert)" };
+  for (int i = 0; i < 7; ++i)
+    fprintf (stdout, "\n%-26s : %6.1f ns/%s, sum %g", name[i],
+      1e9 * t[i] / (i == 3 || i == 4 || i == 6 ? ne : nv),
+      i == 3 || i == 4 || i == 6 ? "half edge" : "vertex", r[i]);
+  fprintf (stdout, "\nerrors %d", errors);
+
+  free (x);
+  free (pwork);
+  free (work);
+  free (hedge);
+  free (he);
+  free (fv);
+  free (face);
+  free (px);
+  free (position);
+  free (order);
+  free (vertex);
+  hmesh_destroy (h);
+
+  /* open M x M grid : boundary half edges have no twin */
+  h = hmesh (2, 3);
+  v = h->p;
+  e = h->e;
+  Node p[M*M], grid[2*(M-1)*(M-1)][3];
+  hmesh_nodes_new (v, M*M, p);
+  int k = grid_faces (p, grid);
+  errors += hmesh_hedges_new (h, grid, k, NULL) +
+    (hmesh_hedges_valid (h) != HMESH_HEDGE_VALID);
+  int nboundary = 0;
+  HMESH_FOREACH_NODE (e, x)
+    nboundary += (HMESH_TWIN (e, x).index == HMESH_INDEX_NULL);
+  errors += (nboundary != 4 * (M - 1));
+
+  /* a face repeated, and a corrupted twin */
+  hmesh_error_flush ();
+  hmesh_error ("main () : expect an error for a repeated face");
+  errors += !hmesh_hedges_new (h, grid, 1, NULL);
+  hmesh_error_flush ();
+  hmesh_destroy (h);
+  h = hmesh (2, 3);
+  hmesh_nodes_new (h->p, M*M, p);
+  grid_faces (p, grid);
+  Node out[3 * 2*(M-1)*(M-1)];
+  errors += hmesh_hedges_new (h, grid, k, out);
+  HMESH_TWIN (h->e, out[2]) = out[0];
+  errors += (hmesh_hedges_valid (h) != HMESH_HEDGE_TWIN);
+  fprintf (stdout, "\ngrid %dx%d : %d boundary half edges, errors %d\n",
+    M, M, nboundary, errors);
+  hmesh_destroy (h);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
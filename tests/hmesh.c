@@ -21,7 +21,7 @@ int main() {
       fprintf (stdout, "\n\t%s", attr->name);
     }
     fprintf (stdout, "\nList of scalar attr");  
-    for (int i = cells->min; i<cells->scalars.n; ++i)
+    for (Index i = cells->min; i<cells->scalars.n; ++i)
     {
       Index iscalar = cells->scalars.info[i].in_use;
       HmeshArray * attr = (HmeshArray *) cells->attr[iscalar];
@@ -0,0 +1,47 @@
+#include <common.h>
+
+/*
+.. Growth of IndexStack. Indices are added one by one to a stack with an
+.. increment of 8 (as in hmesh_array ()), and the number of reallocs of
+.. the stack is counted. With the geometric growth, it's O(log n), and it's
+.. a single realloc if the stack is reserved before.
+*/
+
+#define NINDICES 10000
+
+static int count (IndexStack * stack, int reserve)
+{
+  void ** attribute = NULL;
+  *stack = index_stack (HMESH_INDEX_NULL, 8, &attribute);
+  if (reserve)
+    index_stack_reserve (stack, NINDICES);
+
+  int nrealloc = reserve ? 1 : 0;
+  Index max = stack->max;
+  for (int i = 0; i < NINDICES; ++i)
+  {
+    if (index_stack_free_head (stack, 1) == HMESH_INDEX_NULL)
+      hmesh_error ("main () : out of index");
+    if (stack->max != max)
+    {
+      max = stack->max;
+      ++nrealloc;
+    }
+  }
+
+  index_stack_destroy (stack);
+  free (attribute);
+  return nrealloc;
+}
+
+int main ()
+{
+  IndexStack stack;
+  fprintf (stdout, "\n%d indices : %d reallocs"
+    "\n%d indices : %d reallocs, (reserved)\n",
+    NINDICES, count (&stack, 0), NINDICES, count (&stack, 1));
+
+  hmesh_error_flush ();
+
+  return 0;
+}
@@ -10,7 +10,7 @@ int main()
 
   for (Index i = 0; i < 15; ++i)
   {
-    if (index_stack_free_head (&stack, 1) == UINT16_MAX)
+    if (index_stack_free_head (&stack, 1) == HMESH_INDEX_NULL)
       hmesh_error ("Out of free index");
   }
   /* It should print the error 5 times */
@@ -40,7 +40,7 @@ int main()
   for (Index i = 0; i < 10; ++i)
   {
     Index index = index_stack_free_head (&stack, 1);
-    if (index != UINT16_MAX) 
+    if (index != HMESH_INDEX_NULL) 
       attributes[index] = malloc(8);
   }
 
@@ -77,5 +77,26 @@ int main()
   /* expect NO error */
   hmesh_error_flush ();
 
+#if HMESH_INDEX_BITS == 32
+  /* More indices than a 16 bit Index can address */
+  Index n = 25 * 4096;
+  stack = index_stack (HMESH_INDEX_NULL, 4096, NULL);
+  /* reserved, so that indices are in [0, n) */
+  if (index_stack_reserve (&stack, n) == HMESH_ERROR)
+    hmesh_error ("cannot reserve %u indices", n);
+  for (Index i = 0; i < n; ++i)
+    if (index_stack_free_head (&stack, 1) >= n)
+      hmesh_error ("index out of range");
+  for (Index index = 0; index < n; index += 2)
+    if (index_stack_deallocate (&stack, index) == HMESH_ERROR)
+      hmesh_error ("index %u not in use", index);
+  if (stack.n != n/2)
+    hmesh_error ("%u indices in use, expected %u", stack.n, n/2);
+  if (index_stack_destroy (&stack) == HMESH_ERROR)
+    hmesh_error ("cannot destroy stack of %u indices", n);
+  /* expect NO error */
+  hmesh_error_flush ();
+#endif
+
   return 0;
 }
@@ -4,7 +4,7 @@
 
 int main()
 {
-  HmeshCells * vertices = hmesh_cells (0,3);
+  HmeshCells * vertices = hmesh_cells (0, 2, 3);
 
   fflush (stdout);
   /* Insert a 'node' (vertex) to vertices */
@@ -0,0 +1,119 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include "now.h"
+
+/*
+.. Insertion and removal of nodes. Nodes are inserted, and removed in a
+.. random order, while the value stored in each node is verified (a Node is
+.. a stable handle). Then the map of each block is verified to be densely
+.. packed. Finally, the rate of insert/remove is measured.
+*/
+
+#define NNODES (1<<20)
+#define NOPS   (1<<24)
+
+/* number of nodes in use, after verifying map & imap */
+static size_t verify (HmeshCells * cells)
+{
+  size_t n = 0, bsize = hmesh_tpool_block_size ();
+  IndexStack * blocks = cells->blocks;
+  for (Index i = 0; i < blocks->n; ++i)
+  {
+    Index iblock = blocks->info[i].in_use,
+      * map  = (Index *) HMESH_ATTR (cells, 0, iblock),
+      * imap = (Index *) HMESH_ATTR (cells, 1, iblock);
+    for (size_t j = 0; j < bsize; ++j)
+      if (imap[map[j]] != j)
+        hmesh_error ("verify () : map of block %d is corrupted", iblock);
+    n += cells->info[iblock];
+  }
+  return n;
+}
+
+int main ()
+{
+  HmeshCells * vertices = hmesh_cells (0, 2, 3);
+  HmeshArray * s = hmesh_scalar_new (vertices, "s");
+  Index is = 0;
+  while (vertices->attr[is] != s)
+    ++is;
+
+  Node * node = malloc (NNODES * sizeof (Node));
+  for (int i = 0; i < NNODES; ++i)
+  {
+    node[i] = hmesh_node_new (vertices);
+    HMESH_SCALAR (vertices, is, node[i]) = (Real) i;
+  }
+  fprintf (stdout, "\ninserted %d nodes : %zu in use, %d blocks",
+    NNODES, verify (vertices), vertices->blocks->n);
+
+  /* remove half of them in a random order */
+  srand (1);
+  int * order = malloc (NNODES * sizeof (int)), errors = 0;
+  for (int i = 0; i < NNODES; ++i)
+    order[i] = i;
+  for (int i = NNODES - 1; i > 0; --i)
+  {
+    int j = rand () % (i + 1), o = order[i];
+    order[i] = order[j];
+    order[j] = o;
+  }
+  for (int i = 0; i < NNODES/2; ++i)
+    errors += hmesh_node_remove (vertices, node[order[i]]);
+  /* removing twice is an error */
+  hmesh_error_flush ();
+  hmesh_error ("main () : expect an error in removing a node twice");
+  if (!hmesh_node_remove (vertices, node[order[0]]))
+    ++errors;
+  hmesh_error_flush ();
+
+  for (int i = NNODES/2; i < NNODES; ++i)
+    if (HMESH_SCALAR (vertices, is, node[order[i]]) != (Real) order[i])
+      ++errors;
+  fprintf (stdout, "\nremoved %d nodes  : %zu in use, %d blocks, errors %d",
+    NNODES/2, verify (vertices), vertices->blocks->n, errors);
+
+  /* remove the rest, and the empty blocks are returned */
+  for (int i = NNODES/2; i < NNODES; ++i)
+    errors += hmesh_node_remove (vertices, node[order[i]]);
+  fprintf (stdout, "\nremoved all nodes : %zu in use, %d blocks, errors %d",
+    verify (vertices), vertices->blocks->n, errors);
+
+  /* insert/remove rate, with NNODES/2 nodes in use */
+  int n = 0;
+  for (; n < NNODES/2; ++n)
+    node[n] = hmesh_node_new (vertices);
+  unsigned int seed = 1;
+  double start = now ();
+  for (int op = 0; op < NOPS; ++op)
+  {
+    seed = seed * 1103515245u + 12345u;
+    if ( (seed >> 16) & 1 )
+    {
+      if (n < NNODES)
+        node[n++] = hmesh_node_new (vertices);
+    }
+    else if (n)
+    {
+      int i = (seed >> 8) % n;
+      hmesh_node_remove (vertices, node[i]);
+      node[i] = node[--n];
+    }
+  }
+  double t = now () - start;
+  fprintf (stdout, "\ninsert/remove     : %.1f M ops/s (%zu in use)\n",
+    1e-6 * NOPS / t, verify (vertices));
+
+  free (node);
+  free (order);
+  hmesh_cells_destroy (vertices);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
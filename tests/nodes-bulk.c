@@ -0,0 +1,73 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include "now.h"
+
+/*
+.. Bulk allocation of nodes (hmesh_nodes_new ()) against allocating them one
+.. by one (hmesh_node_new ()). NNODES triangles are added to a surface mesh
+.. with 2 scalars. The nodes are verified to be distinct.
+*/
+
+#define NNODES (1<<22)
+
+static HmeshCells * triangles ()
+{
+  HmeshCells * cells = hmesh_cells (2, 2, 3);
+  hmesh_scalar_new (cells, "area");
+  hmesh_scalar_new (cells, "curvature");
+  return cells;
+}
+
+static int verify (HmeshCells * cells, Node * node)
+{
+  /* each node is marked once */
+  int errors = 0;
+  Index is = cells->min;
+  for (int i = 0; i < NNODES; ++i)
+    HMESH_SCALAR (cells, is, node[i]) = 0.;
+  for (int i = 0; i < NNODES; ++i)
+    if ( (HMESH_SCALAR (cells, is, node[i]) += 1.) != 1. )
+      ++errors;
+  return errors;
+}
+
+int main ()
+{
+  Node * node = malloc (NNODES * sizeof (Node));
+
+  HmeshCells * cells = triangles ();
+  double start = now ();
+  for (int i = 0; i < NNODES; ++i)
+    node[i] = hmesh_node_new (cells);
+  double t1 = now () - start;
+  fprintf (stdout, "\nhmesh_node_new ()  : %.1f M nodes/s, errors %d",
+    1e-6 * NNODES / t1, verify (cells, node));
+  hmesh_cells_destroy (cells);
+
+  cells = triangles ();
+  start = now ();
+  size_t n = hmesh_nodes_new (cells, NNODES, node);
+  double t2 = now () - start;
+  fprintf (stdout, "\nhmesh_nodes_new () : %.1f M nodes/s, errors %d",
+    1e-6 * NNODES / t2, (n != NNODES) + verify (cells, node));
+
+  /* bulk allocation after removals reuses the free slots first */
+  for (int i = 0; i < NNODES; i += 2)
+    hmesh_node_remove (cells, node[i]);
+  Index nblocks = cells->blocks->n;
+  n = hmesh_nodes_new (cells, NNODES/2, node);
+  fprintf (stdout, "\nrefill             : %zu nodes, blocks %d -> %d\n",
+    n, nblocks, cells->blocks->n);
+  hmesh_cells_destroy (cells);
+
+  free (node);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef _HMESH_TESTS_NOW_
+#define _HMESH_TESTS_NOW_
+
+#include <time.h>
+
+/*
+.. Common timer of the tests : wall clock time in seconds (monotonic clock).
+.. clock_gettime () needs _POSIX_C_SOURCE (or _GNU_SOURCE) defined before
+.. the includes of the test.
+*/
+
+static double now ()
+{
+  struct timespec t;
+  clock_gettime (CLOCK_MONOTONIC, &t);
+  return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,130 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include <unistd.h>
+
+#include "now.h"
+
+/*
+.. Parallel traversal of the blocks (hmesh_cells_foreach ()). An axpy,
+.. x += dt * u, and the reductions sum (x) and max (u) are run over the
+.. vertices with 1, 2, 4 .. threads (up to the number of processors). The
+.. results should be identical to that of 1 thread.
+*/
+
+#define NNODES (1<<22)
+#define NSWEEP 10
+
+static Index scalar (HmeshCells * cells, char * name)
+{
+  HmeshArray * s = hmesh_scalar_new (cells, name);
+  Index is = 0;
+  while (cells->attr[is] != s)
+    ++is;
+  return is;
+}
+
+typedef struct
+{
+  Index iu;
+  Real dt;
+} Axpy;
+
+static void axpy (HmeshCells * cells, Index iblk, void * data, Real * r)
+{
+  (void) r;
+  Axpy * a = (Axpy *) data;
+  Real * restrict x = HMESH_REAL (cells, 2, iblk),
+    * restrict u = HMESH_REAL (cells, a->iu, iblk);
+  for (int i = 0; i < HMESH_BLOCK_SIZE; ++i)
+    x[i] += a->dt * u[i];
+}
+
+static void sum (HmeshCells * cells, Index iblk, void * data, Real * r)
+{
+  (void) data;
+  Real * x = HMESH_REAL (cells, 2, iblk);
+  HMESH_FOREACH_INDEX (cells, iblk, i)
+    *r += x[i];
+}
+
+static void max (HmeshCells * cells, Index iblk, void * data, Real * r)
+{
+  Real * u = HMESH_REAL (cells, *(Index *) data, iblk);
+  HMESH_FOREACH_INDEX (cells, iblk, i)
+    if (u[i] > *r)
+      *r = u[i];
+}
+
+static void reset (HmeshCells * cells, Index iu)
+{
+  HMESH_FOREACH_BLOCK (cells, iblk)
+  {
+    Real * x = HMESH_REAL (cells, 2, iblk), * u = HMESH_REAL (cells, iu, iblk);
+    for (int i = 0; i < HMESH_BLOCK_SIZE; ++i)
+    {
+      x[i] = 0.;
+      u[i] = (Real) ((iblk + i) % 13);
+    }
+  }
+}
+
+int main ()
+{
+  HmeshCells * v = hmesh_cells (0, 2, 3);
+  Axpy a = { .iu = scalar (v, "u"), .dt = 0.5 };
+
+  Node * node = malloc (NNODES * sizeof (Node));
+  size_t n = hmesh_nodes_new (v, NNODES, node);
+  for (size_t i = 0; i < n; i += 8)
+    hmesh_node_remove (v, node[i]);
+  size_t m = n - (n + 7)/8;
+
+  /* invalid arguments */
+  hmesh_error_flush ();
+  hmesh_error ("main () : expect an error for a reduction without result");
+  int errors = !hmesh_cells_foreach (v, sum, NULL, HMESH_REDUCE_SUM, NULL);
+  hmesh_error_flush ();
+
+  long nproc = sysconf (_SC_NPROCESSORS_ONLN);
+  Real sum1 = 0., max1 = 0.;
+  for (int nthreads = 1; nthreads == 1 || nthreads <= nproc; nthreads *= 2)
+  {
+    hmesh_threads (nthreads);
+    reset (v, a.iu);
+    double start = now ();
+    for (int s = 0; s < NSWEEP; ++s)
+      errors += hmesh_cells_foreach (v, axpy, &a, HMESH_REDUCE_NONE, NULL);
+    double t = now () - start;
+
+    Real rsum, rmax;
+    start = now ();
+    errors += hmesh_cells_foreach (v, sum, NULL, HMESH_REDUCE_SUM, &rsum);
+    errors += hmesh_cells_foreach (v, max, &a.iu, HMESH_REDUCE_MAX, &rmax);
+    double tr = now () - start;
+    if (nthreads == 1)
+    {
+      sum1 = rsum;
+      max1 = rmax;
+    }
+    errors += (rsum != sum1) + (rmax != max1) + (rmax != (Real) 12.);
+
+    fprintf (stdout, "\nthreads %3d : axpy %6.3f ns/node, reductions "
+      "%6.3f ns/node, sum %g, max %g, errors %d", nthreads,
+      1e9 * t / NSWEEP / m, 1e9 * tr / 2 / m, (double) rsum, (double) rmax,
+      errors);
+  }
+  fprintf (stdout, "\n");
+
+  free (node);
+  hmesh_threads_destroy ();
+  hmesh_cells_destroy (v);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
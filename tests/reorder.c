@@ -0,0 +1,189 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include "now.h"
+
+/*
+.. Renumbering along a space filling curve (hmesh_reorder ()) of a closed
+.. (torus) mesh of 2 N^2 triangles, whose vertices and half edges are created
+.. in a random order (as in a remeshed surface). A sweep over the half edges
+.. scatters the value of the vertex 'sub.0' to the vertex 'sub.1' (edge based
+.. assembly). It's timed before, and after the Morton and Hilbert renumbering.
+.. The sum (of the squares of the assembled values) and the connectivity
+.. (twin of twin, next of next of next, vertices of twins) should be the same.
+*/
+
+#define N      1024
+#define NSWEEP 5
+
+static void shuffle (Node * node, size_t n)
+{
+  for (size_t i = n - 1; i > 0; --i)
+  {
+    size_t j = ((size_t) rand () * RAND_MAX + rand ()) % (i + 1);
+    Node o = node[i];
+    node[i] = node[j];
+    node[j] = o;
+  }
+}
+
+/* half edge 's' of the triangle 't' of the quad (i,j) (periodic) */
+static size_t he (long i, long j, int t, int s)
+{
+  i = (i + N) % N;
+  j = (j + N) % N;
+  return ((i*N + j)*2 + t)*3 + s;
+}
+
+static int same (Node a, Node b)
+{
+  return a.index == b.index && a.iblock == b.iblock;
+}
+
+/* scatter x.x of 'sub.0' to 'acc' of 'sub.1' over all the half edges */
+static double sweep (HmeshCells * v, HmeshCells * e, Index iacc)
+{
+  HMESH_FOREACH_BLOCK (v, iblk)
+  {
+    Real * acc = HMESH_REAL (v, iacc, iblk);
+    for (int i = 0; i < HMESH_BLOCK_SIZE; ++i)
+      acc[i] = 0.;
+  }
+  HMESH_FOREACH_BLOCK (e, iblk)
+  {
+    Node * a = (Node *) HMESH_ATTR (e, 2, iblk),
+      * b = (Node *) HMESH_ATTR (e, 3, iblk);
+    HMESH_FOREACH_INDEX (e, iblk, i)
+      HMESH_SCALAR (v, iacc, b[i]) += HMESH_SCALAR (v, 2, a[i]);
+  }
+  double sum = 0.;
+  HMESH_FOREACH_BLOCK (v, iblk)
+  {
+    Real * acc = HMESH_REAL (v, iacc, iblk);
+    HMESH_FOREACH_INDEX (v, iblk, i)
+      sum += acc[i] * acc[i];
+  }
+  return sum;
+}
+
+/* number of the half edges with a broken connectivity */
+static int verify (HmeshCells * e)
+{
+  int errors = 0;
+  HMESH_FOREACH_BLOCK (e, iblk)
+    HMESH_FOREACH_INDEX (e, iblk, i)
+    {
+      Node x = { .index = i, .iblock = iblk }, t = HMESH_TWIN (e, x),
+        n = HMESH_NEXT (e, x);
+      n = HMESH_NEXT (e, n);
+      n = HMESH_NEXT (e, n);
+      if ( !same (HMESH_TWIN (e, t), x) || !same (n, x) ||
+           !same (HMESH_IVERTEX (e, t, 0), HMESH_IVERTEX (e, x, 1)) ||
+           !same (HMESH_IVERTEX (e, t, 1), HMESH_IVERTEX (e, x, 0)) )
+        ++errors;
+    }
+  return errors;
+}
+
+int main ()
+{
+  Hmesh * h = hmesh (2, 3);
+  HmeshCells * v = h->p, * e = h->e;
+  size_t nv = (size_t) N * N, ne = 6 * nv;
+  hmesh_scalar_new (v, "acc");
+  Index iacc = hmesh_scalar_get (v, "acc");
+
+  Node * vertex = malloc (nv * sizeof (Node)),
+    * edge = malloc (ne * sizeof (Node));
+  srand (1);
+  hmesh_nodes_new (v, nv, vertex);
+  hmesh_nodes_new (e, ne, edge);
+  shuffle (vertex, nv);
+  shuffle (edge, ne);
+
+  /* torus, with exact (integer) values of x.x */
+  for (long i = 0; i < N; ++i)
+    for (long j = 0; j < N; ++j)
+    {
+      Node p = vertex[i*N + j];
+      HMESH_SCALAR (v, 2, p) = (Real) ((i * 7 + j * 13) % 100);
+      HMESH_SCALAR (v, 3, p) = (Real) i;
+      HMESH_SCALAR (v, 4, p) = (Real) j;
+    }
+
+  /*
+  .. quad (i,j) : A = (p00, p10, p11), B = (p00, p11, p01). Twins :
+  .. A0 - B1 of (i,j-1), A1 - B2 of (i+1,j), A2 - B0
+  */
+  for (long i = 0; i < N; ++i)
+    for (long j = 0; j < N; ++j)
+    {
+      Node p[4] = { vertex[i*N + j], vertex[((i + 1) % N)*N + j],
+        vertex[((i + 1) % N)*N + (j + 1) % N], vertex[i*N + (j + 1) % N] };
+      int tv[2][3] = { {0, 1, 2}, {0, 2, 3} };
+      for (int t = 0; t < 2; ++t)
+        for (int s = 0; s < 3; ++s)
+        {
+          Node x = edge [he (i, j, t, s)];
+          HMESH_IVERTEX (e, x, 0) = p [tv[t][s]];
+          HMESH_IVERTEX (e, x, 1) = p [tv[t][(s + 1) % 3]];
+          HMESH_NEXT (e, x) = edge [he (i, j, t, (s + 1) % 3)];
+        }
+      HMESH_TWIN (e, edge [he (i, j, 0, 0)]) = edge [he (i, j - 1, 1, 1)];
+      HMESH_TWIN (e, edge [he (i, j - 1, 1, 1)]) = edge [he (i, j, 0, 0)];
+      HMESH_TWIN (e, edge [he (i, j, 0, 1)]) = edge [he (i + 1, j, 1, 2)];
+      HMESH_TWIN (e, edge [he (i + 1, j, 1, 2)]) = edge [he (i, j, 0, 1)];
+      HMESH_TWIN (e, edge [he (i, j, 0, 2)]) = edge [he (i, j, 1, 0)];
+      HMESH_TWIN (e, edge [he (i, j, 1, 0)]) = edge [he (i, j, 0, 2)];
+    }
+  free (edge);
+  free (vertex);
+
+  /* a permutation with a repeated node is rejected */
+  Node twice[2];
+  HmeshCells * c = hmesh_cells (0, 0, 1);
+  hmesh_nodes_new (c, 2, twice);
+  twice[1] = twice[0];
+  hmesh_error_flush ();
+  hmesh_error ("main () : expect an error for a repeated node");
+  int errors = !hmesh_cells_reorder (c, twice, 2, NULL);
+  hmesh_error_flush ();
+  hmesh_cells_destroy (c);
+
+  const char * name[3] = { "random", "Morton", "Hilbert" };
+  double ref = 0.;
+  for (int r = 0; r < 3; ++r)
+  {
+    double treorder = 0., start;
+    if (r)
+    {
+      start = now ();
+      errors += hmesh_reorder (h, r == 1 ? HMESH_CURVE_MORTON :
+        HMESH_CURVE_HILBERT);
+      treorder = now () - start;
+    }
+    double sum = 0.;
+    start = now ();
+    for (int s = 0; s < NSWEEP; ++s)
+      sum = sweep (v, e, iacc);
+    double t = (now () - start) / NSWEEP;
+    if (!r)
+      ref = sum;
+    errors += (sum != ref) + verify (e);
+    fprintf (stdout, "\n%-7s : sweep %6.2f ns/half edge, reorder %6.1f "
+      "ns/half edge, sum %g, errors %d", name[r], 1e9 * t / ne,
+      1e9 * treorder / ne, sum, errors);
+  }
+  fprintf (stdout, "\nblocks : vertices %d, half edges %d\n", v->blocks->n,
+    e->blocks->n);
+
+  hmesh_destroy (h);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
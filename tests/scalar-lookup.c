@@ -0,0 +1,117 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include "now.h"
+
+/*
+.. Lookup of attributes by name (hmesh_scalar_get ()). Attributes are added
+.. up to HMESH_MAX_NVARS, removed and added again, while the index of each
+.. name is verified. The lookup is compared with a linear scan (strcmp) of
+.. all the attributes. Names starting with '_' should be rejected.
+*/
+
+#define NLOOKUP (1<<20)
+
+/* verify the index of each attribute in use */
+static int verify (HmeshCells * cells)
+{
+  int errors = 0;
+  for (Index i = 0; i < cells->scalars.n; ++i)
+  {
+    Index iattr = cells->scalars.info[i].in_use;
+    if (hmesh_scalar_get (cells, ((HmeshArray *) cells->attr[iattr])->name)
+        != iattr)
+      ++errors;
+  }
+  return errors;
+}
+
+static Index linear (HmeshCells * cells, char * name)
+{
+  for (Index i = 0; i < cells->scalars.n; ++i)
+  {
+    Index iattr = cells->scalars.info[i].in_use;
+    if (!strcmp (((HmeshArray *) cells->attr[iattr])->name, name))
+      return iattr;
+  }
+  return HMESH_INDEX_NULL;
+}
+
+int main ()
+{
+  HmeshCells * v = hmesh_cells (0, 2, 3);
+  int errors = (hmesh_scalar_get (v, "x.x") != 2) +
+    (hmesh_scalar_get (v, "x.z") != 4) +
+    (hmesh_scalar_get (v, "indirection_map") != 0) +
+    (hmesh_scalar_get (v, "nothing") != HMESH_INDEX_NULL);
+
+  /* a typed attribute in SoA, and the scalar of the same name */
+  HmeshAttr p;
+  errors += hmesh_attr_new (v, "p", HMESH_TYPE_VEC3, HMESH_LAYOUT_SOA, &p);
+  errors += (hmesh_scalar_get (v, "p.y") != p.iattr[1]);
+  hmesh_error_flush ();
+  hmesh_error ("main () : expect an error for an existing name 'p'");
+  errors += (hmesh_scalar_new (v, "p") != NULL);
+  hmesh_error_flush ();
+  errors += hmesh_attr_remove (v, &p);
+
+  /* names starting with '_' are reserved for the library */
+  hmesh_error ("main () : expect an error for a reserved name '_key'");
+  errors += (hmesh_scalar_new (v, "_key") != NULL) +
+    !hmesh_attr_new (v, "_p", HMESH_TYPE_VEC2, HMESH_LAYOUT_SOA, &p);
+  hmesh_error_flush ();
+
+  /* fill all the attributes */
+  char name [HMESH_MAX_VARNAME + 1];
+  int n = 0;
+  for (;; ++n)
+  {
+    sprintf (name, "s%d", n);
+    if (!hmesh_scalar_new (v, name))
+      break;
+  }
+  hmesh_error_flush ();
+  errors += (v->scalars.n != HMESH_MAX_NVARS) + verify (v);
+  fprintf (stdout, "\n%d scalars added (%d attributes), errors %d", n,
+    v->scalars.n, errors);
+
+  /* remove half of them, and add them again in the reverse order */
+  for (int i = 0; i < n; i += 2)
+  {
+    sprintf (name, "s%d", i);
+    errors += hmesh_scalar_remove (v, name);
+    errors += (hmesh_scalar_get (v, name) != HMESH_INDEX_NULL);
+  }
+  errors += verify (v);
+  for (int i = n - 1 - (n - 1) % 2; i >= 0; i -= 2)
+  {
+    sprintf (name, "t%d", i);
+    errors += (hmesh_scalar_new (v, name) == NULL);
+  }
+  errors += verify (v);
+  fprintf (stdout, "\nremoved/added %d scalars, errors %d", (n + 1)/2,
+    errors);
+
+  /* lookup of the last scalar added */
+  Index is = 0;
+  double start = now ();
+  for (int i = 0; i < NLOOKUP; ++i)
+    is += hmesh_scalar_get (v, name);
+  double thash = now () - start;
+  start = now ();
+  for (int i = 0; i < NLOOKUP; ++i)
+    is -= linear (v, name);
+  double tlinear = now () - start;
+  fprintf (stdout, "\nlookup '%s' : hash %.1f ns, linear %.1f ns, errors %d\n",
+    name, 1e9 * thash / NLOOKUP, 1e9 * tlinear / NLOOKUP, errors + (is != 0));
+
+  hmesh_cells_destroy (v);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
@@ -0,0 +1,122 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include "now.h"
+
+/*
+.. Scalars of 32 bits (hmesh_scalar_new_precision ()) along with the
+.. position in Real. A sweep (sum) and an update (s += c x.x) of a scalar of
+.. 32 bits are compared with that of 64 bits. Values of the 32 bit scalar
+.. should be preserved by a compaction.
+*/
+
+#define NNODES (1<<22)
+#define NSWEEP 10
+
+static Index index_of (HmeshCells * cells, HmeshArray * s)
+{
+  Index is = 0;
+  while (cells->attr[is] != s)
+    ++is;
+  return is;
+}
+
+int main ()
+{
+  HmeshCells * v = hmesh_cells (0, 2, 3);
+  HmeshArray * f = hmesh_scalar_new_precision (v, "curvature", 32),
+    * d = hmesh_scalar_new_precision (v, "quality", 64);
+  Index is32 = index_of (v, f), is64 = index_of (v, d);
+  int errors = (f->obj_size != 4) + (d->obj_size != 8);
+
+  /* only 32 or 64 bits */
+  hmesh_error_flush ();
+  hmesh_error ("main () : expect an error for a scalar of 16 bits");
+  errors += hmesh_scalar_new_precision (v, "half", 16) != NULL;
+  hmesh_error_flush ();
+
+  Node * node = malloc (NNODES * sizeof (Node));
+  hmesh_nodes_new (v, NNODES, node);
+  for (int i = 0; i < NNODES; ++i)
+  {
+    HMESH_SCALAR (v, 2, node[i]) = (Real) (i % 100);
+    HMESH_SCALAR_F32 (v, is32, node[i]) = (float) (i % 10);
+    HMESH_SCALAR_F64 (v, is64, node[i]) = (double) (i % 10);
+  }
+
+  /* sweep over all the slots */
+  double sum32 = 0., sum64 = 0., start = now ();
+  for (int s = 0; s < NSWEEP; ++s)
+    HMESH_FOREACH_BLOCK (v, iblk)
+    {
+      float * x = HMESH_F32 (v, is32, iblk);
+      float sum = 0.;
+      for (int i = 0; i < HMESH_BLOCK_SIZE; ++i)
+        sum += x[i];
+      sum32 += sum;
+    }
+  double t32 = now () - start;
+  start = now ();
+  for (int s = 0; s < NSWEEP; ++s)
+    HMESH_FOREACH_BLOCK (v, iblk)
+    {
+      double * x = HMESH_F64 (v, is64, iblk);
+      double sum = 0.;
+      for (int i = 0; i < HMESH_BLOCK_SIZE; ++i)
+        sum += x[i];
+      sum64 += sum;
+    }
+  double t64 = now () - start;
+  errors += (sum32 != sum64);
+  fprintf (stdout, "\nsum    : 32 bits %6.3f ns/node, 64 bits %6.3f ns/node",
+    1e9 * t32 / NSWEEP / NNODES, 1e9 * t64 / NSWEEP / NNODES);
+
+  /* update from the position */
+  start = now ();
+  for (int s = 0; s < NSWEEP; ++s)
+    HMESH_FOREACH_BLOCK (v, iblk)
+    {
+      float * restrict y = HMESH_F32 (v, is32, iblk);
+      Real * restrict x = HMESH_REAL (v, 2, iblk);
+      for (int i = 0; i < HMESH_BLOCK_SIZE; ++i)
+        y[i] += 0.5f * (float) x[i];
+    }
+  t32 = now () - start;
+  start = now ();
+  for (int s = 0; s < NSWEEP; ++s)
+    HMESH_FOREACH_BLOCK (v, iblk)
+    {
+      double * restrict y = HMESH_F64 (v, is64, iblk);
+      Real * restrict x = HMESH_REAL (v, 2, iblk);
+      for (int i = 0; i < HMESH_BLOCK_SIZE; ++i)
+        y[i] += 0.5 * (double) x[i];
+    }
+  t64 = now () - start;
+  fprintf (stdout, "\nupdate : 32 bits %6.3f ns/node, 64 bits %6.3f ns/node",
+    1e9 * t32 / NSWEEP / NNODES, 1e9 * t64 / NSWEEP / NNODES);
+
+  /* compaction moves 4 bytes of the 32 bit scalar */
+  for (int i = 0; i < NNODES; ++i)
+    HMESH_SCALAR_F32 (v, is32, node[i]) = (float) i;
+  for (int i = 0; i < NNODES; i += 2)
+    hmesh_node_remove (v, node[i]);
+  HmeshRemap remap;
+  errors += hmesh_cells_compact (v, &remap);
+  for (int i = 1; i < NNODES; i += 2)
+    if ( HMESH_SCALAR_F32 (v, is32, hmesh_remap_node (&remap, node[i]))
+         != (float) i )
+      ++errors;
+  hmesh_remap_free (&remap);
+  fprintf (stdout, "\nerrors %d\n", errors);
+
+  free (node);
+  hmesh_cells_destroy (v);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
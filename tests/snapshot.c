@@ -0,0 +1,158 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include <pthread.h>
+
+#include "now.h"
+
+/*
+.. Copy-on-write snapshots (hmesh_cells_snapshot ()). A snapshot of the
+.. vertices is compared with a deep copy of all the blocks. A fraction of
+.. the blocks is then written (HMESH_WRITE ()) and some vertices are
+.. removed, while another thread reads the snapshot (as a checkpoint). The
+.. snapshot should be unchanged, and only the blocks written are copied.
+.. Rollback to the snapshot should give the initial values. A write through
+.. the accessor of a node (HMESH_SCALAR_W ()) should not modify the snapshot,
+.. and once the snapshot is destroyed, the cells are written in place. No
+.. block should remain in use, once all the cells are destroyed.
+*/
+
+#define NNODES (1<<22)
+#define NWRITE 16
+
+static size_t used ()
+{
+  HmeshTpoolStats stats;
+  hmesh_tpool_stats (&stats);
+  return stats.used;
+}
+
+/* sum of 'u' over the nodes in use */
+static void * checksum (void * c)
+{
+  HmeshCells * cells = (HmeshCells *) c;
+  Index iu = hmesh_scalar_get (cells, "u");
+  double * sum = malloc (sizeof (double));
+  *sum = 0.;
+  HMESH_FOREACH_BLOCK (cells, iblk)
+  {
+    Real * u = HMESH_REAL (cells, iu, iblk);
+    HMESH_FOREACH_INDEX (cells, iblk, i)
+      *sum += u[i];
+  }
+  return sum;
+}
+
+static double sum_of (HmeshCells * cells)
+{
+  double * s = checksum (cells), sum = *s;
+  free (s);
+  return sum;
+}
+
+int main ()
+{
+  size_t used0 = used ();
+  HmeshCells * v = hmesh_cells (0, 2, 3);
+  hmesh_scalar_new (v, "u");
+  Index iu = hmesh_scalar_get (v, "u");
+  Node * node = malloc (NNODES * sizeof (Node));
+  hmesh_nodes_new (v, NNODES, node);
+  for (int i = 0; i < NNODES; ++i)
+    HMESH_SCALAR (v, iu, node[i]) = (Real) (i % 100);
+  double sum0 = sum_of (v);
+  size_t bytes = used () - used0;
+
+  /* deep copy of all the blocks, for comparison */
+  double start = now ();
+  char * copy = malloc (bytes), * c = copy;
+  for (Index i = 0; i < v->scalars.n; ++i)
+  {
+    Index iattr = v->scalars.info[i].in_use;
+    size_t size = ((HmeshArray *) v->attr[iattr])->obj_size *
+      hmesh_tpool_block_size ();
+    HMESH_FOREACH_BLOCK (v, iblk)
+    {
+      memcpy (c, HMESH_ATTR (v, iattr, iblk), size);
+      c += size;
+    }
+  }
+  double tcopy = now () - start;
+  free (copy);
+
+  start = now ();
+  HmeshCells * snap = hmesh_cells_snapshot (v);
+  double tsnap = now () - start;
+  int errors = (used () - used0 != bytes);
+
+  /* checkpoint of the snapshot in a thread, while 'v' is modified */
+  pthread_t thread;
+  pthread_create (&thread, NULL, checksum, snap);
+  size_t before = used (), bsize = hmesh_tpool_block_size ();
+  Index nwritten = 0;
+  HMESH_FOREACH_BLOCK (v, iblk)
+    if (!(iblk % NWRITE))
+    {
+      Real * u = (Real *) HMESH_WRITE (v, iu, iblk);
+      for (size_t i = 0; i < bsize; ++i)
+        u[i] += 1.;
+      ++nwritten;
+    }
+  /* removal writes map & imap of the block */
+  for (int i = 0; i < NNODES; i += 2 * bsize)
+    errors += hmesh_node_remove (v, node[i]);
+  size_t copied = used () - before;
+  void * result;
+  pthread_join (thread, &result);
+  errors += (*(double *) result != sum0) + (sum_of (snap) != sum0);
+  free (result);
+
+  /* only 'u' of the blocks written, and map & imap of the blocks removed */
+  size_t expected = nwritten * bsize * sizeof (Real) +
+    (NNODES / (2 * bsize)) * 2 * bsize * sizeof (Index);
+  errors += (copied != expected) + (sum_of (v) == sum0);
+
+  fprintf (stdout, "\n%d nodes, %zu MB : deep copy %.3f ms, snapshot %.3f ms",
+    NNODES, bytes >> 20, 1e3 * tcopy, 1e3 * tsnap);
+  fprintf (stdout, "\n%d blocks written : %zu KB copied, errors %d",
+    nwritten, copied >> 10, errors);
+
+  /* rollback */
+  hmesh_cells_destroy (v);
+  v = hmesh_cells_snapshot (snap);
+  errors += (sum_of (v) != sum0);
+  Real * u = (Real *) HMESH_WRITE (v, iu, node[0].iblock);
+  u[node[0].index] = 1000.;
+  errors += (sum_of (snap) != sum0) + (sum_of (v) != sum0 + 1000.);
+  fprintf (stdout, "\nrollback : errors %d", errors);
+
+  /* the read accessor of a node copies nothing */
+  before = used ();
+  errors += (HMESH_SCALAR (v, iu, node[bsize]) !=
+    HMESH_SCALAR (snap, iu, node[bsize])) + (used () != before);
+
+  /* the write accessor of a node copies the block shared */
+  HMESH_SCALAR_W (v, iu, node[1]) += 2000.;
+  errors += (sum_of (snap) != sum0) + (sum_of (v) != sum0 + 3000.);
+  hmesh_cells_destroy (snap);
+  before = used ();
+  HMESH_SCALAR_W (v, iu, node[bsize]) += 1.;
+  errors += (v->shared != 0) + (used () != before) +
+    (sum_of (v) != sum0 + 3001.);
+  fprintf (stdout, "\nnode write : shared %d, errors %d", v->shared, errors);
+
+  hmesh_cells_destroy (v);
+  errors += (used () != used0);
+  fprintf (stdout, "\ndestroyed : %zu bytes in use, errors %d\n",
+    used () - used0, errors);
+
+  free (node);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
@@ -0,0 +1,205 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include "now.h"
+
+/*
+.. Vertex star iteration over a closed (torus) surface of 2 N^2 triangles.
+.. The vertices and the half edges are created in a random order (as in a
+.. remeshed surface). For each vertex, the positions of the neighbours are
+.. summed by walking the half edges of its star, starting from a worklist of
+.. one outgoing half edge per vertex :
+.. (a) plain walk, e = next (twin (e))
+.. (b) HMESH_FOREACH_STAR (), with the worklist item PDIST ahead prefetched
+..     (the hops of a star cannot be prefetched ahead)
+.. (c) HMESH_FOREACH_STARS () : HMESH_STAR_BATCH stars are walked at once
+.. (d) as (c), after sorting the worklist by (iblock, index)
+.. All should give the same sum (of the squares of the laplacian of x.x).
+*/
+
+#define N     2237
+#define PDIST 8
+
+static void shuffle (Node * node, size_t n)
+{
+  for (size_t i = n - 1; i > 0; --i)
+  {
+    size_t j = ((size_t) rand () * RAND_MAX + rand ()) % (i + 1);
+    Node o = node[i];
+    node[i] = node[j];
+    node[j] = o;
+  }
+}
+
+/* half edge 's' of the triangle 't' of the quad (i,j) (periodic) */
+static size_t he (long i, long j, int t, int s)
+{
+  i = (i + N) % N;
+  j = (j + N) % N;
+  return ((i*N + j)*2 + t)*3 + s;
+}
+
+/* star of each vertex of the worklist */
+static double star_plain (HmeshCells * v, HmeshCells * e, Node * work,
+  size_t n)
+{
+  double sum = 0.;
+  for (size_t w = 0; w < n; ++w)
+  {
+    Node s = work[w], h = s;
+    Real x = 0.;
+    do
+    {
+      x += HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, h, 1));
+      h = HMESH_NEXT (e, HMESH_TWIN (e, h));
+    } while (h.index != s.index || h.iblock != s.iblock);
+    {
+      Real l = x - 6. * HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, s, 0));
+      sum += l * l;
+    }
+  }
+  return sum;
+}
+
+static double star_prefetch (HmeshCells * v, HmeshCells * e, Node * work,
+  size_t n)
+{
+  double sum = 0.;
+  for (size_t w = 0; w < n; ++w)
+  {
+    if (w + PDIST < n)
+    {
+      HMESH_PREFETCH_NODE (e, 2, work[w + PDIST]);
+      HMESH_PREFETCH_NODE (e, 3, work[w + PDIST]);
+      HMESH_PREFETCH_NODE (e, e->k + 4, work[w + PDIST]);
+    }
+    Node s = work[w];
+    Real x = 0.;
+    HMESH_FOREACH_STAR (e, s, h)
+      x += HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, h, 1));
+    {
+      Real l = x - 6. * HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, s, 0));
+      sum += l * l;
+    }
+  }
+  return sum;
+}
+
+static double star_batch (HmeshCells * v, HmeshCells * e, Node * work,
+  size_t n, Real * x)
+{
+  for (size_t w = 0; w < n; ++w)
+    x[w] = 0.;
+  HMESH_FOREACH_STARS (e, work, n, s)
+    x[s.w] += HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, s.e, 1));
+  double sum = 0.;
+  for (size_t w = 0; w < n; ++w)
+  {
+    Real l = x[w] - 6. * HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, work[w], 0));
+    sum += l * l;
+  }
+  return sum;
+}
+
+int main ()
+{
+  Hmesh * h = hmesh (2, 3);
+  HmeshCells * v = h->p, * e = h->e;
+  size_t nv = (size_t) N * N, ne = 6 * nv;
+
+  Node * vertex = malloc (nv * sizeof (Node)),
+    * edge = malloc (ne * sizeof (Node));
+  srand (1);
+  hmesh_cells_reserve (v, nv);
+  hmesh_cells_reserve (e, ne);
+  hmesh_nodes_new (v, nv, vertex);
+  hmesh_nodes_new (e, ne, edge);
+  shuffle (vertex, nv);
+  shuffle (edge, ne);
+  for (size_t i = 0; i < nv; ++i)
+    HMESH_SCALAR (v, 2, vertex[i]) = (Real) (i % 1000);
+
+  /*
+  .. quad (i,j) : A = (p00, p10, p11), B = (p00, p11, p01). Twins :
+  .. A0 - B1 of (i,j-1), A1 - B2 of (i+1,j), A2 - B0
+  */
+  for (long i = 0; i < N; ++i)
+    for (long j = 0; j < N; ++j)
+    {
+      Node p[4] = { vertex[i*N + j], vertex[((i + 1) % N)*N + j],
+        vertex[((i + 1) % N)*N + (j + 1) % N], vertex[i*N + (j + 1) % N] };
+      int tv[2][3] = { {0, 1, 2}, {0, 2, 3} };
+      for (int t = 0; t < 2; ++t)
+        for (int s = 0; s < 3; ++s)
+        {
+          Node x = edge [he (i, j, t, s)];
+          HMESH_IVERTEX (e, x, 0) = p [tv[t][s]];
+          HMESH_IVERTEX (e, x, 1) = p [tv[t][(s + 1) % 3]];
+          HMESH_NEXT (e, x) = edge [he (i, j, t, (s + 1) % 3)];
+        }
+      HMESH_TWIN (e, edge [he (i, j, 0, 0)]) = edge [he (i, j - 1, 1, 1)];
+      HMESH_TWIN (e, edge [he (i, j - 1, 1, 1)]) = edge [he (i, j, 0, 0)];
+      HMESH_TWIN (e, edge [he (i, j, 0, 1)]) = edge [he (i + 1, j, 1, 2)];
+      HMESH_TWIN (e, edge [he (i + 1, j, 1, 2)]) = edge [he (i, j, 0, 1)];
+      HMESH_TWIN (e, edge [he (i, j, 0, 2)]) = edge [he (i, j, 1, 0)];
+      HMESH_TWIN (e, edge [he (i, j, 1, 0)]) = edge [he (i, j, 0, 2)];
+    }
+
+  /* worklist : A0 of quad (i,j) goes out of the vertex (i,j) */
+  Node * work = malloc (nv * sizeof (Node));
+  for (long i = 0; i < N; ++i)
+    for (long j = 0; j < N; ++j)
+      work[i*N + j] = edge [he (i, j, 0, 0)];
+  free (edge);
+
+  double start = now ();
+  double s1 = star_plain (v, e, work, nv);
+  double t1 = now () - start;
+
+  start = now ();
+  double s2 = star_prefetch (v, e, work, nv);
+  double t2 = now () - start;
+
+  Real * x = malloc (nv * sizeof (Real));
+  start = now ();
+  double s3 = star_batch (v, e, work, nv, x);
+  double t3 = now () - start;
+
+  start = now ();
+  int errors = hmesh_nodes_sort (work, nv);
+  double ts = now () - start;
+  for (size_t i = 1; i < nv; ++i)
+    if ( work[i].iblock < work[i-1].iblock ||
+         (work[i].iblock == work[i-1].iblock &&
+          work[i].index <= work[i-1].index) )
+      ++errors;
+
+  start = now ();
+  double s4 = star_batch (v, e, work, nv, x);
+  double t4 = now () - start;
+
+  fprintf (stdout, "\n%zu triangles, %zu vertices", 2 * nv, nv);
+  fprintf (stdout, "\n(a) plain walk     : %6.1f ns/vertex, sum %g",
+    1e9 * t1 / nv, s1);
+  fprintf (stdout, "\n(b) item prefetch  : %6.1f ns/vertex, sum %g",
+    1e9 * t2 / nv, s2);
+  fprintf (stdout, "\n(c) batch          : %6.1f ns/vertex, sum %g",
+    1e9 * t3 / nv, s3);
+  fprintf (stdout, "\n(d) sorted + batch : %6.1f ns/vertex, sum %g "
+    "(sort %.1f ns/vertex)", 1e9 * t4 / nv, s4, 1e9 * ts / nv);
+  fprintf (stdout, "\nerrors %d\n",
+    errors + (s1 != s2) + (s1 != s3) + (s1 != s4));
+
+  free (x);
+  free (work);
+  free (vertex);
+  hmesh_destroy (h);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+
+#include "now.h"
+
+/*
+.. Benchmark of hmesh_tpool_address (). Pages are allocated across more than
+.. 8 trees (the limit of the 16 bit block ID). The cost per lookup of decoding
+.. a 32 bit BlockID is compared against the decode of the 16 bit block ID
+.. (address16 (), which reads the depth from the flags of the tree), and
+.. against loading the address from a table of pointers.
+*/
+
+#define NBLOCKS  20000
+#define NLOOKUPS (1<<24)
+
+/*
+.. hmesh_tpool_address () of the 16 bit block ID (13 bits of node, and the
+.. tree above), over a copy of the trees, as the 16 bit ID cannot address
+.. more than 8 trees
+*/
+static void * address16 (HmeshTpool * tree, unsigned int ntrees,
+  unsigned int blockID)
+{
+  unsigned int itree = blockID >> 13, inode = blockID & 8191;
+  if ( ! (itree < ntrees && inode < 4096) )
+    return NULL;
+  unsigned int depth = tree[itree].flags[inode] & 7,
+    h     = 1 << depth,
+    H     = 1 << HMESH_TREE_POOL_DEPTH,
+    D     = 1 << (HMESH_TREE_POOL_DEPTH - depth),
+    index = inode & ((1 << (HMESH_TREE_POOL_DEPTH + 1)) - 1),
+    iroot = inode >> (HMESH_TREE_POOL_DEPTH + 1);
+  return (void *) ( (char *) tree[itree].root +
+    (size_t) (iroot*H + (index - h + 1)*D) * HMESH_PAGE_SIZE);
+}
+
+int main ()
+{
+  BlockID * id = malloc (NBLOCKS * sizeof (BlockID));
+  unsigned int * id16 = malloc (NBLOCKS * sizeof (unsigned int));
+  void ** ptr = malloc (NBLOCKS * sizeof (void *));
+  unsigned int * order = malloc (NLOOKUPS * sizeof (unsigned int));
+
+  for (int i = 0; i < NBLOCKS; ++i)
+  {
+    id[i] = hmesh_tpool_allocate_page ();
+    ptr[i] = hmesh_tpool_address (id[i]);
+    if (!ptr[i])
+      hmesh_error ("main () : cannot allocate block %d", i);
+  }
+  int ntrees = 0;
+  while (hmesh_tpool_tree (ntrees))
+    ++ntrees;
+  fprintf (stdout, "\n%d blocks in %d trees", NBLOCKS, ntrees);
+  HmeshTpool * tree = malloc (ntrees * sizeof (HmeshTpool));
+  for (int i = 0; i < ntrees; ++i)
+    tree[i] = *hmesh_tpool_tree (i);
+  for (int i = 0; i < NBLOCKS; ++i)
+    id16[i] = ((id[i] >> HMESH_TPOOL_TREE_SHIFT) << 13) |
+      (id[i] & HMESH_TPOOL_NODE_MASK);
+
+  unsigned int seed = 1;
+  for (int i = 0; i < NLOOKUPS; ++i)
+  {
+    seed = seed * 1103515245u + 12345u;
+    order[i] = (seed >> 8) % NBLOCKS;
+  }
+
+  size_t sum = 0;
+  double start = now ();
+  for (int i = 0; i < NLOOKUPS; ++i)
+    sum += (size_t) hmesh_tpool_address (id[order[i]]);
+  double tid = now () - start;
+
+  start = now ();
+  for (int i = 0; i < NLOOKUPS; ++i)
+    sum -= (size_t) address16 (tree, ntrees, id16[order[i]]);
+  double t16 = now () - start;
+
+  start = now ();
+  for (int i = 0; i < NLOOKUPS; ++i)
+    sum += (size_t) ptr[order[i]];
+  double tptr = now () - start;
+
+  start = now ();
+  for (int i = 0; i < NLOOKUPS; ++i)
+    sum -= (size_t) hmesh_tpool_address (id[order[i]]);
+
+  fprintf (stdout, "\nhmesh_tpool_address () : %.2f ns/lookup"
+    "\n16 bit block ID decode : %.2f ns/lookup"
+    "\npointer table          : %.2f ns/lookup"
+    "\nchecksum (expect 0)    : %zu\n",
+    1e9 * tid / NLOOKUPS, 1e9 * t16 / NLOOKUPS, 1e9 * tptr / NLOOKUPS, sum);
+
+  for (int i = 0; i < NBLOCKS; ++i)
+    hmesh_tpool_deallocate (id[i]);
+
+  free (tree);
+  free (id16);
+  free (id);
+  free (ptr);
+  free (order);
+
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
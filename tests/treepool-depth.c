@@ -0,0 +1,143 @@
+#include <common.h>
+#include <tree-pool.h>
+
+/*
+.. Allocation and coalescing at every level of the tree. Compile the
+.. library and the test with a different depth, to test it, as in
+.. CFLAGS=-DHMESH_TREE_POOL_DEPTH=5 make treepool-depth.tst
+.. (after a 'make clean' in src/).
+..
+.. (a) For each depth 'd', 2^d blocks of depth 'd' should tile the first root
+.. chunk of the tree. Once deallocated (in a random order), the blocks
+.. should coalesce back to the root.
+.. (b) Blocks of random depth are allocated/deallocated. Once all of them
+.. are deallocated, every committed root chunk should be free.
+*/
+
+#define NSTACK 256
+#define NOPS   (1<<16)
+
+static size_t size_of (int depth)
+{
+  return hmesh_tpool_block_size () << (HMESH_TREE_POOL_DEPTH - depth);
+}
+
+static int coalesced ()
+{
+  HmeshTpool * tree = hmesh_tpool_tree (0);
+  size_t maxnodes = 1 << (HMESH_TREE_POOL_DEPTH + 1);
+  for (size_t j = 0; j < tree->next; ++j)
+    if (tree->flags [j * maxnodes] != 128)
+      return 0;
+  return !tree->nused;
+}
+
+static void shuffle (BlockID * block, int n)
+{
+  for (int i = n - 1; i > 0; --i)
+  {
+    int j = rand () % (i + 1);
+    BlockID b = block[i];
+    block[i] = block[j];
+    block[j] = b;
+  }
+}
+
+int main ()
+{
+  if (hmesh_tpool_depth () != HMESH_TREE_POOL_DEPTH)
+  {
+    hmesh_error ("main () : library is compiled with depth %d, not %d",
+      hmesh_tpool_depth (), HMESH_TREE_POOL_DEPTH);
+    hmesh_error_flush ();
+    return 1;
+  }
+  fprintf (stdout, "\nHMESH_TREE_POOL_DEPTH %d", HMESH_TREE_POOL_DEPTH);
+
+  srand (1);
+  BlockID block [NSTACK];
+
+  /* (a) */
+  for (int depth = 0; depth <= HMESH_TREE_POOL_DEPTH; ++depth)
+  {
+    int n = 1 << depth, tiled = 1;
+    size_t bsize = size_of (depth);
+    for (int i = 0; i < n; ++i)
+    {
+      /* objects of 2^k bytes are stored in blocks of depth (D - k) */
+      block[i] = hmesh_tpool_allocate_general (1 << (HMESH_TREE_POOL_DEPTH -
+        depth));
+      char * mem = (char *) hmesh_tpool_address (block[i]);
+      if (!mem)
+      {
+        tiled = 0;
+        continue;
+      }
+      memset (mem, i + 1, bsize);
+    }
+
+    char * root = (char *) hmesh_tpool_tree (0)->root;
+    uint8_t seen [NSTACK] = {0};
+    for (int i = 0; i < n; ++i)
+    {
+      char * mem = (char *) hmesh_tpool_address (block[i]);
+      if (!mem || ((mem - root) % bsize))
+      {
+        tiled = 0;
+        continue;
+      }
+      size_t k = (mem - root) / bsize;
+      if (k >= (size_t) n || seen[k]++ ||
+          mem[0] != (char) (i + 1) || mem[bsize - 1] != (char) (i + 1))
+        tiled = 0;
+    }
+
+    shuffle (block, n);
+    for (int i = 0; i < n; ++i)
+      if (hmesh_tpool_deallocate (block[i]))
+        tiled = 0;
+
+    fprintf (stdout, "\ndepth %d : %3d blocks of %7zu bytes, tiling %s, "
+      "coalesced %s", depth, n, bsize, tiled ? "ok" : "failed",
+      coalesced () ? "ok" : "failed");
+  }
+
+  /* (b) */
+  int istack = 0, errors = 0;
+  for (int op = 0; op < NOPS; ++op)
+  {
+    if (istack < NSTACK && (!istack || rand () % 2))
+    {
+      int depth = rand () % (HMESH_TREE_POOL_DEPTH + 1);
+      BlockID b = hmesh_tpool_allocate (depth);
+      int * mem = (int *) hmesh_tpool_address (b);
+      if (!mem)
+      {
+        errors++;
+        continue;
+      }
+      mem[0] = (int) b;
+      block[istack++] = b;
+    }
+    else
+    {
+      int i = rand () % istack;
+      BlockID b = block[i];
+      block[i] = block[--istack];
+      if (*((int *) hmesh_tpool_address (b)) != (int) b ||
+          hmesh_tpool_deallocate (b))
+        errors++;
+    }
+  }
+  while (istack)
+    if (hmesh_tpool_deallocate (block[--istack]))
+      errors++;
+  fprintf (stdout, "\nrandom depths : %d ops, errors %d, coalesced %s\n",
+    NOPS, errors, coalesced () ? "ok" : "failed");
+
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+#define _GNU_SOURCE
+
+#include <common.h>
+#include <tree-pool.h>
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "now.h"
+
+/*
+.. Sweep benchmark of the tree pool backings. For each backing, coordinates
+.. are stored in NBLOCKS blocks (64MB) of the pool, and are gathered in
+.. a random order (as in a sweep over a non-renumbered mesh). dTLB load
+.. misses are counted with perf_event_open (), if allowed.
+*/
+
+#define NBLOCKS 2048
+#define NSWEEP  (1<<24)
+
+static int perf_open ()
+{
+  struct perf_event_attr attr;
+  memset (&attr, 0, sizeof (attr));
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.size = sizeof (attr);
+  attr.config = PERF_COUNT_HW_CACHE_DTLB |
+    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void sweep (int mode, const char * name)
+{
+  hmesh_tpool_backing (mode, 0);
+
+  /* largest blocks : 4096 x 8 bytes. So each block is 4096 'Real's */
+  BlockID block [NBLOCKS];
+  Real * x [NBLOCKS];
+  size_t bsize = hmesh_tpool_block_size () << HMESH_TREE_POOL_DEPTH,
+    n = bsize / sizeof (Real);
+  for (int i = 0; i < NBLOCKS; ++i)
+  {
+    block[i] = hmesh_tpool_allocate (0);
+    x[i] = (Real *) hmesh_tpool_address (block[i]);
+    for (size_t j = 0; j < n; ++j)
+      x[i][j] = (Real) j;
+  }
+
+  int fd = perf_open ();
+  long long misses = 0;
+  Real sum = 0.;
+  unsigned int seed = 1;
+
+  if (fd >= 0)
+  {
+    ioctl (fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl (fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  double start = now ();
+  for (int i = 0; i < NSWEEP; ++i)
+  {
+    seed = seed * 1103515245u + 12345u;
+    unsigned int r = seed >> 4;
+    sum += x[r % NBLOCKS][(r / NBLOCKS) % n];
+  }
+  double t = now () - start;
+  if (fd >= 0)
+  {
+    ioctl (fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read (fd, &misses, sizeof (misses)) != sizeof (misses))
+      misses = -1;
+    close (fd);
+  }
+
+  /* backing obtained */
+  int backing = hmesh_tpool_tree (0)->backing;
+  char obtained [32] = "4KB-pages";
+  if (backing & (HMESH_TPOOL_HUGETLB | HMESH_TPOOL_THP))
+    strcpy (obtained, backing & HMESH_TPOOL_HUGETLB ? "hugetlb" : "thp");
+  if (backing & HMESH_TPOOL_NUMA)
+    strcat (obtained, "+numa");
+  fprintf (stdout, "\n%-8s : backing %-14s %.2f ns/access, ",
+    name, obtained, 1e9 * t / NSWEEP);
+  if (fd >= 0 && misses >= 0)
+    fprintf (stdout, "dTLB misses %lld (sum %g)", misses, (double) sum);
+  else
+    fprintf (stdout, "dTLB misses n/a (sum %g)", (double) sum);
+
+  for (int i = 0; i < NBLOCKS; ++i)
+    hmesh_tpool_deallocate (block[i]);
+  hmesh_tpool_destroy ();
+}
+
+int main ()
+{
+  sweep (HMESH_TPOOL_PAGES,   "pages");
+  sweep (HMESH_TPOOL_THP,     "thp");
+  sweep (HMESH_TPOOL_HUGETLB, "hugetlb");
+  sweep (HMESH_TPOOL_THP | HMESH_TPOOL_NUMA, "thp+numa");
+  fprintf (stdout, "\n");
+
+  hmesh_error_flush ();
+
+  return 0;
+}
@@ -0,0 +1,57 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+
+#include "now.h"
+
+/*
+.. Cost of creating a tree pool. The pool is created (by the first
+.. allocation) and destroyed NCYCLES times. The resident memory after a
+.. single allocation is also reported, which is the memory touched at the
+.. creation of the tree.
+*/
+
+#define NCYCLES 1000
+
+static long rss ()
+{
+  long vm, pages = -1;
+  FILE * fp = fopen ("/proc/self/statm", "r");
+  if (fp)
+  {
+    if (fscanf (fp, "%ld %ld", &vm, &pages) != 2)
+      pages = -1;
+    fclose (fp);
+  }
+  return pages;
+}
+
+int main ()
+{
+  double start = now ();
+  for (int i = 0; i < NCYCLES; ++i)
+  {
+    BlockID block = hmesh_tpool_allocate_page ();
+    if (!hmesh_tpool_address (block))
+      hmesh_error ("main () : cannot allocate block");
+    hmesh_tpool_deallocate (block);
+    hmesh_tpool_destroy ();
+  }
+  double t = now () - start;
+
+  long before = rss ();
+  BlockID block = hmesh_tpool_allocate_page ();
+  long after = rss ();
+
+  fprintf (stdout, "\ncreate + first allocation : %.2f us"
+    "\nRSS after first allocation : %ld pages\n",
+    1e6 * t / NCYCLES, after - before);
+
+  hmesh_tpool_deallocate (block);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
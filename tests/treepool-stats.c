@@ -0,0 +1,76 @@
+#include <common.h>
+#include <tree-pool.h>
+
+/*
+.. Statistics of the tree pool (hmesh_tpool_stats ()). Blocks of random
+.. depth are allocated, and deallocated in a random order. The stats are
+.. printed at each stage, and the invariants are verified
+.. (a) used + free = mapped
+.. (b) nalloc - ndealloc = number of blocks in use
+*/
+
+#define NBLOCKS 20000
+
+static void status (const char * stage)
+{
+  HmeshTpoolStats s;
+  if (hmesh_tpool_stats (&s))
+    return;
+
+  size_t nused = 0;
+  fprintf (stdout, "\n%s\n  depth  :", stage);
+  for (int d = 0; d <= HMESH_TREE_POOL_DEPTH; ++d)
+    fprintf (stdout, " %8d", d);
+  fprintf (stdout, "\n  free   :");
+  for (int d = 0; d <= HMESH_TREE_POOL_DEPTH; ++d)
+    fprintf (stdout, " %8zu", s.nfree[d]);
+  fprintf (stdout, "\n  in use :");
+  for (int d = 0; d <= HMESH_TREE_POOL_DEPTH; ++d)
+  {
+    fprintf (stdout, " %8zu", s.nused[d]);
+    nused += s.nused[d];
+  }
+  fprintf (stdout, "\n  trees %zu, mapped %zu MB (peak %zu MB), "
+    "used %zu KB, free %zu KB, fragmentation %.3f"
+    "\n  alloc %zu, dealloc %zu, split %zu, coalesce %zu"
+    "\n  used + free = mapped : %s, alloc - dealloc = in use : %s",
+    s.ntrees, s.mapped >> 20, s.peak >> 20, s.used >> 10, s.free >> 10,
+    s.fragmentation, s.nalloc, s.ndealloc, s.nsplit, s.ncoalesce,
+    s.used + s.free == s.mapped ? "ok" : "failed",
+    s.nalloc - s.ndealloc == nused ? "ok" : "failed");
+}
+
+int main ()
+{
+  BlockID * block = malloc (NBLOCKS * sizeof (BlockID));
+
+  srand (1);
+  for (int i = 0; i < NBLOCKS; ++i)
+    block[i] = hmesh_tpool_allocate (rand () % (HMESH_TREE_POOL_DEPTH + 1));
+  status ("allocated");
+
+  /* shuffle */
+  for (int i = NBLOCKS - 1; i > 0; --i)
+  {
+    int j = rand () % (i + 1);
+    BlockID b = block[i];
+    block[i] = block[j];
+    block[j] = b;
+  }
+
+  for (int i = 0; i < NBLOCKS/2; ++i)
+    hmesh_tpool_deallocate (block[i]);
+  status ("half deallocated");
+
+  for (int i = NBLOCKS/2; i < NBLOCKS; ++i)
+    hmesh_tpool_deallocate (block[i]);
+  status ("all deallocated");
+  fprintf (stdout, "\n");
+
+  free (block);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
@@ -0,0 +1,103 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+
+#include <pthread.h>
+#include <time.h>
+
+/*
+.. Multi-threaded stress test of the tree pool in concurrent mode. Each
+.. thread randomly allocates/deallocates blocks of random depth. Every block
+.. is stamped with the thread id and the stamp is verified before freeing,
+.. so a block handed out to 2 threads at a time will be detected.
+*/
+
+#define NSTACK 64
+#define NOPS   (1<<20)
+
+typedef struct
+{
+  int tid;
+  unsigned int seed;
+  size_t errors;
+} Worker;
+
+static void * work (void * arg)
+{
+  Worker * w = (Worker *) arg;
+  BlockID stack [NSTACK];
+  int istack = 0;
+
+  for (int op = 0; op < NOPS; ++op)
+  {
+    int isPush = istack < NSTACK && (!istack || rand_r (&w->seed) % 2);
+    if (isPush)
+    {
+      int depth = rand_r (&w->seed) % (HMESH_TREE_POOL_DEPTH + 1);
+      BlockID block = hmesh_tpool_allocate (depth);
+      int * mem = (int *) hmesh_tpool_address (block);
+      if (!mem)
+      {
+        w->errors++;
+        continue;
+      }
+      mem[0] = w->tid;
+      mem[1] = block;
+      stack[istack++] = block;
+    }
+    else
+    {
+      BlockID block = stack[--istack];
+      int * mem = (int *) hmesh_tpool_address (block);
+      if (mem[0] != w->tid || (BlockID) mem[1] != block)
+        w->errors++;
+      if (hmesh_tpool_deallocate (block))
+        w->errors++;
+    }
+  }
+
+  while (istack)
+    hmesh_tpool_deallocate (stack[--istack]);
+
+  return NULL;
+}
+
+int main ()
+{
+  hmesh_tpool_concurrent (1);
+
+  for (int nthreads = 1; nthreads <= 8; nthreads *= 2)
+  {
+    pthread_t thread [8];
+    Worker worker [8];
+    struct timespec start, end;
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < nthreads; ++t)
+    {
+      worker[t] = (Worker) { .tid = t, .seed = 1234u + t, .errors = 0 };
+      pthread_create (&thread[t], NULL, work, &worker[t]);
+    }
+    size_t errors = 0;
+    for (int t = 0; t < nthreads; ++t)
+    {
+      pthread_join (thread[t], NULL);
+      errors += worker[t].errors;
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+
+    double sec = (end.tv_sec - start.tv_sec) +
+      1e-9 * (end.tv_nsec - start.tv_nsec);
+    fprintf (stdout, "\nthreads %d : %.1f M ops/s, errors %zu",
+      nthreads, 1e-6 * nthreads * NOPS / sec, errors);
+  }
+  fprintf (stdout, "\n");
+
+  hmesh_tpool_concurrent (0);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
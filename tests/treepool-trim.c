@@ -0,0 +1,92 @@
+#include <common.h>
+#include <tree-pool.h>
+
+/*
+.. Returning empty trees to OS. Blocks are allocated over many trees, and
+.. deallocated in a random order. Once a tree is empty, it's trimmed
+.. automatically (except the one kept as the high-water mark), and the rest
+.. by hmesh_tpool_trim ().
+*/
+
+#define NBLOCKS 40000
+
+static void status (const char * stage)
+{
+  int ntrees = 0, nmapped = 0;
+  size_t mapped = 0;
+  HmeshTpool * tree;
+  while ( (tree = hmesh_tpool_tree (ntrees++)) )
+    if (tree->root)
+    {
+      ++nmapped;
+      mapped += tree->size;
+    }
+
+  long vm, rss = -1;
+  FILE * fp = fopen ("/proc/self/statm", "r");
+  if (fp)
+  {
+    if (fscanf (fp, "%ld %ld", &vm, &rss) != 2)
+      rss = -1;
+    fclose (fp);
+  }
+  fprintf (stdout, "\n%-24s : %3d trees mapped (%4zu MB), RSS %ld pages",
+    stage, nmapped, mapped >> 20, rss);
+}
+
+int main ()
+{
+  BlockID * block = malloc (NBLOCKS * sizeof (BlockID));
+
+  for (int i = 0; i < NBLOCKS; ++i)
+  {
+    block[i] = hmesh_tpool_allocate_page ();
+    memset (hmesh_tpool_address (block[i]), 1, hmesh_tpool_block_size ());
+  }
+  status ("allocated");
+
+  /* shuffle */
+  srand (1);
+  for (int i = NBLOCKS - 1; i > 0; --i)
+  {
+    int j = rand () % (i + 1);
+    BlockID b = block[i];
+    block[i] = block[j];
+    block[j] = b;
+  }
+
+  for (int i = 0; i < NBLOCKS/2; ++i)
+    if (hmesh_tpool_deallocate (block[i]))
+      hmesh_error ("main () : cannot deallocate block %d", i);
+  status ("half deallocated");
+
+  for (int i = NBLOCKS/2; i < NBLOCKS; ++i)
+    if (hmesh_tpool_deallocate (block[i]))
+      hmesh_error ("main () : cannot deallocate block %d", i);
+  status ("all deallocated");
+
+  size_t size = hmesh_tpool_trim ();
+  status ("hmesh_tpool_trim ()");
+  fprintf (stdout, " : %zu MB unmapped", size >> 20);
+  /* a block of a trimmed tree has no address */
+  int nstale = 0;
+  for (int i = 0; i < NBLOCKS; ++i)
+    nstale += (hmesh_tpool_address (block[i]) != NULL);
+  fprintf (stdout, ", %d stale addresses (expect 0)", nstale);
+
+  /* trimmed slots are reused */
+  for (int i = 0; i < NBLOCKS/4; ++i)
+    block[i] = hmesh_tpool_allocate_page ();
+  status ("allocated again");
+  for (int i = 0; i < NBLOCKS/4; ++i)
+    if (hmesh_tpool_deallocate (block[i]))
+      hmesh_error ("main () : cannot deallocate block %d", i);
+  fprintf (stdout, "\n");
+
+  free (block);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
@@ -22,19 +22,23 @@ void TpoolStatus()
   for(int is=0; is<8*10;++is)
     fprintf(stdout,"."); 
   fprintf(stdout, "\n"); 
-  uint8_t * flags = (hmesh_tpool_tree (0))->flags;
-  for(int level=0; level<4; ++level)
+  HmeshTpool * tree = hmesh_tpool_tree (0);
+  uint8_t * flags = tree->flags;
+  /* 80 columns : 10 roots of depth 3 */
+  int D = HMESH_TREE_POOL_DEPTH, nroots = 80 >> D;
+  for(int level=0; level<=D; ++level)
   {
-    for(int j=0; j<10; ++j) {
-      Index start = j*16;
-      for(Index index = (1<<level) - 1; index < (1<<(level+1)) - 1; ++index)
+    for(int j=0; j<nroots; ++j) {
+      Index start = j*(2<<D);
+      for(int index = (1<<level) - 1; index < (1<<(level+1)) - 1; ++index)
       {
         Index inode = start + index; 
-        char state =  flags[inode] & 128 ? 'f' :  /* free     : free to use */
+        char state =  j >= (int) tree->next ? '.' : /* not yet committed */
+                      flags[inode] & 128 ? 'f' :  /* free     : free to use */
                       flags[inode] & 64  ? 'r' :  /* reserved : not a leaf Node*/
                       '_' ;                       /* in use   : currently in use */
         fprintf(stdout, "%c", state); 
-        for (int is=0; is<(1<<(3-level))-1;++is)
+        for (int is=0; is<(1<<(D-level))-1;++is)
           fprintf(stdout,"%c", state == '_' ? '_' : ' '); 
       }
     }  
@@ -42,7 +46,7 @@ void TpoolStatus()
   } 
 }
 
-void WriteToBlock (Index block, unsigned int depth)
+void WriteToBlock (BlockID block, unsigned int depth)
 {
   /* write random info to block */
   char * mem = (char *) hmesh_tpool_address (block);
@@ -61,21 +65,23 @@ int main (int argc, char ** argv)
   HmeshTpoolAdd();
   */
 
-  Index STACK[NSTACK], istack = 0, inode = 0, limit = 1000;
+  BlockID STACK[NSTACK], istack = 0, inode = 0, limit = 1000,
+    nnodes = (80 >> HMESH_TREE_POOL_DEPTH) << (HMESH_TREE_POOL_DEPTH + 1);
 
-  while ( (istack < NSTACK) && (inode < 160) && (limit--) )
+  while ( (istack < NSTACK) && (inode < nnodes) && (limit--) )
   {
 
     int isPush = rand() % 2;
     if(isPush && istack<NSTACK) {
-      /* Add a block @ random level <= 3 */
-      int level = rand() % 4;
-      Index block = hmesh_tpool_allocate (level);  
+      /* Add a block @ random level <= HMESH_TREE_POOL_DEPTH */
+      int level = rand() % (HMESH_TREE_POOL_DEPTH + 1);
+      BlockID block = hmesh_tpool_allocate (level);  
       STACK[istack++] = block;
       /* rewrite the memory block with junk */
       WriteToBlock (block, level);
       
-      inode = inode < (STACK[istack-1]) ? STACK[istack-1] : inode;
+      BlockID last = STACK[istack-1] & HMESH_TPOOL_NODE_MASK;
+      inode = inode < last ? last : inode;
     }
     else if(istack)
       hmesh_tpool_deallocate (STACK[--istack]);  
@@ -0,0 +1,158 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include <unistd.h>
+
+#include "tris-torus.h"
+
+/*
+.. Parallel coarsening of HmeshTris (hmesh_tris_coarsen ()). The edges of
+.. a torus (radii 1 and 0.4) of 2 N^2 triangles shorter than amin are
+.. collapsed, (a) serially, one after other (hmesh_tris_collapse ()) as
+.. hmesh_collapse () of src/backup, and (b) in parallel passes with 1, 2,
+.. 4 .. threads. The surface should be valid, with an Euler characteristic
+.. 0. Then a torus refined (hmesh_tris_refine ()) is coarsened back, and
+.. compacted (the faces alone by hmesh_cells_compact (), and then all by
+.. hmesh_tris_compact ()) and reordered (hmesh_tris_reorder ()). The twins
+.. (half edges) should be updated with the moved faces.
+*/
+
+#define N    128
+#define AMIN 0.03
+
+/* number of edges shorter than 'amin' */
+static size_t nshort (HmeshTris * t, double amin)
+{
+  size_t n = 0;
+  HMESH_FOREACH_TRI_HEDGE (t->f, e)
+    n += (length2 (t, e) < amin * amin);
+  return n / 2;
+}
+
+static int in_use (HmeshCells * c, Node face)
+{
+  return ((Index *) HMESH_ATTR (c, 1, face.iblock)) [face.index] <
+    c->info [face.iblock];
+}
+
+static HmeshTris * T;
+
+static int shorter (const void * a, const void * b)
+{
+  double la = length2 (T, *(const Node *) a),
+    lb = length2 (T, *(const Node *) b);
+  return (la > lb) - (la < lb);
+}
+
+/*
+.. hmesh_collapse () : collapse the short edges one after other (the
+.. shortest first), till none of them can be collapsed
+*/
+static size_t collapse_serial (HmeshTris * t, double amin)
+{
+  size_t ncollapse = 0, n, done, max = 0;
+  Node * work = NULL;
+  T = t;
+  do
+  {
+    if (3 * nodes (t->f) > max)
+    {
+      max = 3 * nodes (t->f);
+      work = realloc (work, max * sizeof (Node));
+    }
+    n = done = 0;
+    HMESH_FOREACH_TRI_HEDGE (t->f, e)
+    {
+      Node tw = HMESH_TRI_TWIN (t->f, e);
+      if ( (tw.iblock > e.iblock ||
+            (tw.iblock == e.iblock && tw.index > e.index)) &&
+           length2 (t, e) < amin * amin )
+        work[n++] = e;
+    }
+    qsort (work, n, sizeof (Node), shorter);
+    /* faces of a collapse before are removed, others have new edges */
+    for (size_t k = 0; k < n; ++k)
+      if ( in_use (t->f, hmesh_tri_face (work[k])) &&
+           length2 (t, work[k]) < amin * amin &&
+           hmesh_tris_collapse (t, work[k]) == HMESH_NO_ERROR )
+        ++done;
+    ncollapse += done;
+  } while (done);
+  free (work);
+  return ncollapse;
+}
+
+int main ()
+{
+  HmeshRemesh r = { .amin = AMIN, .amax = 1., .quality = 0. };
+  int errors = 0;
+
+  HmeshTris * t = torus (N, N, 0.4);
+  size_t nf = nodes (t->f);
+  double start = now ();
+  size_t nserial = collapse_serial (t, r.amin);
+  double tserial = now () - start;
+  errors += (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) + (euler (t) != 0) +
+    (nserial == 0);
+  fprintf (stdout, "\nserial     : %zu -> %zu faces, %zu collapses, %6.1f "
+    "ns/collapse, %zu short edges left, errors %d", nf, nodes (t->f),
+    nserial, 1e9 * tserial / nserial, nshort (t, r.amin), errors);
+  hmesh_tris_destroy (t);
+
+  long nproc = sysconf (_SC_NPROCESSORS_ONLN);
+  for (int nthreads = 1; nthreads <= (nproc < 4 ? 4 : nproc);
+       nthreads *= 2)
+  {
+    hmesh_threads (nthreads);
+    t = torus (N, N, 0.4);
+    size_t ncollapse;
+    start = now ();
+    errors += hmesh_tris_coarsen (t, &r, &ncollapse);
+    double tpar = now () - start;
+    errors += (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) +
+      (euler (t) != 0) + (ncollapse == 0);
+    fprintf (stdout, "\nthreads %2d : %zu -> %zu faces, %zu collapses, "
+      "%6.1f ns/collapse, %zu short edges left, errors %d", nthreads, nf,
+      nodes (t->f), ncollapse, 1e9 * tpar / ncollapse, nshort (t, r.amin),
+      errors);
+    hmesh_tris_destroy (t);
+  }
+
+  /* refined, then coarsened back */
+  t = torus (N/4, N/4, 0.4);
+  nf = nodes (t->f);
+  HmeshRemesh q = { .amin = 0.05, .amax = 0.1, .quality = 0. };
+  size_t nsplit, ncollapse;
+  errors += hmesh_tris_refine (t, &q, &nsplit);
+  size_t nfine = nodes (t->f);
+  errors += hmesh_tris_coarsen (t, &q, &ncollapse) + (ncollapse == 0) +
+    (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) + (euler (t) != 0);
+  fprintf (stdout, "\nrefined    : %zu -> %zu -> %zu faces, %zu splits, "
+    "%zu collapses, errors %d", nf, nfine, nodes (t->f), nsplit,
+    ncollapse, errors);
+
+  /* compaction & reorder of the coarsened surface */
+  Index nblocks = t->f->blocks->n;
+  nf = nodes (t->f);
+  errors += hmesh_cells_compact (t->f, NULL) +
+    (hmesh_tris_valid (t) != HMESH_HEDGE_VALID);
+  Index nfaces = t->f->blocks->n;
+  errors += hmesh_tris_compact (t) +
+    (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) +
+    hmesh_tris_reorder (t, HMESH_CURVE_HILBERT) +
+    (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) + (euler (t) != 0) +
+    (nodes (t->f) != nf) + (nfaces >= nblocks);
+  fprintf (stdout, "\ncompacted  : face blocks %d -> %d, reordered, "
+    "errors %d\n", nblocks, nfaces, errors);
+  hmesh_tris_destroy (t);
+
+  hmesh_threads_destroy ();
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
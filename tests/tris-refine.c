@@ -0,0 +1,147 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include <unistd.h>
+
+#include "tris-torus.h"
+
+/*
+.. Parallel refinement of HmeshTris (hmesh_tris_refine ()). A torus (radii
+.. 1 and 0.4) of 2 N^2 triangles is refined till its edges are shorter
+.. than amax, (a) serially, by splitting the edges one after other
+.. (hmesh_tris_split ()) as hmesh_split () of src/backup, and (b) in
+.. parallel passes with 1, 2, 4 .. threads. The surface should be valid,
+.. with an Euler characteristic 0, and with no edge longer than amax. Then a
+.. coarse torus is refined to a small amax (more passes than the levels of
+.. the refinement), and a stretched torus is refined by the quality of its
+.. triangles.
+*/
+
+#define N    128
+#define AMAX 0.025
+
+static double max_length2 (HmeshTris * t)
+{
+  double l = 0.;
+  HMESH_FOREACH_TRI_HEDGE (t->f, e)
+    if (length2 (t, e) > l)
+      l = length2 (t, e);
+  return l;
+}
+
+static HmeshTris * T;
+
+static int longer (const void * a, const void * b)
+{
+  double la = length2 (T, *(const Node *) a),
+    lb = length2 (T, *(const Node *) b);
+  return (la < lb) - (la > lb);
+}
+
+/*
+.. hmesh_split () : split the edges one after other (the longest first, as
+.. hface_split ()), till none is long
+*/
+static size_t split_serial (HmeshTris * t, double amax)
+{
+  size_t nsplit = 0, n, max = 0;
+  Node * work = NULL;
+  T = t;
+  do
+  {
+    if (3 * nodes (t->f) > max)
+    {
+      max = 3 * nodes (t->f);
+      work = realloc (work, max * sizeof (Node));
+    }
+    n = 0;
+    HMESH_FOREACH_TRI_HEDGE (t->f, e)
+    {
+      Node tw = HMESH_TRI_TWIN (t->f, e);
+      if ( (tw.iblock > e.iblock ||
+            (tw.iblock == e.iblock && tw.index > e.index)) &&
+           length2 (t, e) > amax * amax )
+        work[n++] = e;
+    }
+    qsort (work, n, sizeof (Node), longer);
+    /* a half edge of a face split before, may be of another edge now */
+    for (size_t k = 0; k < n; ++k)
+      if (length2 (t, work[k]) > amax * amax)
+      {
+        hmesh_tris_split (t, work[k]);
+        ++nsplit;
+      }
+  } while (n);
+  free (work);
+  return nsplit;
+}
+
+int main ()
+{
+  HmeshRemesh r = { .amin = 0., .amax = AMAX, .quality = 0. };
+  int errors = 0;
+
+  HmeshTris * t = torus (N, N, 0.4);
+  size_t nf = nodes (t->f);
+  double start = now ();
+  size_t nserial = split_serial (t, r.amax);
+  double tserial = now () - start;
+  errors += (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) + (euler (t) != 0) +
+    (max_length2 (t) > r.amax * r.amax);
+  fprintf (stdout, "\nserial     : %zu -> %zu faces, %zu splits, %6.1f "
+    "ns/split, errors %d", nf, nodes (t->f), nserial, 1e9 * tserial / nserial,
+    errors);
+  hmesh_tris_destroy (t);
+
+  long nproc = sysconf (_SC_NPROCESSORS_ONLN);
+  for (int nthreads = 1; nthreads <= (nproc < 4 ? 4 : nproc);
+       nthreads *= 2)
+  {
+    hmesh_threads (nthreads);
+    t = torus (N, N, 0.4);
+    size_t nsplit;
+    start = now ();
+    errors += hmesh_tris_refine (t, &r, &nsplit);
+    double tpar = now () - start;
+    errors += (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) +
+      (euler (t) != 0) + (max_length2 (t) > r.amax * r.amax);
+    fprintf (stdout, "\nthreads %2d : %zu -> %zu faces, %zu splits, %6.1f "
+      "ns/split, errors %d", nthreads, nf, nodes (t->f), nsplit,
+      1e9 * tpar / nsplit, errors);
+    hmesh_tris_destroy (t);
+  }
+
+  /* coarse torus : the passes go on till no edge is longer than amax */
+  t = torus (8, 8, 0.4);
+  nf = nodes (t->f);
+  HmeshRemesh d = { .amin = 0., .amax = 0.01, .quality = 0. };
+  size_t ndeep;
+  errors += hmesh_tris_refine (t, &d, &ndeep) +
+    (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) + (euler (t) != 0) +
+    (max_length2 (t) > d.amax * d.amax);
+  fprintf (stdout, "\ncoarse     : %zu -> %zu faces, %zu splits, "
+    "(longest/amax)^2 %.3f, errors %d", nf, nodes (t->f), ndeep,
+    max_length2 (t) / (d.amax * d.amax), errors);
+  hmesh_tris_destroy (t);
+
+  /* stretched torus : the triangles of a poor quality are split */
+  t = torus (N, 8, 0.4);
+  nf = nodes (t->f);
+  HmeshRemesh q = { .amin = 0.05, .amax = 1., .quality = 0.8 };
+  size_t nsplit;
+  errors += hmesh_tris_refine (t, &q, &nsplit) + (nsplit == 0) +
+    (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) + (euler (t) != 0);
+  fprintf (stdout, "\nquality    : %zu -> %zu faces, %zu splits, errors %d\n",
+    nf, nodes (t->f), nsplit, errors);
+  hmesh_tris_destroy (t);
+
+  hmesh_threads_destroy ();
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
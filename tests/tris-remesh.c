@@ -0,0 +1,138 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include "tris-torus.h"
+
+/*
+.. Incremental remeshing of HmeshTris (hmesh_tris_remesh ()). A torus
+.. (radii 1 and 0.4) of 2 N^2 triangles is deformed in two small regions
+.. (a bump, stretched, and a contraction), and remeshed (a) from the faces
+.. of the vertices moved, (b) from all the faces, and (c) by the sweeps
+.. hmesh_tris_refine () & hmesh_tris_coarsen () over the whole surface.
+.. The surface should be valid, with an Euler characteristic 0, and no
+.. edge longer than amax. Then a coarse torus is remeshed from scratch.
+*/
+
+#define N    128
+#define AMIN 0.012
+#define AMAX 0.08
+
+/* number of edges shorter than 'amin' (or longer than 'amax') */
+static size_t noutside (HmeshTris * t, double a, int longer)
+{
+  size_t n = 0;
+  HMESH_FOREACH_TRI_HEDGE (t->f, e)
+    n += longer ? (length2 (t, e) > a * a) : (length2 (t, e) < a * a);
+  return n / 2;
+}
+
+/*
+.. Bump (z += 0.3 (1 - d^2/R^2)) around (1, 0, 0.4), and contraction
+.. (x -= 0.7 (1 - d^2/R^2) (x - c)) around c = (-1, 0, 0.4), with R = 0.3.
+.. The faces of the vertices moved are stored in 'face'. Returns their
+.. number.
+*/
+static size_t deform (HmeshTris * t, Node * face)
+{
+  const double R = 0.3, c[2][3] = { {1., 0., 0.4}, {-1., 0., 0.4} };
+  size_t n = 0;
+  HMESH_FOREACH_NODE (t->f, x)
+  {
+    int moved = 0;
+    for (int k = 0; k < 3; ++k)
+    {
+      Node v = HMESH_TRI_PIVOT (t->f, hmesh_tri_hedge (x, k));
+      double p[3], d2[2] = {0., 0.};
+      for (int d = 0; d < 3; ++d)
+      {
+        p[d] = HMESH_SCALAR (t->p, 2 + d, v);
+        d2[0] += (p[d] - c[0][d]) * (p[d] - c[0][d]);
+        d2[1] += (p[d] - c[1][d]) * (p[d] - c[1][d]);
+      }
+      moved |= (d2[0] < R * R) || (d2[1] < R * R);
+    }
+    if (moved)
+      face [n++] = x;
+  }
+  /* vertices are moved after, as a vertex is shared by faces */
+  HMESH_FOREACH_NODE (t->p, v)
+  {
+    double p[3], d2[2] = {0., 0.};
+    for (int d = 0; d < 3; ++d)
+    {
+      p[d] = HMESH_SCALAR (t->p, 2 + d, v);
+      d2[0] += (p[d] - c[0][d]) * (p[d] - c[0][d]);
+      d2[1] += (p[d] - c[1][d]) * (p[d] - c[1][d]);
+    }
+    if (d2[0] < R * R)
+      HMESH_SCALAR (t->p, 4, v) += 0.3 * (1. - d2[0] / (R * R));
+    if (d2[1] < R * R)
+      for (int d = 0; d < 3; ++d)
+        HMESH_SCALAR (t->p, 2 + d, v) -=
+          0.7 * (1. - d2[1] / (R * R)) * (p[d] - c[1][d]);
+  }
+  return n;
+}
+
+int main ()
+{
+  HmeshRemesh r = { .amin = AMIN, .amax = AMAX, .quality = 0. };
+  int errors = 0;
+  const char * name[3] = { "changed", "all faces", "sweeps" };
+
+  for (int m = 0; m < 3; ++m)
+  {
+    HmeshTris * t = torus (N, N, 0.4);
+    Node * face = malloc (nodes (t->f) * sizeof (Node));
+    size_t nseed = deform (t, face), nf = nodes (t->f), nops, nc;
+    double start = now ();
+    if (m == 0)
+      errors += hmesh_tris_remesh (t, &r, face, nseed, &nops);
+    else if (m == 1)
+      errors += hmesh_tris_remesh (t, &r, NULL, 0, &nops);
+    else
+    {
+      /* as hmesh_remesh (), till the sweeps change nothing */
+      nops = 0;
+      for (int k = 0; k < 6; ++k)
+      {
+        size_t ns;
+        errors += hmesh_tris_refine (t, &r, &ns) +
+          hmesh_tris_coarsen (t, &r, &nc);
+        nops += ns + nc;
+        if (!(ns || nc))
+          break;
+      }
+    }
+    double time = now () - start;
+    errors += (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) +
+      (euler (t) != 0) + (noutside (t, r.amax, 1) != 0) + (nops == 0);
+    fprintf (stdout, "\n%-9s : %zu faces (%zu moved) -> %zu faces, %zu "
+      "operations, %7.3f ms, %zu short edges left, errors %d", name[m],
+      nf, nseed, nodes (t->f), nops, 1e3 * time,
+      noutside (t, r.amin, 0), errors);
+    free (face);
+    hmesh_tris_destroy (t);
+  }
+
+  /* coarse torus, remeshed from scratch */
+  HmeshTris * t = torus (N/8, N/8, 0.4);
+  HmeshRemesh q = { .amin = 0.05, .amax = 0.12, .quality = 0.5 };
+  size_t nf = nodes (t->f), nops;
+  errors += hmesh_tris_remesh (t, &q, NULL, 0, &nops) +
+    (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) + (euler (t) != 0) +
+    (noutside (t, q.amax, 1) != 0);
+  fprintf (stdout, "\ncoarse    : %zu -> %zu faces, %zu operations, "
+    "errors %d\n", nf, nodes (t->f), nops, errors);
+  hmesh_tris_destroy (t);
+
+  hmesh_threads_destroy ();
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}
@@ -0,0 +1,95 @@
+#ifndef _HMESH_TRIS_TORUS_
+#define _HMESH_TRIS_TORUS_
+
+#include "now.h"
+
+/*
+.. Common fixture of the tests of HmeshTris (tris-refine.c, tris-coarsen.c,
+.. tris-remesh.c) : timer (now.h), counts, edge length and a torus surface.
+*/
+
+static size_t nodes (HmeshCells * c)
+{
+  size_t n = 0;
+  HMESH_FOREACH_BLOCK (c, iblk)
+    n += HMESH_BLOCK_COUNT (c, iblk);
+  return n;
+}
+
+static long euler (HmeshTris * t)
+{
+  long nf = (long) nodes (t->f);
+  return (long) nodes (t->p) - 3 * nf / 2 + nf;
+}
+
+static double length2 (HmeshTris * t, Node e)
+{
+  Node a = HMESH_TRI_PIVOT (t->f, e),
+    b = HMESH_TRI_PIVOT (t->f, hmesh_tri_next (e));
+  double l = 0.;
+  for (int d = 0; d < 3; ++d)
+  {
+    double x = HMESH_SCALAR (t->p, 2 + d, b) - HMESH_SCALAR (t->p, 2 + d, a);
+    l += x * x;
+  }
+  return l;
+}
+
+/* cos, sin of 2 pi k / n, with no libm (rotation by Taylor series) */
+static void circle (int n, double * c, double * s)
+{
+  double x = 2. * 3.14159265358979323846 / n, cw = 0., sw = 0., term = 1.;
+  for (int k = 0; k < 30; ++k)
+  {
+    if (k % 2)
+      sw += (k % 4 == 1) ? term : -term;
+    else
+      cw += (k % 4 == 0) ? term : -term;
+    term *= x / (k + 1);
+  }
+  c[0] = 1.;
+  s[0] = 0.;
+  for (int k = 1; k < n; ++k)
+  {
+    c[k] = c[k-1] * cw - s[k-1] * sw;
+    s[k] = s[k-1] * cw + c[k-1] * sw;
+  }
+}
+
+/* torus of nu x nv quads, with radii 1 and 'r' */
+static HmeshTris * torus (int nu, int nv, double r)
+{
+  HmeshTris * t = hmesh_tris (3);
+  size_t nvert = (size_t) nu * nv, nf = 2 * nvert;
+  Node * p = malloc (nvert * sizeof (Node));
+  Node (* face)[3] = malloc (nf * sizeof (Node [3]));
+  double * cu = malloc (nu * sizeof (double)),
+    * su = malloc (nu * sizeof (double)),
+    * cv = malloc (nv * sizeof (double)), * sv = malloc (nv * sizeof (double));
+  circle (nu, cu, su);
+  circle (nv, cv, sv);
+  hmesh_nodes_new (t->p, nvert, p);
+  for (int i = 0; i < nu; ++i)
+    for (int j = 0; j < nv; ++j)
+    {
+      Node x = p[i*nv + j];
+      HMESH_SCALAR (t->p, 2, x) = (1. + r * cv[j]) * cu[i];
+      HMESH_SCALAR (t->p, 3, x) = (1. + r * cv[j]) * su[i];
+      HMESH_SCALAR (t->p, 4, x) = r * sv[j];
+      Node a = x, b = p[((i + 1) % nu)*nv + j],
+        c = p[((i + 1) % nu)*nv + (j + 1) % nv], d = p[i*nv + (j + 1) % nv];
+      size_t k = 2 * ((size_t) i*nv + j);
+      face[k][0] = a; face[k][1] = b; face[k][2] = c;
+      face[k+1][0] = a; face[k+1][1] = c; face[k+1][2] = d;
+    }
+  hmesh_tris_faces_new (t, face, nf, NULL);
+  free (sv);
+  free (cv);
+  free (su);
+  free (cu);
+  free (face);
+  free (p);
+  return t;
+}
+
+#endif
@@ -0,0 +1,337 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <common.h>
+#include <tree-pool.h>
+#include <hmesh.h>
+
+#include "now.h"
+
+/*
+.. Implicit half edges of HmeshTris (3 consecutive half edges per face,
+.. with no 'next' stored) compared with the half edges on the 1-cells
+.. (hmesh_hedges_new ()). A torus of 2 N^2 triangles is created from its
+.. faces (in a random order) in both. The memory per half edge and the
+.. walks over the faces and the stars are compared, and should give the
+.. same sums. Then random edges are split (hmesh_tris_split ()) and the new
+.. vertices are collapsed (hmesh_tris_collapse ()). The surface should stay
+.. valid, with an Euler characteristic 0. Collapses that are not allowed
+.. (tetrahedron, boundary) should be abandoned.
+*/
+
+#define N 512
+#define NSPLIT (N * N / 8)
+#define M 8
+
+static void shuffle (size_t * a, size_t n)
+{
+  for (size_t i = n - 1; i > 0; --i)
+  {
+    size_t j = ((size_t) rand () * RAND_MAX + rand ()) % (i + 1), o = a[i];
+    a[i] = a[j];
+    a[j] = o;
+  }
+}
+
+static size_t nodes (HmeshCells * c)
+{
+  size_t n = 0;
+  HMESH_FOREACH_BLOCK (c, iblk)
+    n += HMESH_BLOCK_COUNT (c, iblk);
+  return n;
+}
+
+static size_t bytes (HmeshCells * c)
+{
+  size_t b = 0;
+  for (Index i = 0; i < c->scalars.n; ++i)
+    b += ((HmeshArray *) c->attr[c->scalars.info[i].in_use])->obj_size;
+  return b;
+}
+
+static int in_use (HmeshCells * c, Node n)
+{
+  return c->blocks->info[n.iblock].loc != HMESH_INDEX_NULL &&
+    ((Index *) HMESH_ATTR (c, 1, n.iblock))[n.index] <
+      HMESH_BLOCK_COUNT (c, n.iblock);
+}
+
+/* V - E + F of a closed surface (E = 3F/2) */
+static long euler (HmeshTris * t)
+{
+  long nf = (long) nodes (t->f);
+  return (long) nodes (t->p) - 3 * nf / 2 + nf;
+}
+
+/* perimeter (in x.x) of all the faces, from each half edge */
+static double face_node (HmeshCells * v, HmeshCells * e)
+{
+  double sum = 0.;
+  HMESH_FOREACH_NODE (e, x)
+  {
+    Real p = 0.;
+    HMESH_FOREACH_FACE (e, x, f)
+      p += HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, f, 0));
+    sum += p;
+  }
+  return sum;
+}
+
+static double face_tri (HmeshCells * v, HmeshCells * f)
+{
+  double sum = 0.;
+  HMESH_FOREACH_TRI_HEDGE (f, x)
+  {
+    Real p = 0.;
+    Node y = x;
+    do
+    {
+      p += HMESH_SCALAR (v, 2, HMESH_TRI_PIVOT (f, y));
+      y = hmesh_tri_next (y);
+    } while (y.index != x.index);
+    sum += p;
+  }
+  return sum;
+}
+
+/* star of the pivot of each half edge (sum of the squares of laplacian) */
+static double star_node (HmeshCells * v, HmeshCells * e)
+{
+  double sum = 0.;
+  HMESH_FOREACH_NODE (e, x)
+  {
+    Real l = -6. * HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, x, 0));
+    HMESH_FOREACH_STAR (e, x, s)
+      l += HMESH_SCALAR (v, 2, HMESH_IVERTEX (e, s, 1));
+    sum += l * l;
+  }
+  return sum;
+}
+
+static double star_tri (HmeshCells * v, HmeshCells * f)
+{
+  double sum = 0.;
+  HMESH_FOREACH_TRI_HEDGE (f, x)
+  {
+    Real l = -6. * HMESH_SCALAR (v, 2, HMESH_TRI_PIVOT (f, x));
+    HMESH_FOREACH_TRI_STAR (f, x, s)
+      l += HMESH_SCALAR (v, 2, HMESH_TRI_PIVOT (f, hmesh_tri_next (s)));
+    sum += l * l;
+  }
+  return sum;
+}
+
+/* triangles of the open M x M grid of the vertices 'p' */
+static int grid_faces (Node * p, Node (* grid)[3])
+{
+  int k = 0;
+  for (int i = 0; i < M - 1; ++i)
+    for (int j = 0; j < M - 1; ++j)
+    {
+      Node a = p[i*M + j], b = p[(i+1)*M + j], c = p[(i+1)*M + j + 1],
+        d = p[i*M + j + 1];
+      grid[k][0] = a; grid[k][1] = b; grid[k++][2] = c;
+      grid[k][0] = a; grid[k][1] = c; grid[k++][2] = d;
+    }
+  return k;
+}
+
+int main ()
+{
+  Hmesh * h = hmesh (2, 3);
+  HmeshTris * t = hmesh_tris (3);
+  size_t nv = (size_t) N * N, nf = 2 * nv, ne = 3 * nf;
+
+  /* same vertices (i,j) in both, and the faces in a random order */
+  srand (1);
+  Node * vertex = malloc (nv * sizeof (Node)),
+    * tvertex = malloc (nv * sizeof (Node));
+  hmesh_nodes_new (h->p, nv, vertex);
+  hmesh_nodes_new (t->p, nv, tvertex);
+  int errors = 0;
+  for (size_t i = 0; i < nv; ++i)
+  {
+    errors += (vertex[i].index != tvertex[i].index) ||
+      (vertex[i].iblock != tvertex[i].iblock);
+    for (int d = 0; d < 3; ++d)
+      HMESH_SCALAR (h->p, 2 + d, vertex[i]) =
+        HMESH_SCALAR (t->p, 2 + d, vertex[i]) =
+        (Real) (d ? (d == 1 ? i / N : i % N) : i % 1000);
+  }
+  size_t * order = malloc (nf * sizeof (size_t));
+  for (size_t f = 0; f < nf; ++f)
+    order[f] = f;
+  shuffle (order, nf);
+
+  /* quad (i,j) : A = (p00, p10, p11), B = (p00, p11, p01) */
+  Node (* face)[3] = malloc (nf * sizeof (Node [3]));
+  for (size_t k = 0; k < nf; ++k)
+  {
+    size_t q = order[k] / 2, i = q / N, j = q % N;
+    size_t p[4] = { i*N + j, ((i + 1) % N)*N + j,
+      ((i + 1) % N)*N + (j + 1) % N, i*N + (j + 1) % N };
+    int tv[2][3] = { {0, 1, 2}, {0, 2, 3} };
+    for (int s = 0; s < 3; ++s)
+      face[k][s] = vertex [p [tv[order[k] % 2][s]]];
+  }
+
+  double start = now ();
+  errors += hmesh_hedges_new (h, face, nf, NULL);
+  double thedge = now () - start;
+  start = now ();
+  errors += hmesh_tris_faces_new (t, face, nf, NULL);
+  double ttri = now () - start;
+  errors += (hmesh_hedges_valid (h) != HMESH_HEDGE_VALID) +
+    (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) + (euler (t) != 0);
+
+  double r[4], tw[4];
+  start = now ();
+  r[0] = face_node (h->p, h->e);
+  tw[0] = now () - start;
+  start = now ();
+  r[1] = face_tri (t->p, t->f);
+  tw[1] = now () - start;
+  start = now ();
+  r[2] = star_node (h->p, h->e);
+  tw[2] = now () - start;
+  start = now ();
+  r[3] = star_tri (t->p, t->f);
+  tw[3] = now () - start;
+  errors += (r[0] != r[1]) + (r[2] != r[3]);
+
+  fprintf (stdout, "\n%zu half edges : new %.1f (1-cells) %.1f (implicit) "
+    "ns/half edge", ne, 1e9 * thedge / ne, 1e9 * ttri / ne);
+  fprintf (stdout, "\nbytes/half edge : 1-cells %zu, implicit %.1f",
+    bytes (h->e), bytes (t->f) / 3.);
+  const char * name[4] = { "faces 1-cells", "faces implicit",
+    "stars 1-cells", "stars implicit" };
+  for (int i = 0; i < 4; ++i)
+    fprintf (stdout, "\n%-14s : %6.1f ns/half edge, sum %g", name[i],
+      1e9 * tw[i] / ne, r[i]);
+  fprintf (stdout, "\nerrors %d", errors);
+  free (order);
+  free (face);
+  free (tvertex);
+  free (vertex);
+  hmesh_destroy (h);
+
+  /* split random half edges (which are never removed by a split) */
+  Node * he = malloc (ne * sizeof (Node)),
+    * m = malloc (NSPLIT * sizeof (Node));
+  size_t n = 0;
+  HMESH_FOREACH_TRI_HEDGE (t->f, x)
+    he[n++] = x;
+  start = now ();
+  for (size_t k = 0; k < NSPLIT; ++k)
+  {
+    Node g = hmesh_tris_split (t, he [((size_t) rand () * RAND_MAX + rand ())
+      % ne]);
+    errors += (g.index == HMESH_INDEX_NULL);
+    m[k] = HMESH_TRI_PIVOT (t->f, g);
+  }
+  double tsplit = now () - start;
+  errors += (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) + (euler (t) != 0) +
+    (nodes (t->p) != nv + NSPLIT) + (nodes (t->f) != nf + 2 * NSPLIT);
+  fprintf (stdout, "\n%d splits : %.1f ns/split, %zu vertices, %zu faces, "
+    "errors %d", NSPLIT, 1e9 * tsplit / NSPLIT, nodes (t->p), nodes (t->f),
+    errors);
+
+  /* collapse the half edges (of a vertex not split) to a split vertex */
+  hmesh_scalar_new (t->p, "split");
+  Index isplit = hmesh_scalar_get (t->p, "split");
+  HMESH_FOREACH_NODE (t->p, p)
+    HMESH_SCALAR (t->p, isplit, p) = 0.;
+  for (size_t k = 0; k < NSPLIT; ++k)
+    HMESH_SCALAR (t->p, isplit, m[k]) = 1.;
+  size_t ncollapse = 0, nabandon = 0, npass = 0, found;
+  double tcollapse = 0.;
+  he = realloc (he, 3 * nodes (t->f) * sizeof (Node));
+  do
+  {
+    n = found = 0;
+    HMESH_FOREACH_TRI_HEDGE (t->f, x)
+      if ( !HMESH_SCALAR (t->p, isplit, HMESH_TRI_PIVOT (t->f, x)) &&
+           HMESH_SCALAR (t->p, isplit,
+             HMESH_TRI_PIVOT (t->f, hmesh_tri_next (x))) )
+        he[n++] = x;
+    start = now ();
+    for (size_t k = 0; k < n; ++k)
+    {
+      /* faces of the earlier collapses are removed */
+      if ( !in_use (t->f, hmesh_tri_face (he[k])) ||
+           HMESH_SCALAR (t->p, isplit, HMESH_TRI_PIVOT (t->f, he[k])) ||
+           !HMESH_SCALAR (t->p, isplit,
+             HMESH_TRI_PIVOT (t->f, hmesh_tri_next (he[k]))) )
+        continue;
+      ++found;
+      if (hmesh_tris_collapse (t, he[k]) == HMESH_NO_ERROR)
+        ++ncollapse;
+      else
+        ++nabandon;
+    }
+    tcollapse += now () - start;
+    ++npass;
+  } while (found && nodes (t->p) > nv && npass < 8);
+  errors += (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) + (euler (t) != 0);
+  fprintf (stdout, "\n%zu collapses (%zu abandoned, %zu passes) : %.1f "
+    "ns/collapse, %zu vertices, %zu faces, errors %d", ncollapse, nabandon,
+    npass, 1e9 * tcollapse / (ncollapse + nabandon), nodes (t->p),
+    nodes (t->f), errors);
+  free (m);
+  free (he);
+  hmesh_tris_destroy (t);
+
+  /* tetrahedron : a collapse would give 2 faces with the same vertices */
+  t = hmesh_tris (3);
+  Node p[M*M], grid[2*(M-1)*(M-1)][3], out[2*(M-1)*(M-1)];
+  hmesh_nodes_new (t->p, 4, p);
+  Node tet[4][3] = { {p[0], p[2], p[1]}, {p[0], p[1], p[3]},
+    {p[1], p[2], p[3]}, {p[0], p[3], p[2]} };
+  errors += hmesh_tris_faces_new (t, tet, 4, out) +
+    (hmesh_tris_valid (t) != HMESH_HEDGE_VALID) + (euler (t) != 2) +
+    (hmesh_tris_collapse (t, hmesh_tri_hedge (out[0], 0)) != HMESH_ERROR) +
+    (nodes (t->f) != 4);
+  hmesh_tris_destroy (t);
+
+  /* open grid : a boundary edge is split, but not collapsed */
+  t = hmesh_tris (3);
+  hmesh_nodes_new (t->p, M*M, p);
+  int k = grid_faces (p, grid);
+  errors += hmesh_tris_faces_new (t, grid, k, out);
+  Node boundary = HMESH_NODE_NULL, inner = HMESH_NODE_NULL;
+  int nboundary = 0;
+  HMESH_FOREACH_TRI_HEDGE (t->f, x)
+    if (HMESH_TRI_TWIN (t->f, x).index == HMESH_INDEX_NULL)
+    {
+      boundary = x;
+      ++nboundary;
+    }
+  errors += (nboundary != 4 * (M - 1));
+  errors += (hmesh_tris_collapse (t, boundary) != HMESH_ERROR);
+  /* an inner edge from the boundary vertex p[1] */
+  HMESH_FOREACH_TRI_HEDGE (t->f, x)
+    if ( HMESH_TRI_PIVOT (t->f, x).index == p[1].index &&
+         HMESH_TRI_PIVOT (t->f, x).iblock == p[1].iblock &&
+         HMESH_TRI_TWIN (t->f, x).index != HMESH_INDEX_NULL )
+      inner = x;
+  errors += (hmesh_tris_collapse (t, inner) != HMESH_ERROR);
+  Node g = hmesh_tris_split (t, boundary);
+  nboundary = 0;
+  HMESH_FOREACH_TRI_HEDGE (t->f, x)
+    nboundary += (HMESH_TRI_TWIN (t->f, x).index == HMESH_INDEX_NULL);
+  errors += (g.index == HMESH_INDEX_NULL) + (nboundary != 4 * (M - 1) + 1) +
+    (hmesh_tris_valid (t) != HMESH_HEDGE_VALID);
+
+  /* a face repeated */
+  hmesh_error_flush ();
+  hmesh_error ("main () : expect an error for a repeated face");
+  errors += !hmesh_tris_faces_new (t, grid + 1, 1, NULL);
+  hmesh_error_flush ();
+  fprintf (stdout, "\ntetrahedron, grid %dx%d : %d boundary half edges, "
+    "errors %d\n", M, M, nboundary, errors);
+  hmesh_tris_destroy (t);
+  hmesh_tpool_destroy ();
+
+  hmesh_error_flush ();
+
+  return 0;
+}